@@ -0,0 +1,88 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include <sdbus-c++/sdbus-c++.h>
+#include <sigc++/connection.h>
+
+#include "alpm/async.hh"
+#include "bus.hh"
+#include "http/client.hh"
+#include "result.hh"
+
+
+namespace aurgh
+{
+    /* the root half of aurgh behind org.kei.aurgh.Helper on the system bus: it only changes
+       the system, and only for callers polkit lets through. Everything a session asks
+       without changing anything stays with the unprivileged org.kei.aurgh.Daemon */
+    class helper
+    {
+    public:
+        /* TransactionProgress carries every target that moved since the last one */
+        static constexpr std::chrono::milliseconds progress_interval { 100 };
+
+
+        [[nodiscard]]
+        static auto create(sdbus::IConnection                  &connection,
+                           const std::shared_ptr<http::client> &http,
+                           const std::filesystem::path         &pacman_conf) noexcept
+            -> result<std::unique_ptr<helper>>;
+
+
+        /* calls @p quit once nothing ran for @p timeout; like the session daemon, @p quit
+           should give up the bus name so that activation starts a fresh helper */
+        void exit_when_idle(std::chrono::seconds timeout, std::move_only_function<void()> quit);
+
+
+        helper(const helper &)                     = delete;
+        auto operator=(const helper &) -> helper & = delete;
+
+    private:
+        /* the downloaded repositories, then added, changed and removed packages */
+        using refresh_reply = sdbus::Result<std::vector<std::string>,
+                                            std::vector<bus::package_record>,
+                                            std::vector<bus::package_record>,
+                                            std::vector<bus::package_record>>;
+
+        std::shared_ptr<http::client> m_http;
+        alpm::async                   m_alpm;
+
+        std::unique_ptr<sdbus::IProxy> m_polkit;
+
+        std::map<std::pair<std::string, std::string>, double> m_pending_progress;
+        sigc::connection                                      m_progress_flush;
+
+        std::size_t                     m_busy = 0;
+        std::chrono::seconds            m_idle_timeout { 0 };
+        std::move_only_function<void()> m_on_idle;
+        sigc::connection                m_idle_timer;
+
+        std::unique_ptr<sdbus::IObject> m_object;
+
+
+        helper(sdbus::IConnection                  &connection,
+               const std::shared_ptr<http::client> &http,
+               alpm::handle                       &&handle);
+
+
+        /* asks polkit whether the sender of the call being handled may do @p action and
+           calls @p then with the answer on the main loop; only valid while handling a call */
+        void mf_authorize(std::string_view action, std::function<void(result<void>)> then);
+
+        void mf_transaction(sdbus::Result<std::vector<bus::package_record>> &&reply,
+                            alpm::transaction_request                        trans);
+
+        void mf_refresh(refresh_reply &&reply, bool force);
+
+        void mf_queue_progress(std::string_view step, std::string_view target, double value);
+        void mf_flush_progress();
+
+        void mf_hold();
+        void mf_release();
+        void mf_arm_idle_timer();
+    };
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include <sdbus-c++/sdbus-c++.h>
+#include <sigc++/connection.h>
+
+#include "alpm/async.hh"
+#include "alpm/config_watch.hh"
+#include "aur.hh"
+#include "bus.hh"
+#include "git/executor.hh"
+#include "http/client.hh"
+#include "result.hh"
+#include "shared_results.hh"
+#include "warm_index.hh"
+
+
+namespace aurgh
+{
+    /* the long-lived state behind org.kei.aurgh.Daemon: one libalpm handle, one AUR
+       client and one clone executor for every frontend on the session. It runs as the
+       user and only reads the system; changing it is helper's job */
+    class service
+    {
+    public:
+        template <typename T>
+        using responder = typename shared_results<T>::responder;
+
+
+        static constexpr std::chrono::seconds default_cache_ttl { 60 };
+        static constexpr std::size_t          cache_capacity = 128;
+
+
+        [[nodiscard]]
+        static auto create(sdbus::IConnection                  &connection,
+                           const std::shared_ptr<http::client> &http,
+                           std::filesystem::path                clone_dir,
+                           const std::filesystem::path         &pacman_conf,
+                           std::size_t                          clone_jobs,
+                           std::filesystem::path                state_dir = {},
+                           std::chrono::seconds cache_ttl       = default_cache_ttl) noexcept
+            -> result<std::unique_ptr<service>>;
+
+
+        /* calls @p quit once nothing ran for @p timeout, after saving the warm index; @p quit
+           should give up the bus name, so that activation hands new calls to a fresh daemon */
+        void exit_when_idle(std::chrono::seconds timeout, std::move_only_function<void()> quit);
+
+
+        service(const service &)                     = delete;
+        auto operator=(const service &) -> service & = delete;
+
+    private:
+        std::shared_ptr<http::client>  m_http;
+        std::shared_ptr<git::executor> m_git;
+        std::filesystem::path          m_clone_dir;
+
+        aur                                  m_aur;
+        alpm::async                          m_alpm;
+        std::shared_ptr<alpm::mirror_scores> m_mirrors; /* may be null */
+
+        /* answers the libalpm half of lookups until the sync databases are read */
+        std::filesystem::path     m_state_dir;
+        std::optional<warm_index> m_index;
+        bool                      m_index_fresh = false;
+        bool                      m_alpm_ready  = false;
+
+        std::size_t                     m_busy = 0;
+        std::chrono::seconds            m_idle_timeout { 0 };
+        std::move_only_function<void()> m_on_idle;
+        sigc::connection                m_idle_timer;
+
+        /* identical questions from any bus client share one lookup and its answer */
+        shared_results<package>         m_searches;
+        shared_results<package_details> m_infos;
+
+        /* pacman.conf and its includes, applied to the live handle when they change */
+        std::unique_ptr<alpm::config_watch> m_config_watch;
+
+        std::unique_ptr<sdbus::IObject> m_object;
+
+
+        service(sdbus::IConnection                   &connection,
+                const std::shared_ptr<http::client>  &http,
+                const std::shared_ptr<git::executor> &git,
+                std::filesystem::path               &&clone_dir,
+                alpm::handle                        &&handle,
+                std::shared_ptr<alpm::mirror_scores>  mirrors,
+                std::filesystem::path               &&state_dir,
+                std::chrono::seconds                  cache_ttl);
+
+
+        void mf_search(std::string query, responder<package> respond);
+        void mf_info(std::vector<std::string> names, responder<package_details> respond);
+        void mf_clone(sdbus::Result<std::string> &&reply, std::string url);
+
+        void mf_reload_config();
+
+        void mf_hold();
+        void mf_release();
+        void mf_arm_idle_timer();
+        void mf_on_idle();
+
+        /* only while nothing holds the service */
+        void mf_quit();
+    };
+}
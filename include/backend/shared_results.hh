@@ -0,0 +1,109 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "result.hh"
+
+
+namespace aurgh
+{
+    /* answers shared between every bus client asking the same question: waiters on a
+       key that is already being looked up join it, and a settled answer is kept for
+       a while so the next asker does not start another lookup. main loop only. */
+    template <typename T> class shared_results
+    {
+    public:
+        using clock     = std::chrono::steady_clock;
+        using responder = std::move_only_function<void(result<std::vector<T>>)>;
+
+
+        shared_results(std::chrono::seconds ttl, std::size_t capacity) noexcept
+            : m_ttl { ttl }, m_capacity { capacity }
+        {
+        }
+
+
+        /* answers @p respond right away from the cache, or queues it behind @p key;
+           returns true when it is the first waiter and the lookup has to be started */
+        [[nodiscard]]
+        auto
+        join(const std::string &key, responder respond) -> bool
+        {
+            if (auto it = m_cache.find(key); it != m_cache.end())
+            {
+                if (clock::now() - it->second.stored < m_ttl)
+                {
+                    respond(it->second.items);
+                    return false;
+                }
+                m_cache.erase(it);
+            }
+
+            auto [it, first] = m_waiting.try_emplace(key);
+            it->second.emplace_back(std::move(respond));
+            return first;
+        }
+
+
+        /* hands @p res to everyone waiting on @p key, only successes are cached */
+        void
+        settle(const std::string &key, result<std::vector<T>> res)
+        {
+            auto node = m_waiting.extract(key);
+            if (node.empty()) return;
+
+            if (res.has_value()) mf_store(key, *res);
+
+            auto &waiters = node.mapped();
+            for (std::size_t i = 0; i + 1 < waiters.size(); i++) waiters[i](res);
+            waiters.back()(std::move(res));
+        }
+
+
+        void
+        clear() noexcept
+        { m_cache.clear(); }
+
+
+        /* drops the cached answers @p stale picks by their key and items */
+        template <typename Pred>
+        void
+        erase_if(Pred &&stale)
+        {
+            std::erase_if(m_cache, [&](const auto &pair)
+                          { return stale(pair.first, pair.second.items); });
+        }
+
+    private:
+        struct entry
+        {
+            std::vector<T>    items;
+            clock::time_point stored;
+        };
+
+        std::chrono::seconds m_ttl;
+        std::size_t          m_capacity;
+
+        std::map<std::string, std::vector<responder>> m_waiting;
+        std::map<std::string, entry>                  m_cache;
+
+
+        void
+        mf_store(const std::string &key, const std::vector<T> &items)
+        {
+            if (m_capacity == 0 or m_ttl <= std::chrono::seconds::zero()) return;
+
+            /* the oldest answer makes room, the cache stays small enough to scan */
+            if (m_cache.size() >= m_capacity and !m_cache.contains(key))
+                m_cache.erase(std::ranges::min_element(
+                    m_cache, {}, [](const auto &pair) { return pair.second.stored; }));
+
+            m_cache.insert_or_assign(key, entry { items, clock::now() });
+        }
+    };
+}
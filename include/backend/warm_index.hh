@@ -0,0 +1,50 @@
+#pragma once
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+#include "alpm/handle.hh"
+#include "bulk.hh"
+#include "result.hh"
+
+
+namespace aurgh
+{
+    /* the sync databases as the daemon last saw them, mapped from its state directory so
+       lookups can be answered while libalpm is still reading the real ones */
+    class warm_index
+    {
+    public:
+        /* fails when nothing was saved or a sync database is newer than the save */
+        [[nodiscard]]
+        static auto load(const std::filesystem::path &dir,
+                         std::filesystem::file_time_type sync_time) noexcept -> result<warm_index>;
+
+
+        static auto save(const std::filesystem::path &dir, const alpm::sync_index &index) noexcept
+            -> result<void>;
+
+
+        /* a case-insensitive match on names and descriptions, close to alpm_db_search */
+        [[nodiscard]]
+        auto search(std::string_view query) const -> std::vector<package>;
+
+
+        [[nodiscard]]
+        auto info(std::span<const std::string> names) const -> std::vector<package_details>;
+
+
+        /* whether search would return a package with this @p name and @p description */
+        [[nodiscard]]
+        static auto matches(std::string_view query,
+                            std::string_view name,
+                            std::string_view description) -> bool;
+
+    private:
+        bulk::package_table m_packages;
+        bulk::details_table m_details;
+
+
+        warm_index(bulk::package_table &&packages, bulk::details_table &&details) noexcept;
+    };
+}
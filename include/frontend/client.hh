@@ -1,29 +1,50 @@
 #pragma once
+#include <deque>
 #include <filesystem>
+#include <list>
+#include <optional>
+#include <span>
+#include <thread>
 
+#include <glibmm/dispatcher.h>
 #include <glibmm/ustring.h>
 #include <sigc++/signal.h>
+#include <sigc++/trackable.h>
 
 #include "alpm/async.hh"
 #include "aur.hh"
+#include "daemon_client.hh"
 #include "git.hh"
+#include "git/devel.hh"
+#include "git/peek.hh"
+#include "git/remote.hh"
 #include "result.hh"
+#include "snapshot.hh"
+#include "srcinfo.hh"
+#include "trace.hh"
 
 
 namespace aurgh
 {
-    class client
+    class client : public sigc::trackable
     {
     public:
+        /* lives in the clone registry until the main loop is idle after its completion signal */
         class clone_process
         {
             friend class client;
 
         public:
-            clone_process(std::shared_ptr<git::cloning> &&cloning);
-
-            clone_process(clone_process &&other) noexcept;
-            auto operator=(clone_process &&other) noexcept -> clone_process &;
+            clone_process(client                          &owner,
+                          std::shared_ptr<git::cloning> &&source,
+                          std::string                     url,
+                          std::string                     base);
+            clone_process(client                     &owner,
+                          std::shared_ptr<snapshot> &&source,
+                          std::string                url,
+                          std::string                base);
+            /* cloned by the daemon, reported through its bus signals */
+            clone_process(client &owner, std::string url, std::string base);
 
             clone_process(const clone_process &)  = delete;
             auto operator=(const clone_process &) = delete;
@@ -36,30 +57,139 @@ namespace aurgh
             [[nodiscard]]
             auto signal_on_clone_progress() const -> sigc::signal<void(double)>;
 
+
+            [[nodiscard]]
+            auto url() const noexcept -> std::string_view;
+
+            /* the package base, i.e. the directory under the clone directory */
+            [[nodiscard]]
+            auto base() const noexcept -> std::string_view;
+
+            [[nodiscard]]
+            auto progress() const noexcept -> double;
+
+            [[nodiscard]]
+            auto finished() const noexcept -> bool;
+
         private:
-            Glib::Dispatcher m_complete_dispatcher;
-            Glib::Dispatcher m_progress_dispatcher;
+            client *m_owner;
+
+            std::list<clone_process>::iterator m_self;
 
             sigc::signal<void(result<std::filesystem::path>)> m_signal_on_complete;
             sigc::signal<void(double)>                        m_signal_on_progress;
 
+            std::string                   m_url;
+            std::string                   m_base;
             result<std::filesystem::path> m_dst;
-            std::atomic<double>           m_progress;
+            double                        m_progress = 0.0;
+            bool                          m_finished = false;
 
-            std::shared_ptr<git::cloning> m_cloning;
+            std::shared_ptr<void> m_source; /* the cloning or snapshot being reported */
+            sigc::connection      m_daemon_progress; /* while the daemon clones */
+
+
+            template <typename Source> void mf_connect(Source &source);
+            void                            mf_finish();
+        };
+
+
+        struct clone_record
+        {
+            std::string                   url;
+            result<std::filesystem::path> dst;
         };
 
 
+        static constexpr std::size_t max_finished_clones = 64;
+
+
+        /* returns without waiting for libalpm, which loads in the background when there is
+           no daemon; lookups made meanwhile get their AUR half started right away */
         [[nodiscard]]
         static auto create(const std::shared_ptr<http::client> &http,
                            std::filesystem::path                clone_dir,
-                           const std::filesystem::path &pacman_conf = "/etc/pacman.conf") noexcept
+                           const std::filesystem::path         &pacman_conf = "/etc/pacman.conf",
+                           std::size_t clone_jobs = git::executor::default_concurrency) noexcept
             -> result<std::unique_ptr<client>>;
 
+        ~client();
+
 
         auto search(const std::string &query) noexcept -> result<void>;
         auto info(const std::vector<std::string> &args) noexcept -> result<void>;
-        auto clone(std::string_view url) noexcept -> result<std::reference_wrapper<clone_process>>;
+
+
+        /* large answers read in place from the daemon, only available while it runs */
+        auto search_bulk(const std::string &query) noexcept -> result<void>;
+        auto info_bulk(const std::vector<std::string> &args) noexcept -> result<void>;
+
+        /* a clone of the same base that is still running is handed out instead of a new one.
+           Standalone clones are made by the daemon while it answers and clones into the same
+           directory, here otherwise */
+        auto clone(std::string_view        url,
+                   git::executor::priority prio = git::executor::priority::normal) noexcept
+            -> result<std::reference_wrapper<clone_process>>;
+
+
+        /* one clone per distinct AUR package base, in the order the bases first appear;
+           packages from sync repositories are skipped */
+        auto clone_packages(
+            std::span<const package> packages,
+            git::executor::priority  prio = git::executor::priority::normal) noexcept
+            -> result<std::vector<std::reference_wrapper<clone_process>>>;
+
+
+        /* fetches @p pkgbase as a snapshot tarball instead of a git clone */
+        auto download_snapshot(
+            std::string_view        pkgbase,
+            git::executor::priority prio = git::executor::priority::normal) noexcept
+            -> result<std::reference_wrapper<clone_process>>;
+
+
+        /* PKGBUILD and .SRCINFO at HEAD of @p url, without cloning it */
+        [[nodiscard]]
+        auto peek(std::string_view url) noexcept
+            -> result<std::shared_ptr<git::request<git::head_files>>>;
+
+
+        [[nodiscard]]
+        auto active_clones() const -> std::vector<std::reference_wrapper<const clone_process>>;
+
+
+        /* a copy of the most recent max_finished_clones, oldest first */
+        [[nodiscard]]
+        auto finished_clones() const -> std::deque<clone_record>;
+
+
+        /* which clones under the clone directory are behind their remote */
+        [[nodiscard]]
+        auto check_updates(std::size_t concurrency = git::executor::default_concurrency) noexcept
+            -> result<std::shared_ptr<git::request<git::update_report>>>;
+
+
+        /* which cloned VCS packages have upstream sources that moved since they were built */
+        [[nodiscard]]
+        auto check_devel(std::size_t concurrency = git::executor::default_concurrency) noexcept
+            -> result<std::shared_ptr<git::request<git::devel_report>>>;
+
+
+        /* records the upstream commits last seen by check_devel as built for @p pkgbase */
+        auto mark_rebuilt(std::string_view pkgbase) noexcept -> result<void>;
+
+
+        /* reads the .SRCINFO of an already cloned @p pkgbase, no network involved */
+        [[nodiscard]]
+        auto local_info(std::string_view pkgbase) const noexcept
+            -> result<std::vector<package_details>>;
+
+
+        /* applies to clones started after the call */
+        void set_clone_layout(git::layout layout) noexcept;
+
+
+        /* where download_snapshot looks for <pkgbase>.tar.gz */
+        void set_snapshot_url(std::string base_url) noexcept;
 
 
         [[nodiscard]]
@@ -69,6 +199,14 @@ namespace aurgh
         auto signal_on_info_complete() const
             -> sigc::signal<void(result<std::vector<package_details>>)>;
 
+        [[nodiscard]]
+        auto signal_on_search_bulk_complete() const
+            -> sigc::signal<void(result<std::shared_ptr<bulk::package_table>>)>;
+
+        [[nodiscard]]
+        auto signal_on_info_bulk_complete() const
+            -> sigc::signal<void(result<std::shared_ptr<bulk::details_table>>)>;
+
     private:
         template <typename T>
         struct operation
@@ -88,18 +226,29 @@ namespace aurgh
             std::shared_ptr<aur::request<T>>         aur_request;
             std::shared_ptr<alpm::async::request<T>> alpm_request;
 
+            /* the libalpm half of the last perform, held while libalpm is still loading */
+            std::move_only_function<result<void>(alpm::async &)> deferred;
+
+            std::uint64_t trace_id = 0; /* of the last perform, main loop only */
+
 
             operation()
             {
-                dispatcher.connect([this] { signal.emit(results); });
+                dispatcher.connect(
+                    [this]
+                    {
+                        AURGH_TRACE_SPAN("client", "operation::emit", {}, trace_id);
+                        signal.emit(results);
+                    });
             }
 
 
+            /* with a null @p alpm the AUR half starts now and the other waits for resume */
             template <typename U, typename V>
             auto
             perform(auto                                           val,
                     aur                                           &aur,
-                    alpm::async                                   &alpm,
+                    alpm::async                                   *alpm,
                     method<aurgh::aur, U, decltype(aur_request)>   aur_method,
                     method<alpm::async, V, decltype(alpm_request)> alpm_method) noexcept
                 -> result<void>
@@ -107,6 +256,17 @@ namespace aurgh
                 if (aur_request != nullptr)
                     if (auto res = aur_request->cancel(); !res) return res.error().unexpected();
                 if (alpm_request != nullptr) alpm_request->cancel();
+                deferred = nullptr;
+
+                trace_id = trace::next_id();
+                AURGH_TRACE_ID_SCOPE(trace_id);
+                AURGH_TRACE_SPAN("client", "operation::perform");
+
+                {
+                    std::lock_guard lock { mutex };
+                    results = T {};
+                    counter = 0;
+                }
 
                 if (auto res = (aur.*aur_method)(val); res.has_value())
                 {
@@ -116,14 +276,43 @@ namespace aurgh
                 else
                     return res.error().unexpected();
 
-                if (auto res = (alpm.*alpm_method)(val); res.has_value())
+                auto start_alpm = [this, val, alpm_method](alpm::async &a) -> result<void>
                 {
-                    alpm_request = std::move(res.value());
-                    attach_handler(alpm_request, results, counter, dispatcher);
+                    AURGH_TRACE_ID_SCOPE(trace_id);
+
+                    if (auto res = (a.*alpm_method)(val); res.has_value())
+                    {
+                        alpm_request = std::move(res.value());
+                        attach_handler(alpm_request, results, counter, dispatcher);
+                    }
+                    else
+                        return res.error().unexpected();
+                    return {};
+                };
+
+                if (alpm == nullptr)
+                {
+                    deferred = std::move(start_alpm);
+                    return {};
                 }
-                else
-                    return res.error().unexpected();
-                return {};
+
+                return start_alpm(*alpm);
+            }
+
+
+            /* starts the held libalpm half, or fails it with @p loaded's error */
+            void
+            resume(result<std::reference_wrapper<alpm::async>> loaded)
+            {
+                if (deferred == nullptr) return;
+                auto start = std::exchange(deferred, nullptr);
+
+                auto res = loaded.and_then([&start](alpm::async &a) { return start(a); });
+                if (res.has_value()) return;
+
+                std::lock_guard lock { mutex };
+                results = res.error().unexpected();
+                dispatcher.emit();
             }
 
 
@@ -133,6 +322,8 @@ namespace aurgh
                 req->on_result(
                        [this, &results, &counter, &dispatcher](auto &&res)
                        {
+                           AURGH_TRACE_SPAN("client", "operation::merge");
+
                            std::lock_guard lock { mutex };
                            if (!results) [[unlikely]]
                                return; /* dispatcher already emitted from the other thread */
@@ -152,22 +343,63 @@ namespace aurgh
         };
 
 
-        std::shared_ptr<http::client> m_client;
-        std::filesystem::path         m_clone_dir;
+        std::shared_ptr<http::client>  m_client;
+        std::shared_ptr<git::executor> m_git;
+        std::filesystem::path          m_clone_dir;
+        git::layout                    m_clone_layout = git::layout::standalone;
+        std::string                    m_snapshot_url = snapshot::default_base_url;
+
+        aur                   m_aur;
+        std::filesystem::path m_pacman_conf;
 
-        aur         m_aur;
-        alpm::async m_alpm;
+        /* searches, info and clones go to the daemon while it answers, libalpm is
+           only loaded in this process once it does not */
+        std::unique_ptr<daemon_client> m_daemon;
+        std::optional<alpm::async>     m_alpm;
 
-        std::mutex                 m_clone_mutex;
-        std::vector<clone_process> m_clones;
+        /* pacman.conf and the sync databases are read on their own thread so that nothing on
+           the main loop waits for them; m_alpm_loaded is written there before the emit */
+        std::thread                         m_alpm_loader;
+        std::optional<result<alpm::handle>> m_alpm_loaded;
+        Glib::Dispatcher                    m_alpm_dispatcher;
+
+        std::map<std::filesystem::path, git::devel_cache::map_type> m_devel_heads;
+
+        mutable std::mutex       m_clone_mutex;
+        std::list<clone_process> m_clones; /* stable addresses for the returned references */
+        std::deque<clone_record> m_finished_clones;
 
         operation<std::vector<package>>         m_search_operation;
         operation<std::vector<package_details>> m_info_operation;
 
+        sigc::signal<void(result<std::shared_ptr<bulk::package_table>>)> m_signal_on_search_bulk;
+        sigc::signal<void(result<std::shared_ptr<bulk::details_table>>)> m_signal_on_info_bulk;
+
+
+        client(const std::shared_ptr<http::client>  &http,
+               const std::shared_ptr<git::executor> &git,
+               std::filesystem::path               &&clone_dir,
+               std::filesystem::path                 pacman_conf,
+               std::unique_ptr<daemon_client>      &&daemon);
+
+
+        /* null while libalpm is still loading, the first call starts loading it */
+        auto mf_local_alpm() noexcept -> result<alpm::async *>;
+        void mf_alpm_loaded();
+
+        auto mf_search_locally(const std::string &query) noexcept -> result<void>;
+        auto mf_info_locally(const std::vector<std::string> &args) noexcept -> result<void>;
+
+        /* m_clone_mutex must be held */
+        auto mf_find_active(std::string_view base) noexcept -> clone_process *;
+
+        /* while the daemon answers and clones into the same directory as this client */
+        [[nodiscard]]
+        auto mf_clones_on_daemon() const noexcept -> bool;
+        void mf_clone_on_daemon(clone_process &process, git::executor::priority prio);
 
-        client(const std::shared_ptr<http::client> &http,
-               std::filesystem::path              &&clone_dir,
-               alpm::handle                       &&handle);
+        void mf_clone_finished(clone_process &process);
+        void mf_reclaim(std::list<clone_process>::iterator it);
     };
 
 }
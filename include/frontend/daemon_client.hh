@@ -0,0 +1,77 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include <sdbus-c++/sdbus-c++.h>
+#include <sigc++/signal.h>
+
+#include "bulk.hh"
+#include "bus.hh"
+#include "package.hh"
+#include "result.hh"
+
+
+namespace aurgh
+{
+    /* talks to a running aurgh-daemon, replies are delivered on the main loop */
+    class daemon_client
+    {
+    public:
+        template <typename T> using callback = std::function<void(result<T>)>;
+
+
+        [[nodiscard]]
+        static auto connect() noexcept -> result<std::unique_ptr<daemon_client>>;
+
+
+        /* false once a call failed on the bus rather than in the daemon */
+        [[nodiscard]]
+        auto available() const noexcept -> bool;
+
+
+        void search(const std::string &query, callback<std::vector<package>> done);
+        void info(const std::vector<std::string>       &names,
+                  callback<std::vector<package_details>> done);
+
+
+        /* the same answers handed over as a sealed memfd and read in place */
+        void search_bulk(const std::string                             &query,
+                         callback<std::shared_ptr<bulk::package_table>> done);
+        void info_bulk(const std::vector<std::string>                &names,
+                       callback<std::shared_ptr<bulk::details_table>> done);
+
+
+        /* a standalone clone made by the daemon into its clone directory */
+        void clone(const std::string &url, callback<std::filesystem::path> done);
+
+
+        /* the daemon's clone directory, empty until it has answered */
+        [[nodiscard]]
+        auto clone_dir() const noexcept -> const std::optional<std::filesystem::path> &;
+
+
+        /* the daemon's CloneProgress, for every clone it runs: (url, progress) */
+        [[nodiscard]]
+        auto signal_on_clone_progress() const -> sigc::signal<void(std::string, double)>;
+
+    private:
+        std::unique_ptr<sdbus::IConnection>    m_connection;
+        std::unique_ptr<bus::main_loop_source> m_source;
+        std::unique_ptr<sdbus::IProxy>         m_proxy;
+
+        bool                                 m_available = true;
+        std::optional<std::filesystem::path> m_clone_dir;
+
+        sigc::signal<void(std::string, double)> m_signal_on_clone_progress;
+
+
+        explicit daemon_client(std::unique_ptr<sdbus::IConnection> &&connection);
+
+
+        template <typename Table, typename Arg>
+        void mf_call_bulk(std::string_view method, const Arg &arg,
+                          callback<std::shared_ptr<Table>> done);
+    };
+}
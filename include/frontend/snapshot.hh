@@ -0,0 +1,113 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stop_token>
+
+#include <glibmm/dispatcher.h>
+#include <sigc++/signal.h>
+
+#include "git/executor.hh"
+#include "http/client.hh"
+#include "http/pipe.hh"
+#include "progress.hh"
+#include "result.hh"
+
+
+namespace aurgh
+{
+    /* a package base fetched as the tarball of its AUR snapshot, without any git history */
+    class snapshot : public std::enable_shared_from_this<snapshot>
+    {
+        using transfer_progress_signal = sigc::signal<void(double)>;
+        using completed_signal         = sigc::signal<void(std::filesystem::path)>;
+        using error_signal             = sigc::signal<void(error)>;
+
+    public:
+        static constexpr auto default_base_url = "https://aur.archlinux.org/cgit/aur.git/snapshot";
+
+
+        snapshot(const std::shared_ptr<http::client> &http,
+                 std::string                          url,
+                 std::filesystem::path                dst);
+
+        snapshot(const snapshot &)                     = delete;
+        auto operator=(const snapshot &) -> snapshot & = delete;
+
+
+        auto
+        on_transfer_progress(const transfer_progress_signal::slot_type &slot) -> snapshot &
+        {
+            m_signal_on_transfer_progress.connect(slot);
+            return *this;
+        }
+
+
+        auto
+        on_completed(const completed_signal::slot_type &slot) -> snapshot &
+        {
+            m_signal_on_completed.connect(slot);
+            return *this;
+        }
+
+
+        auto
+        on_error(const error_signal::slot_type &slot) -> snapshot &
+        {
+            m_signal_on_error.connect(slot);
+            return *this;
+        }
+
+
+        /* must be called on the main loop */
+        void cancel();
+
+    private:
+        std::shared_ptr<http::client> m_http;
+        std::string                   m_url;
+        std::filesystem::path         m_dst;
+
+        std::stop_source m_stop_source;
+
+        /* the body is pushed on the main loop and extracted on an executor thread; the
+           transfer is started on the main loop by the job */
+        http::pipe                      m_body;
+        std::shared_ptr<http::transfer> m_transfer;
+        std::size_t                     m_received = 0;
+        bool                            m_refused  = false;
+
+        progress::slot       m_progress;
+        std::optional<error> m_pending_error;
+
+        Glib::Dispatcher m_dispatch_done;
+
+        transfer_progress_signal m_signal_on_transfer_progress;
+        completed_signal         m_signal_on_completed;
+        error_signal             m_signal_on_error;
+
+
+        friend auto fetch_snapshot(const std::shared_ptr<http::client> &,
+                                   std::string_view,
+                                   std::string_view,
+                                   const std::filesystem::path &,
+                                   git::executor &,
+                                   git::executor::priority) noexcept
+            -> result<std::shared_ptr<snapshot>>;
+
+        auto mf_start() -> result<void>;
+        void mf_run();
+        auto mf_extract(const std::filesystem::path &staging) -> result<void>;
+        void mf_on_done();
+    };
+
+
+    /* downloads and unpacks <base_url>/<pkgbase>.tar.gz into clone_dir/<pkgbase> */
+    [[nodiscard]]
+    auto fetch_snapshot(const std::shared_ptr<http::client> &http,
+                        std::string_view                     base_url,
+                        std::string_view                     pkgbase,
+                        const std::filesystem::path         &clone_dir,
+                        git::executor                       &exec,
+                        git::executor::priority prio = git::executor::priority::normal) noexcept
+        -> result<std::shared_ptr<snapshot>>;
+}
@@ -4,12 +4,14 @@
 #include <filesystem>
 #include <memory>
 #include <thread>
+#include <variant>
 
 #include <glibmm/dispatcher.h>
 #include <sigc++/signal.h>
 
 #include "alpm/handle.hh"
 #include "result.hh"
+#include "trace.hh"
 
 
 namespace aurgh::alpm
@@ -76,14 +78,60 @@ namespace aurgh::alpm
         auto info(const std::vector<std::string> &args) noexcept
             -> result<std::shared_ptr<request<std::vector<package_details>>>>;
 
+
+        [[nodiscard]]
+        auto transaction(transaction_request trans) noexcept
+            -> result<std::shared_ptr<request<std::vector<package>>>>;
+
+
+        [[nodiscard]]
+        auto reorder_servers() noexcept -> result<std::shared_ptr<request<std::monostate>>>;
+
+
+        /* the coalesced progress signals fire on the main loop, connect to them there */
+        [[nodiscard]]
+        auto
+        configuration() noexcept -> config &
+        { return m_handle.configuration(); }
+
+
+        [[nodiscard]]
+        auto preload() noexcept -> result<std::shared_ptr<request<std::monostate>>>;
+
+
+        [[nodiscard]]
+        auto index() noexcept -> result<std::shared_ptr<request<sync_index>>>;
+
+
+        [[nodiscard]]
+        auto refresh(bool force) noexcept -> result<std::shared_ptr<request<sync_delta>>>;
+
+
+        [[nodiscard]]
+        auto reload() noexcept -> result<std::shared_ptr<request<config_delta>>>;
+
+
+        /* only safe to call from the handle's own thread or before any request */
+        [[nodiscard]]
+        auto
+        sync_time() const noexcept -> std::filesystem::file_time_type
+        { return m_handle.sync_time(); }
+
     private:
         handle m_handle;
 
-        std::thread                                 m_thread;
-        std::mutex                                  m_mutex;
-        std::condition_variable                     m_cv;
-        std::deque<std::move_only_function<void()>> m_queue;
-        bool                                        m_stopping = false;
+        /* a queued call and the request ID it was queued under */
+        struct job
+        {
+            std::move_only_function<void()> fn;
+            std::uint64_t                   id = trace::current_id();
+        };
+
+        std::thread             m_thread;
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+        std::deque<job>         m_queue;
+        bool                    m_stopping = false;
 
 
         void run();
@@ -1,11 +1,16 @@
 #pragma once
+#include <cstdint>
 #include <filesystem>
+#include <map>
 #include <vector>
 
 #include <alpm.h>
 #include <sigc++/signal.h>
 
+#include "alpm/fetch.hh"
+#include "alpm/mirrors.hh"
 #include "ini.hh"
+#include "progress.hh"
 #include "result.hh"
 
 
@@ -53,7 +58,7 @@ namespace aurgh::alpm
         std::vector<std::string> no_extract;
 
         std::string  sandbox_user;
-        unsigned int parallel_downloads;
+        unsigned int parallel_downloads = 1; /* pacman's default without ParallelDownloads */
 
         /* bitfield for alpm_transflag_t */
         int flag = 0;
@@ -82,21 +87,91 @@ namespace aurgh::alpm
 
         sigc::signal<void(alpm_loglevel_t, std::string)>    signal_on_log;
         sigc::signal<void(std::string_view, download_data)> signal_on_download;
+
+        /* download fraction per file, coalesced and emitted on the main loop */
+        sigc::signal<void(std::string_view, double)> signal_on_download_progress;
+
+        /* per-package transaction steps, coalesced the same way */
+        sigc::signal<void(alpm_progress_t, std::string_view, double)> signal_on_package_progress;
+
         sigc::signal<void(alpm_event_t *)>                  signal_on_event;
         sigc::signal<void(alpm_question_t *)>               signal_on_question;
         sigc::signal<void(alpm_progress_t, std::string_view, int, std::size_t, std::size_t)>
             signal_on_progress;
 
 
+        /* with @p cache, an unchanged configuration is loaded from there in one read instead;
+           it is checked against the mtime and size of every file the last parse read */
         [[nodiscard]]
-        static auto parse(const std::filesystem::path &pacman_conf) noexcept
+        static auto parse(const std::filesystem::path &pacman_conf,
+                          const std::filesystem::path &cache = {}) noexcept
             -> result<std::unique_ptr<config>>;
 
 
+        /* downloads go through @p http instead of libalpm's own downloader, and with
+           @p mirrors every server list is ordered by how its hosts did; call before build */
+        void fetch_with(std::shared_ptr<http::client>  http,
+                        std::shared_ptr<mirror_scores> mirrors = nullptr);
+
+
+        [[nodiscard]]
+        auto
+        mirrors() noexcept -> mirror_scores *
+        { return m_mirrors.get(); }
+
+
+        /* reorders every repo.servers by mirror score, a no-op without scores */
+        void rank_servers();
+
+
+        [[nodiscard]]
+        auto http_fetcher() noexcept -> fetcher *
+        { return m_fetcher.get(); }
+
+
         [[nodiscard]]
         auto build() noexcept -> result<alpm_handle_t *>;
 
+
+        /* takes over what @p next parsed and changes @p handle, which build made from this
+           configuration, to match. Databases whose order and SigLevel stayed are kept loaded
+           and only get their usage and servers replaced; the names of the others, which were
+           unregistered or registered anew, are returned. RootDir and DBPath cannot change.
+           A configuration libalpm would refuse fails before any database is touched */
+        [[nodiscard]]
+        auto apply(alpm_handle_t *handle, config &&next) noexcept
+            -> result<std::vector<std::string>>;
+
+
+        /* every file the configuration was read from and every directory an Include globbed */
+        [[nodiscard]]
+        auto sources() const -> std::vector<std::filesystem::path>;
+
     private:
+        /* a file the configuration was read from, or a directory an Include globbed */
+        struct source
+        {
+            std::filesystem::path path;
+            std::int64_t          mtime = -1; /* nanoseconds, -1 when it did not exist */
+            std::int64_t          size  = -1;
+
+
+            [[nodiscard]]
+            static auto stat(std::filesystem::path path) noexcept -> source;
+
+
+            auto operator==(const source &other) const -> bool = default;
+        };
+
+        std::vector<source> m_sources;
+
+        std::map<std::string, progress::slot, std::less<>> m_download_slots;
+        std::map<std::string, progress::slot, std::less<>> m_package_slots;
+
+        std::unique_ptr<fetcher>       m_fetcher;
+        std::shared_ptr<mirror_scores> m_mirrors;
+
+
         auto mf_parse_cb(ini::callback_data data, int depth = 0) noexcept -> result<void>;
         auto mf_process_include(ini::callback_data data, int depth) noexcept -> result<void>;
         auto mf_parse_options(ini::callback_data data) noexcept -> result<void>;
@@ -104,6 +179,23 @@ namespace aurgh::alpm
         auto mf_parse_repo(ini::callback_data data) noexcept -> result<void>;
 
         auto mf_set_defaults() noexcept -> result<void>;
+        auto mf_validate() const noexcept -> result<void>;
+        auto mf_apply_options(alpm_handle_t *handle) noexcept -> result<void>;
+
+
+        [[nodiscard]]
+        static auto load_cache(const std::filesystem::path &cache,
+                               const std::filesystem::path &pacman_conf) noexcept
+            -> result<std::unique_ptr<config>>;
+
+        auto mf_save_cache(const std::filesystem::path &cache,
+                           const std::filesystem::path &pacman_conf) const noexcept
+            -> result<void>;
+
+
+        /* calls @p field with every parsed member of each of @p self, in the order the cache
+           stores them */
+        template <typename F, typename... Self> static void fields(F &&field, Self &...self);
 
 
         static void log_callback(void *ctx, alpm_loglevel_t level, const char *fmt, va_list args);
@@ -0,0 +1,57 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <glibmm/iochannel.h>
+#include <sigc++/connection.h>
+
+#include "result.hh"
+
+
+namespace aurgh::alpm
+{
+    /* tells when any of a configuration's files changed, from inotify on the main loop.
+       Parent directories are watched rather than the files, so an editor that saves by
+       renaming a new file over the old one is seen too. */
+    class config_watch
+    {
+    public:
+        /* editors and pacman-mirrors write a file in several steps, they settle first */
+        static constexpr std::chrono::milliseconds settle_time { 250 };
+
+
+        [[nodiscard]]
+        static auto create(std::function<void()> changed) noexcept
+            -> result<std::unique_ptr<config_watch>>;
+
+
+        ~config_watch();
+        config_watch(const config_watch &)                     = delete;
+        auto operator=(const config_watch &) -> config_watch & = delete;
+
+
+        /* replaces what was watched with @p paths, files and whole directories alike */
+        auto watch(const std::vector<std::filesystem::path> &paths) noexcept -> result<void>;
+
+    private:
+        int                   m_fd;
+        std::function<void()> m_changed;
+
+        std::map<int, std::filesystem::path> m_dirs; /* by watch descriptor */
+        std::set<std::filesystem::path>      m_paths;
+
+        sigc::connection m_io;
+        sigc::connection m_settle;
+
+
+        config_watch(int fd, std::function<void()> changed);
+
+
+        auto mf_on_io(Glib::IOCondition condition) -> bool;
+    };
+}
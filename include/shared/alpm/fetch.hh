@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "http/client.hh"
+#include "result.hh"
+
+
+namespace aurgh::alpm
+{
+    struct config;
+
+
+    /* libalpm's fetch callback on top of http::client. The first file of a repository is
+       raced across its leading mirrors, the one that answers first keeps the rest of the
+       session, and a leftover .part file is resumed with a Range request. Files of at least
+       http::segmented::threshold are then fetched in chunks from all of their mirrors.
+
+       A file that is already there and not forced is only asked for when the mirror has a
+       newer one, by its mtime and by the ETag kept in a user.aurgh.etag attribute.
+
+       Transfers run on the main loop; fetch and prefetch block the calling thread, which
+       therefore must not be the main loop itself. */
+    class fetcher
+    {
+    public:
+        /* mirrors raced at once for a file with no preferred mirror yet */
+        static constexpr std::size_t race_width = 3;
+
+
+        struct target
+        {
+            std::string repo; /* the key for the preferred mirror, the url for unknown ones */
+            std::string filename;
+
+            std::vector<std::string> servers; /* first one is tried first */
+        };
+
+
+        enum class fetched : std::uint8_t
+        {
+            downloaded,
+            unchanged, /* the mirror answered 304, the file was left as it was */
+        };
+
+
+        fetcher(std::shared_ptr<http::client> http, config &cfg);
+
+
+        auto fetch(std::string_view url, const std::filesystem::path &dir, bool force)
+            -> result<fetched>;
+
+
+        /* downloads @p filenames of @p repo into @p dir, @p parallel at a time; files that
+           are already there are skipped and failures are left for libalpm to retry */
+        void prefetch(const std::vector<std::pair<std::string, std::string>> &files,
+                      const std::filesystem::path                            &dir,
+                      std::size_t                                             parallel);
+
+
+        static auto callback(void *ctx, const char *url, const char *localpath, int force)
+            -> int;
+
+    private:
+        struct race;
+
+        std::shared_ptr<http::client> m_http;
+        config                       &m_config;
+
+        std::map<std::string, std::string> m_preferred; /* main loop only */
+
+
+        [[nodiscard]]
+        auto mf_resolve(std::string_view url) const -> target;
+
+
+        void mf_start(const std::shared_ptr<race> &r);
+        void mf_claim(const std::shared_ptr<race> &r, std::size_t i);
+        void mf_finish(const std::shared_ptr<race> &r, bool ok);
+        void mf_segment(const std::shared_ptr<race> &r, curl_off_t size);
+    };
+}
@@ -12,13 +12,53 @@
 
 namespace aurgh::alpm
 {
+    /* every sync package, details[i] belongs to packages[i] */
+    struct sync_index
+    {
+        std::vector<package>         packages;
+        std::vector<package_details> details;
+    };
+
+
+    /* what a refresh changed, by package name within each downloaded database */
+    struct sync_delta
+    {
+        std::vector<std::string> repos; /* databases the mirror had a newer copy of */
+        std::vector<package>     added;
+        std::vector<package>     changed; /* a new version, downgrades included */
+        std::vector<package>     removed;
+    };
+
+
+    /* what reloading pacman.conf changed on a live handle */
+    struct config_delta
+    {
+        std::vector<std::string> repos; /* databases unregistered or registered anew */
+
+        std::vector<std::filesystem::path> sources; /* what the reloaded config was read from */
+    };
+
+
+    struct transaction_request
+    {
+        std::vector<std::string> targets;
+        bool                     refresh    = false; /* -y */
+        bool                     sysupgrade = false; /* -u */
+    };
+
+
     class handle
     {
         using alpm_destructor = util::destructor<alpm_handle_t, alpm_release>;
 
     public:
         [[nodiscard]]
-        static auto create(const std::filesystem::path &config = "/etc/pacman.conf") noexcept
+        /* with @p http, downloads race mirrors through it instead of libalpm's downloader;
+           @p config_cache is where the parsed @p config is kept between starts */
+        static auto create(const std::filesystem::path   &config       = "/etc/pacman.conf",
+                           std::shared_ptr<http::client>  http         = nullptr,
+                           std::shared_ptr<mirror_scores> mirrors      = nullptr,
+                           const std::filesystem::path   &config_cache = {}) noexcept
             -> result<handle>;
 
 
@@ -38,10 +78,55 @@ namespace aurgh::alpm
         auto info(std::span<const std::string> args) noexcept
             -> result<std::vector<package_details>>;
 
+
+        /* reads every sync database now instead of on the first lookup */
+        void preload() noexcept;
+
+
+        [[nodiscard]]
+        auto index() noexcept -> result<sync_index>;
+
+
+        /* -Sy on its own; databases the mirror answers 304 for are neither downloaded nor
+           read again, the others are compared package by package with what they replaced */
+        [[nodiscard]]
+        auto refresh(bool force) noexcept -> result<sync_delta>;
+
+
+        /* a sync transaction from start to commit; returns what was installed or upgraded.
+           libalpm downloads, checks and extracts inside the single commit call */
+        auto transaction(const transaction_request &request) noexcept
+            -> result<std::vector<package>>;
+
+
+        /* applies the current mirror scores to the registered databases */
+        auto reorder_servers() noexcept -> result<void>;
+
+
+        /* parses the configuration again and applies what changed to this handle, keeping
+           every database that is still registered the same way loaded */
+        [[nodiscard]]
+        auto reload() noexcept -> result<config_delta>;
+
+
+        /* its signals are how transactions report back */
+        [[nodiscard]]
+        auto
+        configuration() noexcept -> config &
+        { return *m_config; }
+
+
+        /* when the newest sync database was last written, without reading any of them */
+        [[nodiscard]]
+        auto sync_time() const noexcept -> std::filesystem::file_time_type;
+
     private:
         std::unique_ptr<alpm_handle_t, alpm_destructor> m_handle;
         std::unique_ptr<config>                         m_config;
 
+        std::filesystem::path m_config_path;
+        std::filesystem::path m_config_cache;
+
         std::vector<std::string_view> m_repos;
     };
 }
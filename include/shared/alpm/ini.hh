@@ -1,7 +1,7 @@
 #pragma once
 #include <filesystem>
-#include <fstream>
 
+#include "mapped_file.hh"
 #include "result.hh"
 #include "utils.hh"
 
@@ -18,25 +18,32 @@ namespace aurgh::ini
     };
 
 
+    /* the file is mapped and split in place, every view handed to @p callback points into
+       the mapping and only lives as long as the call that received it */
     template <typename F>
     auto
     parse(const std::filesystem::path &file,
           F                          &&callback,
-          std::string                  section_override = {}) noexcept -> result<void>
+          std::string_view             section_override = {}) noexcept -> result<void>
         requires std::is_invocable_v<F, callback_data>
     {
-        std::ifstream stream { file };
+        auto mapped = mapped_file::open(file);
 
-        if (!stream.good())
-            return error { "failed to open config file ({})", file.c_str() }.unexpected();
+        if (!mapped)
+            return error { "failed to open config file ({}): {}", file.c_str(),
+                           mapped.error().message() }
+                .unexpected();
 
-        std::string section  = std::move(section_override);
-        std::size_t line_num = 0;
+        std::string_view rest = mapped->view();
 
-        callback_data data { .filepath = file.c_str(), .section = section }; /* NOLINT */
+        callback_data data { .filepath = file.c_str(), .section = section_override }; /* NOLINT */
 
-        for (std::string line; std::getline(stream, line); line_num++)
+        for (std::size_t line_num = 0; !rest.empty(); line_num++)
         {
+            std::size_t      end  = rest.find('\n');
+            std::string_view line = rest.substr(0, end);
+            rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+
             std::string_view trimmed { line | views::trim };
 
             if (trimmed.empty() or trimmed.starts_with('#')) continue;
@@ -46,8 +53,7 @@ namespace aurgh::ini
 
             if (trimmed.starts_with('[') and trimmed.ends_with(']'))
             {
-                section      = trimmed.substr(1, trimmed.length() - 2);
-                data.section = section;
+                data.section = trimmed.substr(1, trimmed.length() - 2);
 
                 if (aurgh::result<void> res = callback(data); !res.has_value())
                     return res.error().unexpected();
@@ -67,8 +73,6 @@ namespace aurgh::ini
                 return res.error().unexpected();
         }
 
-        if (!stream and !stream.eof())
-            return error { "failed to read config file ({})", file.c_str() }.unexpected();
         return {};
     }
 }
@@ -0,0 +1,85 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "http/client.hh"
+#include "result.hh"
+
+
+namespace aurgh::alpm
+{
+    struct repo;
+
+
+    /* how well each mirror host has done lately, kept as "<latency us> <bytes/s> <penalty>
+       <unix time> <host>" lines. Old samples count for less the older they get, so a mirror
+       that was slow last week is given another chance. Safe from any thread. */
+    class mirror_scores : public std::enable_shared_from_this<mirror_scores>
+    {
+    public:
+        using clock = std::chrono::system_clock;
+
+        /* a sample loses half its weight over this long */
+        static constexpr std::chrono::hours half_life { 24 };
+
+        /* the cost of a host never measured, between a good mirror and a bad one */
+        static constexpr std::chrono::milliseconds unknown_cost { 1000 };
+
+        /* probes read this much of each repository's database */
+        static constexpr curl_off_t probe_bytes = 64 * 1024;
+
+
+        [[nodiscard]]
+        static auto load(std::filesystem::path path) noexcept
+            -> result<std::shared_ptr<mirror_scores>>;
+
+
+        auto save() const noexcept -> result<void>;
+
+
+        /* folds one download from @p server into its host's score */
+        void record(std::string_view server, const http::timings &timings);
+        void record_failure(std::string_view server);
+
+
+        /* the estimated time to fetch probe_bytes, which is what servers are ordered by */
+        [[nodiscard]]
+        auto cost(std::string_view server) const -> std::chrono::microseconds;
+
+
+        /* cheapest first; servers that cost the same keep their pacman.conf order */
+        void rank(std::vector<std::string> &servers) const;
+
+
+        /* measures every server of @p repos at once through @p http on the main loop and
+           calls @p done there when the last one answered or failed */
+        void probe(http::client &http, const std::vector<repo> &repos, std::function<void()> done);
+
+    private:
+        struct entry
+        {
+            double            latency    = 0; /* microseconds */
+            double            throughput = 0; /* bytes per second */
+            double            penalty    = 0; /* failures, decayed like the samples */
+            clock::time_point updated;
+        };
+
+        std::filesystem::path m_path;
+
+        mutable std::mutex           m_mutex;
+        std::map<std::string, entry> m_hosts;
+
+
+        [[nodiscard]]
+        static auto host_of(std::string_view server) -> std::string;
+
+        [[nodiscard]]
+        static auto weight_of(const entry &e, clock::time_point now) -> double;
+    };
+}
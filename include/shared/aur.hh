@@ -1,8 +1,11 @@
 #pragma once
+#include <format>
+
 #include <nlohmann/json.hpp>
 
 #include "http/client.hh"
 #include "package.hh"
+#include "trace.hh"
 
 
 namespace aurgh
@@ -12,6 +15,13 @@ namespace aurgh
         static constexpr auto URL = "https://aur.archlinux.org/rpc/v5";
 
     public:
+        /* every split package of a base is served by the one repository */
+        [[nodiscard]]
+        static auto
+        git_url(std::string_view pkgbase) -> std::string
+        { return std::format("https://aur.archlinux.org/{}.git", pkgbase); }
+
+
         template <typename T>
         class request
         {
@@ -43,7 +53,8 @@ namespace aurgh
         private:
             std::shared_ptr<http::transfer> m_transfer;
 
-            std::string m_buffer;
+            std::string   m_buffer;
+            std::uint64_t m_trace_id = trace::current_id();
 
             result_signal m_signal_on_result;
             error_signal  m_signal_on_error;
@@ -57,6 +68,8 @@ namespace aurgh
                 m_transfer->on_complete(
                     [this](http::completion complete)
                     {
+                        AURGH_TRACE_ID_SCOPE(m_trace_id);
+
                         if (complete.curl_result != CURLE_OK)
                         {
                             m_signal_on_error.emit(
@@ -76,6 +89,7 @@ namespace aurgh
 
                         try
                         {
+                            AURGH_TRACE_SPAN("aur", "json::parse");
                             response = nlohmann::json::parse(m_buffer);
                         }
                         catch (const std::exception &e)
@@ -85,7 +99,13 @@ namespace aurgh
                             return;
                         }
 
-                        if (auto res = m_parser(response); res.has_value())
+                        auto res = [&]
+                        {
+                            AURGH_TRACE_SPAN("aur", "decode");
+                            return m_parser(response);
+                        }();
+
+                        if (res.has_value())
                             m_signal_on_result.emit(std::move(res.value()));
                         else
                             m_signal_on_error.emit(res.error());
@@ -0,0 +1,299 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include <sdbus-c++/sdbus-c++.h>
+
+#include "mapped_file.hh"
+#include "package.hh"
+#include "result.hh"
+
+
+/* Large results handed between processes as a sealed memfd.
+ *
+ * The file is a header, an array of fixed-size records, a table of string
+ * references for list fields and one blob with every string. Records only
+ * hold offsets, so a reader maps the file and uses it as it is.
+ */
+namespace aurgh::bulk
+{
+    inline constexpr std::uint32_t magic   = 0x42525541; /* "AURB" */
+    inline constexpr std::uint16_t version = 1;
+
+
+    enum class kind : std::uint16_t
+    {
+        packages = 1,
+        details  = 2,
+    };
+
+
+    struct string_ref
+    {
+        std::uint32_t offset; /* into the string blob */
+        std::uint32_t size;
+    };
+
+
+    struct list_ref
+    {
+        std::uint32_t first; /* into the reference table */
+        std::uint32_t count;
+    };
+
+
+    struct header
+    {
+        std::uint32_t magic;
+        std::uint16_t version;
+        kind          type;
+        std::uint32_t count;
+        std::uint32_t ref_count;
+        std::uint64_t records_offset;
+        std::uint64_t refs_offset;
+        std::uint64_t strings_offset;
+        std::uint64_t strings_size;
+    };
+
+
+    struct package_record
+    {
+        string_ref name;
+        string_ref version;
+        string_ref description;
+        string_ref repo;
+        string_ref base;
+    };
+
+
+    struct details_record
+    {
+        list_ref     licenses;
+        list_ref     depends;
+        list_ref     make_depends;
+        list_ref     opt_depends;
+        string_ref   url;
+        string_ref   base;
+        std::int64_t last_updated;
+    };
+
+
+    /* the returned memfd is sealed against writes and resizing */
+    [[nodiscard]]
+    auto write(std::span<const package> packages) noexcept -> result<sdbus::UnixFd>;
+
+    [[nodiscard]]
+    auto write(std::span<const package_details> details) noexcept -> result<sdbus::UnixFd>;
+
+
+    /* the same layout kept on disk, replaced atomically */
+    auto save(std::span<const package> packages, const std::filesystem::path &path) noexcept
+        -> result<void>;
+
+    auto save(std::span<const package_details> details, const std::filesystem::path &path) noexcept
+        -> result<void>;
+
+
+    class strings
+    {
+    public:
+        strings(const char *blob, const string_ref *refs, list_ref list) noexcept
+            : m_blob { blob }, m_refs { refs + list.first }, m_count { list.count }
+        {
+        }
+
+
+        [[nodiscard]]
+        auto
+        size() const noexcept -> std::size_t
+        { return m_count; }
+
+
+        [[nodiscard]]
+        auto
+        operator[](std::size_t i) const noexcept -> std::string_view
+        { return { m_blob + m_refs[i].offset, m_refs[i].size }; }
+
+    private:
+        const char       *m_blob;
+        const string_ref *m_refs;
+        std::uint32_t     m_count;
+    };
+
+
+    class package_view
+    {
+    public:
+        package_view(const char *blob, const package_record *record) noexcept
+            : m_blob { blob }, m_record { record }
+        {
+        }
+
+
+        [[nodiscard]]
+        auto
+        name() const noexcept -> std::string_view
+        { return get(m_record->name); }
+
+
+        [[nodiscard]]
+        auto
+        version() const noexcept -> std::string_view
+        { return get(m_record->version); }
+
+
+        [[nodiscard]]
+        auto
+        description() const noexcept -> std::string_view
+        { return get(m_record->description); }
+
+
+        [[nodiscard]]
+        auto
+        repo() const noexcept -> std::string_view
+        { return get(m_record->repo); }
+
+
+        [[nodiscard]]
+        auto
+        base() const noexcept -> std::string_view
+        { return get(m_record->base); }
+
+    private:
+        const char           *m_blob;
+        const package_record *m_record;
+
+
+        [[nodiscard]]
+        auto
+        get(string_ref ref) const noexcept -> std::string_view
+        { return { m_blob + ref.offset, ref.size }; }
+    };
+
+
+    class details_view
+    {
+    public:
+        details_view(const char           *blob,
+                     const string_ref     *refs,
+                     const details_record *record) noexcept
+            : m_blob { blob }, m_refs { refs }, m_record { record }
+        {
+        }
+
+
+        [[nodiscard]]
+        auto
+        licenses() const noexcept -> strings
+        { return list(m_record->licenses); }
+
+
+        [[nodiscard]]
+        auto
+        depends() const noexcept -> strings
+        { return list(m_record->depends); }
+
+
+        [[nodiscard]]
+        auto
+        make_depends() const noexcept -> strings
+        { return list(m_record->make_depends); }
+
+
+        [[nodiscard]]
+        auto
+        opt_depends() const noexcept -> strings
+        { return list(m_record->opt_depends); }
+
+
+        [[nodiscard]]
+        auto
+        url() const noexcept -> std::string_view
+        { return get(m_record->url); }
+
+
+        [[nodiscard]]
+        auto
+        base() const noexcept -> std::string_view
+        { return get(m_record->base); }
+
+
+        [[nodiscard]]
+        auto
+        last_updated() const noexcept -> std::chrono::seconds
+        { return std::chrono::seconds { m_record->last_updated }; }
+
+    private:
+        const char           *m_blob;
+        const string_ref     *m_refs;
+        const details_record *m_record;
+
+
+        [[nodiscard]]
+        auto
+        get(string_ref ref) const noexcept -> std::string_view
+        { return { m_blob + ref.offset, ref.size }; }
+
+
+        [[nodiscard]]
+        auto
+        list(list_ref ref) const noexcept -> strings
+        { return { m_blob, m_refs, ref }; }
+    };
+
+
+    /* a validated mapping of a bulk file; views point into it and die with it */
+    template <kind K> class table
+    {
+        using record_type = std::conditional_t<K == kind::packages, package_record, details_record>;
+        using view_type   = std::conditional_t<K == kind::packages, package_view, details_view>;
+
+    public:
+        [[nodiscard]]
+        static auto open(int fd) noexcept -> result<table>;
+
+        /* a file written by save, it is not sealed so it must not change while loaded */
+        [[nodiscard]]
+        static auto load(const std::filesystem::path &path) noexcept -> result<table>;
+
+
+        [[nodiscard]]
+        auto
+        size() const noexcept -> std::size_t
+        { return m_header->count; }
+
+
+        [[nodiscard]]
+        auto
+        operator[](std::size_t i) const noexcept -> view_type
+        {
+            if constexpr (K == kind::packages)
+                return { m_blob, m_records + i };
+            else
+                return { m_blob, m_refs, m_records + i };
+        }
+
+    private:
+        mapped_file m_file;
+
+        const header      *m_header;
+        const record_type *m_records;
+        const string_ref  *m_refs;
+        const char        *m_blob;
+
+
+        table(mapped_file &&file) noexcept;
+
+
+        [[nodiscard]]
+        static auto validate(mapped_file &&file) noexcept -> result<table>;
+    };
+
+
+    using package_table = table<kind::packages>;
+    using details_table = table<kind::details>;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sdbus-c++/sdbus-c++.h>
+#include <sigc++/connection.h>
+
+#include "package.hh"
+#include "result.hh"
+
+
+/* what aurgh-daemon and its clients agree on over the session bus, and aurgh-helper and
+   its clients over the system bus */
+namespace aurgh::bus
+{
+    inline constexpr auto service_name   = "org.kei.aurgh.Daemon";
+    inline constexpr auto object_path    = "/org/kei/aurgh/Daemon";
+    inline constexpr auto interface_name = "org.kei.aurgh.Daemon";
+    inline constexpr auto error_name     = "org.kei.aurgh.Daemon.Error";
+
+    inline constexpr auto helper_service_name   = "org.kei.aurgh.Helper";
+    inline constexpr auto helper_object_path    = "/org/kei/aurgh/Helper";
+    inline constexpr auto helper_interface_name = "org.kei.aurgh.Helper";
+
+
+    /* name, version, description, repo, base */
+    using package_record
+        = sdbus::Struct<std::string, std::string, std::string, std::string, std::string>;
+
+    /* licenses, depends, make depends, opt depends, url, last updated, base */
+    using details_record = sdbus::Struct<std::vector<std::string>,
+                                         std::vector<std::string>,
+                                         std::vector<std::string>,
+                                         std::vector<std::string>,
+                                         std::string,
+                                         std::int64_t,
+                                         std::string>;
+
+    /* step (download, install, upgrade, ...), target, fraction done */
+    using progress_record = sdbus::Struct<std::string, std::string, double>;
+
+
+    [[nodiscard]] auto to_record(const package &pkg) -> package_record;
+    [[nodiscard]] auto to_record(const package_details &details) -> details_record;
+    [[nodiscard]] auto from_record(package_record &&record) -> package;
+    [[nodiscard]] auto from_record(details_record &&record) -> package_details;
+
+
+    [[nodiscard]]
+    auto to_error(const error &err) -> sdbus::Error;
+
+
+    /* dispatches the events of a connection from the default Glib main context,
+       so handlers and async replies run on the main loop like everything else */
+    class main_loop_source
+    {
+    public:
+        explicit main_loop_source(sdbus::IConnection &connection);
+        ~main_loop_source();
+
+        main_loop_source(const main_loop_source &)                     = delete;
+        auto operator=(const main_loop_source &) -> main_loop_source & = delete;
+
+    private:
+        sdbus::IConnection &m_connection;
+
+        int   m_fd     = -1;
+        short m_events = 0;
+
+        sigc::connection m_io;
+        sigc::connection m_wakeup;
+        sigc::connection m_timer;
+
+
+        void mf_refresh();
+        auto mf_dispatch() -> bool;
+    };
+}
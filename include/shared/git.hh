@@ -0,0 +1,143 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <stop_token>
+
+#include <git2/annotated_commit.h>
+#include <git2/object.h>
+#include <git2/refs.h>
+#include <git2/remote.h>
+#include <git2/repository.h>
+#include <git2/worktree.h>
+#include <glibmm/dispatcher.h>
+#include <sigc++/signal.h>
+
+#include "git/executor.hh"
+#include "progress.hh"
+#include "result.hh"
+#include "utils.hh"
+
+
+namespace aurgh::git
+{
+    enum class layout : std::uint8_t
+    {
+        standalone, /* every package is a repository of its own */
+        worktree,   /* packages are worktrees of one bare store under the clone directory */
+    };
+
+
+    class cloning
+    {
+        using transfer_progress_signal = sigc::signal<void(double)>;
+        using completed_signal         = sigc::signal<void(std::filesystem::path)>;
+        using error_signal             = sigc::signal<void(error)>;
+
+        using repository_destructor = util::destructor<git_repository, git_repository_free>;
+        using worktree_destructor   = util::destructor<git_worktree, git_worktree_free>;
+        using remote_destructor     = util::destructor<git_remote, git_remote_free>;
+        using reference_destructor  = util::destructor<git_reference, git_reference_free>;
+        using object_destructor     = util::destructor<git_object, git_object_free>;
+        using annotated_commit_destructor
+            = util::destructor<git_annotated_commit, git_annotated_commit_free>;
+
+    public:
+        cloning(std::string_view url, std::filesystem::path base, layout mode);
+        cloning(const cloning &)                     = delete;
+        auto operator=(const cloning &) -> cloning & = delete;
+
+
+        auto
+        on_transfer_progress(const transfer_progress_signal::slot_type &slot) -> cloning &
+        {
+            m_signal_on_transfer_progress.connect(slot);
+            return *this;
+        }
+
+
+        auto
+        on_completed(const completed_signal::slot_type &slot) -> cloning &
+        {
+            m_signal_on_completed.connect(slot);
+            return *this;
+        }
+
+
+        auto
+        on_error(const error_signal::slot_type &slot) -> cloning &
+        {
+            m_signal_on_error.connect(slot);
+            return *this;
+        }
+
+
+        void cancel();
+
+    private:
+        std::string           m_url;
+        std::filesystem::path m_base;
+        std::filesystem::path m_dst;
+        layout                m_layout;
+
+        std::stop_source m_stop_source;
+
+        progress::slot m_progress;
+
+        std::optional<error> m_pending_error;
+
+        Glib::Dispatcher m_dispatch_done;
+
+        transfer_progress_signal m_signal_on_transfer_progress;
+        completed_signal         m_signal_on_completed;
+        error_signal             m_signal_on_error;
+
+
+        friend auto clone(std::string_view,
+                          std::filesystem::path,
+                          executor &,
+                          executor::priority,
+                          layout) noexcept -> result<std::shared_ptr<cloning>>;
+
+        void mf_run();
+        auto mf_clone() -> result<void>;
+        auto mf_update(git_repository *repo) -> result<void>;
+        auto mf_store() -> result<void>;
+        auto mf_materialize(git_repository *store, const std::string &name, const git_oid *target)
+            -> result<void>;
+        /* @p shared_refs when @p head is a branch of the shared store, it is then updated
+           under the store lock */
+        auto mf_fast_forward(git_repository *repo,
+                             git_reference  *head,
+                             const git_oid  *target,
+                             bool            shared_refs) -> result<void>;
+        void mf_on_done();
+
+        static auto transfer_progress_callback(const git_indexer_progress *stats, void *payload)
+            -> int;
+    };
+
+
+    /* the message of the last libgit2 error on this thread */
+    [[nodiscard]]
+    auto last_error() noexcept -> std::string_view;
+
+
+    /* libgit2 is initialized once and stays so until the process exits */
+    [[nodiscard]]
+    auto init() noexcept -> result<void>;
+
+
+    /* the directory a clone of @p url ends up in, e.g. "foo" for ".../foo.git"; an error
+       for urls that name no directory of its own, such as ".../.." or ".../.git" */
+    [[nodiscard]]
+    auto repository_name(std::string_view url) noexcept -> result<std::string>;
+
+
+    [[nodiscard]]
+    auto clone(std::string_view     url,
+               std::filesystem::path base,
+               executor             &exec,
+               executor::priority    prio = executor::priority::normal,
+               layout                mode = layout::standalone) noexcept
+        -> result<std::shared_ptr<cloning>>;
+}
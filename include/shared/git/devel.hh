@@ -0,0 +1,80 @@
+#pragma once
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "git/request.hh"
+
+
+namespace aurgh::git
+{
+    /* a VCS entry of a source= array, e.g. "name::git+https://host/repo.git#branch=main" */
+    struct vcs_source
+    {
+        std::string url; /* without the "git+" prefix and the fragment */
+        std::string ref; /* what the remote is asked for, HEAD or a full ref name */
+
+
+        /* packages sharing an upstream are rebuilt apart, so each has its own key for it;
+           no pkgbase contains a ':' */
+        [[nodiscard]]
+        auto
+        key(std::string_view pkgbase) const -> std::string
+        { return std::format("{}:{}#{}", pkgbase, url, ref); }
+
+
+        /* nullopt for plain sources and sources pinned to a commit, an error for VCSs other than
+           git, which libgit2 cannot query */
+        [[nodiscard]]
+        static auto parse(std::string_view source) -> result<std::optional<vcs_source>>;
+    };
+
+
+    /* last-seen upstream commit per package and source key, stored as "<key> <hex oid>" lines */
+    class devel_cache
+    {
+    public:
+        using map_type = std::map<std::string, std::string, std::less<>>;
+
+
+        [[nodiscard]]
+        static auto load(std::filesystem::path path) noexcept -> result<devel_cache>;
+
+
+        auto save() const noexcept -> result<void>;
+
+
+        [[nodiscard]]
+        auto
+        commits() const noexcept -> const map_type &
+        { return m_commits; }
+
+
+        void
+        set(std::string key, std::string commit)
+        { m_commits.insert_or_assign(std::move(key), std::move(commit)); }
+
+    private:
+        std::filesystem::path m_path;
+        map_type              m_commits;
+    };
+
+
+    struct devel_report
+    {
+        std::vector<std::filesystem::path>                     outdated; /* clones to rebuild */
+        std::map<std::filesystem::path, devel_cache::map_type> heads; /* seen upstream commits */
+        std::vector<std::pair<std::filesystem::path, error>>   failed;
+    };
+
+
+    /* queries the upstream of every VCS source of @p clones, at most @p concurrency at a time;
+       a clone is outdated once any of its sources moved away from the commit in @p seen */
+    [[nodiscard]]
+    auto find_devel_updates(std::vector<std::filesystem::path> clones,
+                            devel_cache::map_type              seen,
+                            executor                          &exec,
+                            std::size_t concurrency = executor::default_concurrency)
+        -> std::shared_ptr<request<devel_report>>;
+}
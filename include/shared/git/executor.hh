@@ -0,0 +1,125 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "result.hh"
+#include "trace.hh"
+
+
+namespace aurgh::git
+{
+    class executor
+    {
+    public:
+        enum class priority : std::uint8_t
+        {
+            low,
+            normal,
+            high,
+        };
+
+        using job = std::move_only_function<void()>;
+
+        static constexpr std::size_t default_concurrency = 4;
+
+
+        [[nodiscard]]
+        static auto create(std::size_t concurrency = default_concurrency) noexcept
+            -> result<std::shared_ptr<executor>>;
+
+
+        ~executor();
+        executor(const executor &)                     = delete;
+        auto operator=(const executor &) -> executor & = delete;
+
+
+        /* jobs of the same priority are run in submission order; @p on_drop is called
+           instead of @p fn when the executor is destroyed before @p fn started */
+        void submit(job fn, priority prio = priority::normal, job on_drop = nullptr);
+
+
+        [[nodiscard]]
+        auto concurrency() const noexcept -> std::size_t;
+
+    private:
+        struct entry
+        {
+            priority      prio;
+            std::uint64_t sequence;
+            job           fn;
+            job           on_drop;
+            std::uint64_t trace_id = trace::current_id(); /* of the submitter */
+        };
+
+        std::vector<std::thread> m_workers;
+
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+        std::vector<entry>      m_queue; /* binary heap, see `before` */
+        std::uint64_t           m_sequence = 0;
+        bool                    m_stopping = false;
+
+
+        explicit executor(std::size_t concurrency);
+
+        void mf_run();
+
+        static auto before(const entry &lhs, const entry &rhs) noexcept -> bool;
+    };
+
+
+    /* calls @p fn for every index below @p count from at most @p concurrency jobs, and @p done
+       once from whichever job finishes last; @p fn returning false stops the loop early */
+    template <typename F, typename D>
+    void
+    parallel_for(executor          &exec,
+                 std::size_t        count,
+                 std::size_t        concurrency,
+                 F                &&fn,
+                 D                &&done,
+                 executor::priority prio = executor::priority::low)
+        requires std::is_invocable_r_v<bool, F, std::size_t> and std::is_invocable_v<D>
+    {
+        struct state
+        {
+            std::size_t              count;
+            std::atomic<std::size_t> next = 0;
+            std::atomic<std::size_t> workers;
+
+            std::decay_t<F> fn;
+            std::decay_t<D> done;
+        };
+
+        if (count == 0)
+        {
+            done();
+            return;
+        }
+
+        std::size_t workers = std::min(std::max<std::size_t>(concurrency, 1), count);
+        auto        shared  = std::make_shared<state>(count, 0, workers, std::forward<F>(fn),
+                                                      std::forward<D>(done));
+
+        for (std::size_t i = 0; i < workers; i++)
+            exec.submit(
+                [shared]
+                {
+                    for (std::size_t i; (i = shared->next++) < shared->count;)
+                        if (!shared->fn(i)) break;
+
+                    if (--shared->workers == 0) shared->done();
+                },
+                prio,
+                [shared]
+                {
+                    if (--shared->workers == 0) shared->done();
+                });
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+
+#include <git2/oid.h>
+
+#include "git/request.hh"
+
+
+namespace aurgh::git
+{
+    struct head_files
+    {
+        git_oid     commit;
+        std::string pkgbuild;
+        std::string srcinfo;
+    };
+
+
+    /* fetches just HEAD of @p url and reads PKGBUILD and .SRCINFO out of it, no checkout is made */
+    [[nodiscard]]
+    auto fetch_head_files(std::string_view url) noexcept -> result<head_files>;
+
+
+    [[nodiscard]]
+    auto peek(std::string_view   url,
+              executor          &exec,
+              executor::priority prio = executor::priority::normal)
+        -> std::shared_ptr<request<head_files>>;
+}
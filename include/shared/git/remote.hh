@@ -0,0 +1,46 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+#include <git2/oid.h>
+
+#include "git/request.hh"
+
+
+namespace aurgh::git
+{
+    struct moved_repo
+    {
+        std::filesystem::path path;
+        std::string           url;
+        git_oid               local;
+        git_oid               remote;
+    };
+
+
+    struct update_report
+    {
+        std::vector<moved_repo>                              moved;
+        std::vector<std::pair<std::filesystem::path, error>> failed;
+    };
+
+
+    /* what @p ref of @p url points to, only the ref advertisement is transferred */
+    [[nodiscard]]
+    auto remote_head(std::string_view url, std::string_view ref = "HEAD") noexcept
+        -> result<git_oid>;
+
+
+    /* every clone under @p clone_dir, whichever layout it was made with */
+    [[nodiscard]]
+    auto list_clones(const std::filesystem::path &clone_dir) noexcept
+        -> result<std::vector<std::filesystem::path>>;
+
+
+    /* compares the HEAD of every clone against its remote, at most @p concurrency at a time */
+    [[nodiscard]]
+    auto find_updates(std::vector<std::filesystem::path> clones,
+                      executor                          &exec,
+                      std::size_t concurrency = executor::default_concurrency)
+        -> std::shared_ptr<request<update_report>>;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <optional>
+
+#include <glibmm/dispatcher.h>
+#include <sigc++/signal.h>
+
+#include "git/executor.hh"
+#include "result.hh"
+
+
+namespace aurgh::git
+{
+    /* a job run on an executor whose result is delivered on the main loop */
+    template <typename T>
+    class request
+    {
+        using error_signal  = sigc::signal<void(error)>;
+        using result_signal = sigc::signal<void(T)>;
+
+    public:
+        /* must be called on the main loop */
+        [[nodiscard]]
+        static auto
+        create() -> std::shared_ptr<request>
+        { return std::shared_ptr<request> { new request {} }; }
+
+
+        template <typename F>
+        [[nodiscard]]
+        static auto
+        submit(executor &exec, F &&work, executor::priority prio = executor::priority::normal)
+            -> std::shared_ptr<request>
+            requires std::is_invocable_r_v<result<T>, F>
+        {
+            auto req = create();
+
+            exec.submit(
+                [req, work = std::forward<F>(work)] mutable
+                {
+                    if (!req->cancelled()) req->complete(work());
+                },
+                prio,
+                [req]
+                { req->complete(error { "the job was cancelled at shutdown" }.unexpected()); });
+
+            return req;
+        }
+
+
+        /* may be called from any thread, but only once */
+        void
+        complete(result<T> res)
+        {
+            m_result = std::move(res);
+            m_dispatcher.emit();
+        }
+
+
+        [[nodiscard]]
+        auto
+        cancelled() const noexcept -> bool
+        { return m_cancelled; }
+
+
+        auto
+        on_result(const typename result_signal::slot_type &slot) -> request &
+        {
+            m_signal_on_result.connect(slot);
+            return *this;
+        }
+
+
+        auto
+        on_error(const typename error_signal::slot_type &slot) -> request &
+        {
+            m_signal_on_error.connect(slot);
+            return *this;
+        }
+
+
+        /* a job that has not started yet is skipped, a running one is only muted */
+        void
+        cancel()
+        { m_cancelled = true; }
+
+    private:
+        Glib::Dispatcher         m_dispatcher;
+        std::optional<result<T>> m_result;
+        std::atomic<bool>        m_cancelled = false;
+
+        error_signal  m_signal_on_error;
+        result_signal m_signal_on_result;
+
+
+        request()
+        {
+            m_dispatcher.connect(
+                [this]
+                {
+                    if (m_cancelled or !m_result.has_value()) return;
+
+                    if (m_result->has_value())
+                        m_signal_on_result.emit(std::move(m_result->value()));
+                    else
+                        m_signal_on_error.emit(m_result->error());
+                });
+        }
+    };
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <memory>
+
+#include "http/client.hh"
+#include "result.hh"
+
+
+namespace aurgh::git
+{
+    /* routes libgit2's http(s) smart protocol through @p client, so clones share its connections,
+       TLS sessions and limits; the client keeps running on the main loop, libgit2 must not */
+    [[nodiscard]]
+    auto register_http_transport(const std::shared_ptr<http::client> &client) noexcept
+        -> result<void>;
+}
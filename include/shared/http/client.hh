@@ -19,12 +19,19 @@ namespace aurgh::http
         [[nodiscard]] static auto create() noexcept -> result<std::shared_ptr<client>>;
 
 
+        /* at most this many connections are opened to one host, the rest are multiplexed */
+        static constexpr long max_host_connections = 6;
+
+
         [[nodiscard]]
-        auto get(const std::string &url) noexcept -> result<std::shared_ptr<transfer>>;
+        auto get(const std::string &url, const std::vector<std::string> &headers = {}) noexcept
+            -> result<std::shared_ptr<transfer>>;
 
 
         [[nodiscard]]
-        auto post(const std::string &url, std::string body) noexcept
+        auto post(const std::string              &url,
+                  std::string                     body,
+                  const std::vector<std::string> &headers = {}) noexcept
             -> result<std::shared_ptr<transfer>>;
 
 
@@ -48,9 +55,11 @@ namespace aurgh::http
         static void check_completed(client *client);
 
 
-        auto mf_add_transfer(const std::string &url,
-                             std::string_view   method,
-                             std::string body = {}) noexcept -> result<std::shared_ptr<transfer>>;
+        auto mf_add_transfer(const std::string              &url,
+                             std::string_view                method,
+                             std::string                     body    = {},
+                             const std::vector<std::string> &headers = {}) noexcept
+            -> result<std::shared_ptr<transfer>>;
 
 
         client();
@@ -0,0 +1,35 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "result.hh"
+
+
+namespace aurgh::http
+{
+    /* hands a response body received on the main loop to a blocking reader on another thread */
+    class pipe
+    {
+    public:
+        void push(std::string_view data);
+        void close();
+        void fail(std::string message);
+
+
+        /* blocks until there is data to copy; 0 means the body has ended */
+        [[nodiscard]]
+        auto read(char *buffer, std::size_t size) -> result<std::size_t>;
+
+    private:
+        std::mutex              m_mutex;
+        std::condition_variable m_cv;
+
+        std::deque<std::string>    m_chunks;
+        std::size_t                m_offset = 0; /* into m_chunks.front() */
+        bool                       m_closed = false;
+        std::optional<std::string> m_error;
+    };
+}
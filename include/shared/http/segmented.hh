@@ -0,0 +1,120 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sigc++/signal.h>
+
+#include "http/client.hh"
+
+
+namespace aurgh::http
+{
+    /* one file fetched as concurrent Range requests for fixed-size chunks, spread over one
+       or several mirrors of it and written at their offsets into a preallocated file. A
+       chunk that stalls or runs far behind the others is cancelled and its remainder handed
+       to another mirror. Main loop only. */
+    class segmented : public std::enable_shared_from_this<segmented>
+    {
+        using progress_signal = sigc::signal<void(double)>;
+        using complete_signal = sigc::signal<void()>;
+        using error_signal    = sigc::signal<void(std::string_view)>;
+
+    public:
+        /* below this, one stream is about as fast and a lot cheaper */
+        static constexpr curl_off_t threshold = 64 * 1024 * 1024;
+
+        static constexpr curl_off_t                chunk_size    = 8 * 1024 * 1024;
+        static constexpr std::size_t               connections   = 4;
+        static constexpr std::chrono::milliseconds check_interval { 1000 };
+
+        /* no data for this long moves a chunk to another mirror */
+        static constexpr std::chrono::seconds stall_timeout { 10 };
+
+        /* nor does running at less than this fraction of the median chunk speed */
+        static constexpr double slow_ratio = 0.25;
+
+        /* a mirror that failed this many chunks gets no more of them */
+        static constexpr std::size_t max_mirror_failures = 3;
+
+
+        /* @p fd stays owned by the caller and must stay open until a signal fired */
+        [[nodiscard]]
+        static auto start(const std::shared_ptr<client> &http,
+                          std::vector<std::string>       urls,
+                          int                            fd,
+                          curl_off_t                     size) noexcept
+            -> result<std::shared_ptr<segmented>>;
+
+
+        auto on_progress(const progress_signal::slot_type &slot) -> segmented &;
+        auto on_complete(const complete_signal::slot_type &slot) -> segmented &;
+        auto on_error(const error_signal::slot_type &slot) -> segmented &;
+
+        void cancel();
+
+
+        /* bytes from the start of the file with no hole before them, what can be resumed */
+        [[nodiscard]]
+        auto contiguous() const noexcept -> curl_off_t;
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        static constexpr std::size_t none = -1;
+
+        struct mirror
+        {
+            std::string url;
+            std::size_t failures = 0;
+        };
+
+        struct chunk
+        {
+            curl_off_t begin;
+            curl_off_t end;         /* exclusive */
+            curl_off_t written = 0; /* from begin, kept across mirrors */
+
+            std::shared_ptr<transfer> active;
+            std::size_t               mirror = 0;
+            clock::time_point         started;
+            clock::time_point         last_data;
+            curl_off_t                received = 0; /* by the active transfer */
+        };
+
+        std::shared_ptr<client> m_http;
+        std::vector<mirror>     m_mirrors;
+        int                     m_fd;
+        curl_off_t              m_size;
+
+        std::vector<chunk> m_chunks;
+        std::size_t        m_next_mirror = 0;
+        std::size_t        m_running     = 0;
+        curl_off_t         m_written     = 0;
+        bool               m_settled     = false;
+
+        sigc::connection m_check;
+
+        progress_signal m_signal_on_progress;
+        complete_signal m_signal_on_complete;
+        error_signal    m_signal_on_error;
+
+
+        segmented(std::shared_ptr<client> http, std::vector<std::string> urls, int fd,
+                  curl_off_t size);
+
+
+        void mf_dispatch();
+        void mf_start_chunk(std::size_t index, std::size_t avoid);
+        void mf_chunk_data(std::size_t index, const transfer *t, std::string_view data);
+        void mf_chunk_done(std::size_t index, const transfer *t, bool ok);
+        void mf_check();
+        void mf_retire(chunk &c);
+        void mf_fail(std::string_view message);
+
+        /* the next usable mirror other than @p avoid if there is one, npos for none at all */
+        [[nodiscard]]
+        auto mf_pick_mirror(std::size_t avoid) -> std::size_t;
+    };
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include <curl/multi.h>
+#include <glibmm/iochannel.h>
+#include <sigc++/connection.h>
+
+#include "result.hh"
+#include "trace.hh"
+#include "utils.hh"
+
+
+namespace aurgh::http
+{
+    struct completion
+    {
+        CURLcode curl_result;
+        int      return_code;
+    };
+
+
+    /* measured by libcurl from the start of the transfer */
+    struct timings
+    {
+        std::chrono::microseconds connect;
+        std::chrono::microseconds first_byte;
+        std::chrono::microseconds total;
+        curl_off_t                bytes; /* body bytes received */
+    };
+
+
+    class transfer final : public sigc::trackable
+    {
+        friend class client;
+
+        using easy_destructor   = util::destructor<CURL, curl_easy_cleanup>;
+        using header_destructor = util::destructor<curl_slist, curl_slist_free_all>;
+
+        using data_signal     = sigc::signal<void(std::string_view)>;
+        using complete_signal = sigc::signal<void(completion)>;
+        using error_signal    = sigc::signal<void(std::string_view)>;
+
+    public:
+        auto on_data(const data_signal::slot_type &slot) -> transfer &;
+        auto on_complete(const complete_signal::slot_type &slot) -> transfer &;
+        auto on_error(const error_signal::slot_type &slot) -> transfer &;
+
+        auto cancel() noexcept -> result<void>;
+
+
+        /* 0 until the response headers have arrived */
+        [[nodiscard]]
+        auto response_code() const noexcept -> int;
+
+
+        /* -1 while unknown, e.g. for chunked responses */
+        [[nodiscard]]
+        auto content_length() const noexcept -> curl_off_t;
+
+
+        /* final once the transfer completed, a snapshot before that */
+        [[nodiscard]]
+        auto measured() const noexcept -> timings;
+
+
+        /* the last response header called @p name, once the headers have arrived */
+        [[nodiscard]]
+        auto header(const std::string &name) const noexcept -> std::optional<std::string>;
+
+    private:
+        class client *m_client;
+
+        std::unique_ptr<CURL, easy_destructor>         m_easy;
+        std::unique_ptr<curl_slist, header_destructor> m_headers;
+        std::string                                    m_request_body;
+
+        /* from creation to completion, under the request it was made for */
+        trace::span m_span;
+
+        data_signal     m_signal_on_data;
+        complete_signal m_signal_on_complete;
+        error_signal    m_signal_on_error;
+
+
+        transfer(class client                   *client,
+                 std::string_view                method,
+                 const std::string              &url,
+                 std::string                     body    = {},
+                 const std::vector<std::string> &headers = {});
+
+
+        static auto write_callback(char *p, std::size_t s, std::size_t n, void *d) -> std::size_t;
+        void        complete(CURLcode code);
+    };
+}
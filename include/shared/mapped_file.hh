@@ -0,0 +1,42 @@
+#pragma once
+#include <filesystem>
+#include <string_view>
+
+#include "result.hh"
+
+
+namespace aurgh
+{
+    /* a read-only, private mapping of a whole file */
+    class mapped_file
+    {
+    public:
+        [[nodiscard]]
+        static auto open(const std::filesystem::path &path) noexcept -> result<mapped_file>;
+
+
+        /* @p fd stays owned by the caller, the mapping outlives it */
+        [[nodiscard]]
+        static auto map(int fd) noexcept -> result<mapped_file>;
+
+
+        ~mapped_file();
+        mapped_file(mapped_file &&other) noexcept;
+        auto operator=(mapped_file &&other) noexcept -> mapped_file &;
+        mapped_file(const mapped_file &)                     = delete;
+        auto operator=(const mapped_file &) -> mapped_file & = delete;
+
+
+        [[nodiscard]]
+        auto
+        view() const noexcept -> std::string_view
+        { return { static_cast<const char *>(m_data), m_size }; }
+
+    private:
+        void       *m_data = nullptr;
+        std::size_t m_size = 0;
+
+
+        mapped_file(void *data, std::size_t size) noexcept;
+    };
+}
@@ -15,6 +15,7 @@ namespace aurgh
         std::string   version;
         Glib::ustring description;
         std::string   repo;
+        std::string   base; /* shared by every member of a split package */
 
 
         [[nodiscard]]
@@ -24,7 +25,8 @@ namespace aurgh
             return package { .name        = json["Name"].get<std::string>(),
                              .version     = json["Version"].get<std::string>(),
                              .description = json["Description"].get<std::string>(),
-                             .repo        = "aur" };
+                             .repo        = "aur",
+                             .base        = base_from_json(json) };
         }
 
 
@@ -35,7 +37,27 @@ namespace aurgh
             return package { .name        = alpm_pkg_get_name(pkg),
                              .version     = alpm_pkg_get_version(pkg),
                              .description = alpm_pkg_get_desc(pkg),
-                             .repo        = alpm_db_get_name(alpm_pkg_get_db(pkg)) };
+                             .repo        = alpm_db_get_name(alpm_pkg_get_db(pkg)),
+                             .base        = base_from_alpm(pkg) };
+        }
+
+
+        [[nodiscard]]
+        static auto
+        base_from_json(const nlohmann::json &json) -> std::string
+        {
+            if (json.contains("PackageBase") and json["PackageBase"].is_string())
+                return json["PackageBase"].get<std::string>();
+            return json["Name"].get<std::string>();
+        }
+
+
+        [[nodiscard]]
+        static auto
+        base_from_alpm(alpm_pkg_t *pkg) -> std::string
+        {
+            const char *base = alpm_pkg_get_base(pkg);
+            return base != nullptr ? base : alpm_pkg_get_name(pkg);
         }
     };
 
@@ -48,6 +70,7 @@ namespace aurgh
         std::vector<std::string> opt_depends;
         std::string              url;
         std::chrono::seconds     last_updated;
+        std::string              base;
 
 
         [[nodiscard]]
@@ -71,6 +94,7 @@ namespace aurgh
                 .opt_depends  = get_str_vec(json, "OptDepends"),
                 .url          = json.value("URL", ""),
                 .last_updated = std::chrono::seconds { json["LastModified"].get<std::size_t>() },
+                .base         = package::base_from_json(json),
             };
         }
 
@@ -124,6 +148,7 @@ namespace aurgh
 
             details.url          = alpm_pkg_get_url(pkg) != nullptr ? alpm_pkg_get_url(pkg) : "";
             details.last_updated = std::chrono::seconds { alpm_pkg_get_builddate(pkg) };
+            details.base         = package::base_from_alpm(pkg);
             return details;
         }
     };
@@ -0,0 +1,64 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+#include "result.hh"
+
+
+/* Progress reporting that does not wake the main loop per event.
+ *
+ * Producers store into a fixed slot without locking, the main loop samples
+ * every active slot once per frame and calls the listeners of the slots that
+ * changed since the last frame. The frame timer only runs while a slot is held.
+ */
+namespace aurgh::progress
+{
+    using listener = std::function<void(double)>;
+
+    inline constexpr std::size_t               max_slots = 64;
+    inline constexpr std::chrono::milliseconds frame_interval { 16 };
+
+
+    class slot
+    {
+        friend auto acquire(listener fn) noexcept -> result<slot>;
+
+    public:
+        slot() = default;
+        ~slot();
+
+        slot(slot &&other) noexcept;
+        auto operator=(slot &&other) noexcept -> slot &;
+        slot(const slot &)                     = delete;
+        auto operator=(const slot &) -> slot & = delete;
+
+
+        /* safe from any thread, never blocks; a no-op on an empty slot */
+        void store(double value) noexcept;
+
+
+        /* no store may follow. Released on the main loop, the pending value is
+           delivered right away and the listener is never called again. */
+        void release() noexcept;
+
+
+        [[nodiscard]]
+        explicit
+        operator bool() const noexcept
+        { return m_index != npos; }
+
+    private:
+        static constexpr std::size_t npos = -1;
+
+        std::size_t m_index = npos;
+
+
+        explicit slot(std::size_t index) noexcept;
+    };
+
+
+    /* safe from any thread; the listener is only ever called on the main loop */
+    [[nodiscard]]
+    auto acquire(listener fn) noexcept -> result<slot>;
+}
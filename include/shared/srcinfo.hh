@@ -0,0 +1,88 @@
+#pragma once
+#include <filesystem>
+#include <vector>
+
+#include "mapped_file.hh"
+#include "package.hh"
+#include "result.hh"
+
+
+namespace aurgh
+{
+    /* a mapped .SRCINFO, every view handed out points into the mapping */
+    class srcinfo
+    {
+    public:
+        struct entry
+        {
+            std::string_view key;
+            std::string_view value;
+            std::size_t      line_num;
+        };
+
+
+        /* walks the `key = value` lines of a .SRCINFO in place */
+        class reader
+        {
+        public:
+            explicit reader(std::string_view data) noexcept : m_rest { data } {}
+
+
+            [[nodiscard]]
+            auto next(entry &out) noexcept -> bool;
+
+        private:
+            std::string_view m_rest;
+            std::size_t      m_line_num = 0;
+        };
+
+
+        [[nodiscard]]
+        static auto parse(const std::filesystem::path &path) noexcept -> result<srcinfo>;
+
+
+        [[nodiscard]]
+        auto
+        pkgbase() const noexcept -> std::string_view
+        { return m_pkgbase; }
+
+
+        [[nodiscard]]
+        auto
+        entries() const noexcept -> reader
+        { return reader { m_file.view() }; }
+
+
+        [[nodiscard]]
+        auto pkgnames() const -> std::vector<std::string_view>;
+
+
+        /* an empty @p arch means the architecture of this machine */
+        [[nodiscard]]
+        auto get_package(std::string_view name, std::string_view arch = {}) const
+            -> result<package>;
+
+        [[nodiscard]]
+        auto get_details(std::string_view name, std::string_view arch = {}) const
+            -> result<package_details>;
+
+
+        /* every (split) package described by the file */
+        [[nodiscard]]
+        auto packages(std::string_view arch = {}) const -> result<std::vector<package>>;
+
+        [[nodiscard]]
+        auto details(std::string_view arch = {}) const -> result<std::vector<package_details>>;
+
+    private:
+        mapped_file          m_file;
+        std::string_view     m_pkgbase;
+        std::chrono::seconds m_last_updated;
+
+
+        srcinfo(mapped_file &&file, std::string_view pkgbase, std::chrono::seconds last_updated);
+
+        template <typename F>
+        auto mf_walk(std::string_view name, std::string_view arch, F &&apply) const -> bool;
+    };
+}
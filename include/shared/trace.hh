@@ -0,0 +1,175 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+#include "result.hh"
+
+
+/* spans of where the time goes, written as Chrome trace JSON that chrome://tracing and
+   Perfetto open. Built in with -Dtracing=true, which defines AURGH_TRACING, and recorded
+   only when AURGH_TRACE names the file to write at exit; a "%p" in it becomes the pid.
+   Each thread records into a ring of its own, the hot path takes no lock */
+namespace aurgh::trace
+{
+    /* per thread, the oldest spans are overwritten past this */
+    inline constexpr std::size_t ring_capacity = 16384;
+
+    /* a span's detail is cut to this many bytes */
+    inline constexpr std::size_t detail_capacity = 63;
+
+#ifdef AURGH_TRACING
+    /* reads AURGH_TRACE; call once, before any other thread starts */
+    void init() noexcept;
+
+
+    [[nodiscard]]
+    auto enabled() noexcept -> bool;
+
+
+    /* a request ID no other request of this process has, never 0 */
+    [[nodiscard]]
+    auto next_id() noexcept -> std::uint64_t;
+
+
+    /* what spans started on this thread are tagged with, 0 for none */
+    [[nodiscard]]
+    auto current_id() noexcept -> std::uint64_t;
+
+
+    /* the name this thread gets in the trace */
+    void name_thread(const char *name) noexcept;
+
+
+    void instant(const char *category, const char *name, std::string_view detail = {}) noexcept;
+
+
+    /* every span recorded so far, however it was started */
+    auto write(const std::filesystem::path &path) noexcept -> result<void>;
+
+
+    /* makes @p id the current request ID of this thread until it goes out of scope */
+    class id_scope
+    {
+    public:
+        explicit id_scope(std::uint64_t id) noexcept;
+        ~id_scope();
+
+        id_scope(const id_scope &)                     = delete;
+        auto operator=(const id_scope &) -> id_scope & = delete;
+
+    private:
+        std::uint64_t m_previous;
+    };
+
+
+    /* the time from construction to end, recorded on the thread that ends it under the
+       thread that started it; movable so that it can follow a request through callbacks.
+       @p category and @p name must be string literals */
+    class span
+    {
+    public:
+        span() noexcept = default;
+        span(const char      *category,
+             const char      *name,
+             std::string_view detail = {},
+             std::uint64_t    id     = current_id()) noexcept;
+
+        span(span &&other) noexcept;
+        auto operator=(span &&other) noexcept -> span &;
+
+        ~span();
+
+
+        void end() noexcept;
+
+    private:
+        const char   *m_category = nullptr;
+        const char   *m_name     = nullptr; /* null when not recording */
+        std::uint64_t m_id       = 0;
+        std::int64_t  m_begin    = 0;
+        std::uint32_t m_tid      = 0;
+
+        std::uint8_t m_detail_size = 0;
+        char         m_detail[detail_capacity];
+    };
+#else
+    inline void
+    init() noexcept
+    {}
+
+
+    [[nodiscard]]
+    inline auto
+    enabled() noexcept -> bool
+    { return false; }
+
+
+    [[nodiscard]]
+    inline auto
+    next_id() noexcept -> std::uint64_t
+    { return 0; }
+
+
+    [[nodiscard]]
+    inline auto
+    current_id() noexcept -> std::uint64_t
+    { return 0; }
+
+
+    inline void
+    name_thread(const char *) noexcept
+    {}
+
+
+    inline void
+    instant(const char *, const char *, std::string_view = {}) noexcept
+    {}
+
+
+    inline auto
+    write(const std::filesystem::path &) noexcept -> result<void>
+    { return {}; }
+
+
+    class id_scope
+    {
+    public:
+        explicit id_scope(std::uint64_t) noexcept {}
+    };
+
+
+    class span
+    {
+    public:
+        span() noexcept = default;
+        span(const char *, const char *, std::string_view = {}, std::uint64_t = 0) noexcept {}
+
+
+        void
+        end() noexcept
+        {}
+    };
+#endif
+}
+
+
+#ifdef AURGH_TRACING
+#define AURGH_TRACE_CONCAT_(a, b) a##b
+#define AURGH_TRACE_CONCAT(a, b)  AURGH_TRACE_CONCAT_(a, b)
+
+/* a span over the rest of the enclosing scope: (category, name[, detail[, id]]) */
+#define AURGH_TRACE_SPAN(...) \
+    const ::aurgh::trace::span AURGH_TRACE_CONCAT(aurgh_trace_span_, __LINE__) { __VA_ARGS__ }
+
+#define AURGH_TRACE_ID_SCOPE(id) \
+    const ::aurgh::trace::id_scope AURGH_TRACE_CONCAT(aurgh_trace_id_, __LINE__) { id }
+
+#define AURGH_TRACE_INSTANT(...)  ::aurgh::trace::instant(__VA_ARGS__)
+#define AURGH_TRACE_THREAD(name)  ::aurgh::trace::name_thread(name)
+#else
+#define AURGH_TRACE_SPAN(...)     static_cast<void>(0)
+#define AURGH_TRACE_ID_SCOPE(id)  static_cast<void>(0)
+#define AURGH_TRACE_INSTANT(...)  static_cast<void>(0)
+#define AURGH_TRACE_THREAD(name)  static_cast<void>(0)
+#endif
@@ -0,0 +1,378 @@
+#include <print>
+
+#include <glibmm/main.h>
+#include <unistd.h>
+
+#include "helper.hh"
+#include "trace.hh"
+
+using aurgh::helper;
+namespace bus = aurgh::bus;
+
+namespace
+{
+    constexpr auto polkit_service_name   = "org.freedesktop.PolicyKit1";
+    constexpr auto polkit_object_path    = "/org/freedesktop/PolicyKit1/Authority";
+    constexpr auto polkit_interface_name = "org.freedesktop.PolicyKit1.Authority";
+
+    /* the actions data/org.kei.aurgh.policy declares */
+    constexpr auto transaction_action = "org.kei.aurgh.transaction";
+    constexpr auto refresh_action     = "org.kei.aurgh.refresh";
+
+    /* CheckAuthorization flag: polkit may ask the user for a password meanwhile */
+    constexpr std::uint32_t allow_user_interaction = 1;
+
+    /* long enough for someone to type that password */
+    constexpr std::chrono::minutes authorization_timeout { 5 };
+
+    /* subject kind, details */
+    using polkit_subject = sdbus::Struct<std::string, std::map<std::string, sdbus::Variant>>;
+
+    /* is authorized, is challenge, details */
+    using polkit_result = sdbus::Struct<bool, bool, std::map<std::string, std::string>>;
+
+
+    [[nodiscard]]
+    auto
+    step_name(alpm_progress_t progress) -> std::string_view
+    {
+        switch (progress)
+        {
+        case ALPM_PROGRESS_ADD_START:       return "install";
+        case ALPM_PROGRESS_UPGRADE_START:   return "upgrade";
+        case ALPM_PROGRESS_DOWNGRADE_START: return "downgrade";
+        case ALPM_PROGRESS_REINSTALL_START: return "reinstall";
+        case ALPM_PROGRESS_REMOVE_START:    return "remove";
+        case ALPM_PROGRESS_CONFLICTS_START: return "conflicts";
+        case ALPM_PROGRESS_DISKSPACE_START: return "diskspace";
+        case ALPM_PROGRESS_INTEGRITY_START: return "integrity";
+        case ALPM_PROGRESS_LOAD_START:      return "load";
+        case ALPM_PROGRESS_KEYRING_START:   return "keyring";
+        }
+
+        return "unknown";
+    }
+
+
+    [[nodiscard]]
+    auto
+    to_records(const std::vector<aurgh::package> &packages) -> std::vector<bus::package_record>
+    {
+        std::vector<bus::package_record> records;
+        records.reserve(packages.size());
+
+        for (const auto &pkg : packages) records.emplace_back(bus::to_record(pkg));
+        return records;
+    }
+}
+
+
+auto
+helper::create(sdbus::IConnection                  &connection,
+               const std::shared_ptr<http::client> &http,
+               const std::filesystem::path         &pacman_conf) noexcept
+    -> result<std::unique_ptr<helper>>
+try
+{
+    if (uid_t self = geteuid(); self != 0)
+        return error { "aurgh-helper changes the system and must run as root, not as uid {}",
+                       self }
+            .unexpected();
+
+    if (auto res = alpm::handle::create(pacman_conf, http); res.has_value())
+        return std::unique_ptr<helper> { new helper { connection, http,
+                                                      std::move(res.value()) } };
+    else /* NOLINT */
+        return res.error().unexpected();
+}
+catch (const sdbus::Error &e)
+{
+    return error { "failed to export the helper object: {}", e.getMessage() }.unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { "failed to create the helper: {}", e.what() }.unexpected();
+}
+
+
+helper::helper(sdbus::IConnection                  &connection,
+               const std::shared_ptr<http::client> &http,
+               alpm::handle                       &&handle)
+    : m_http { http }, m_alpm { std::move(handle) },
+      m_polkit { sdbus::createProxy(connection, sdbus::ServiceName { polkit_service_name },
+                                    sdbus::ObjectPath { polkit_object_path }) },
+      m_object { sdbus::createObject(connection, sdbus::ObjectPath { bus::helper_object_path }) }
+{
+    m_object
+        ->addVTable(
+            sdbus::registerMethod(sdbus::MethodName { "Transaction" })
+                .withInputParamNames("targets", "refresh", "sysupgrade")
+                .withOutputParamNames("installed")
+                .implementedAs(
+                    [this](sdbus::Result<std::vector<bus::package_record>> &&reply,
+                           std::vector<std::string> targets, bool refresh, bool sysupgrade)
+                    {
+                        mf_transaction(std::move(reply),
+                                       { std::move(targets), refresh, sysupgrade });
+                    }),
+            sdbus::registerMethod(sdbus::MethodName { "Refresh" })
+                .withInputParamNames("force")
+                .withOutputParamNames("repos", "added", "changed", "removed")
+                .implementedAs(
+                    [this](refresh_reply &&reply, bool force)
+                    { mf_refresh(std::move(reply), force); }),
+            sdbus::registerSignal(sdbus::SignalName { "TransactionProgress" })
+                .withParameters<std::vector<bus::progress_record>>("progress"))
+        .forInterface(sdbus::InterfaceName { bus::helper_interface_name });
+
+    /* both fire on the main loop, already coalesced per file and per package */
+    auto &config = m_alpm.configuration();
+
+    config.signal_on_download_progress.connect(
+        [this](std::string_view file, double value)
+        { mf_queue_progress("download", file, value); });
+    config.signal_on_package_progress.connect(
+        [this](alpm_progress_t step, std::string_view pkg, double value)
+        { mf_queue_progress(step_name(step), pkg, value); });
+}
+
+
+void
+helper::exit_when_idle(std::chrono::seconds timeout, std::move_only_function<void()> quit)
+{
+    m_idle_timeout = timeout;
+    m_on_idle      = std::move(quit);
+    if (m_busy == 0) mf_arm_idle_timer();
+}
+
+
+/* the sender is checked rather than its uid, so polkit knows which session to ask in */
+void
+helper::mf_authorize(std::string_view action, std::function<void(result<void>)> then)
+{
+    std::string sender;
+
+    try
+    {
+        sender = m_object->getCurrentlyProcessedMessage().getSender();
+    }
+    catch (const sdbus::Error &e)
+    {
+        return then(error { "failed to identify the caller: {}", e.getMessage() }.unexpected());
+    }
+
+    polkit_subject subject { "system-bus-name", { { "name", sdbus::Variant { sender } } } };
+
+    m_polkit->callMethodAsync(sdbus::MethodName { "CheckAuthorization" })
+        .onInterface(sdbus::InterfaceName { polkit_interface_name })
+        .withTimeout(authorization_timeout)
+        .withArguments(subject, std::string { action }, std::map<std::string, std::string> {},
+                       allow_user_interaction, std::string {})
+        .uponReplyInvoke(
+            [action = std::string { action }, then = std::move(then)](
+                std::optional<sdbus::Error> e, polkit_result answer)
+            {
+                if (e.has_value())
+                    return then(error { "failed to ask polkit about {}: {}", action,
+                                        e->getMessage() }
+                                    .unexpected());
+
+                if (!std::get<0>(answer))
+                    return then(error { "polkit did not authorize {}", action }.unexpected());
+
+                then({});
+            });
+}
+
+
+/* libalpm downloads with ParallelDownloads, then checks and extracts, all inside one commit */
+void
+helper::mf_transaction(sdbus::Result<std::vector<bus::package_record>> &&reply,
+                       alpm::transaction_request                        trans)
+{
+    AURGH_TRACE_ID_SCOPE(trace::next_id());
+    AURGH_TRACE_SPAN("helper", "Transaction");
+
+    auto state = std::make_shared<sdbus::Result<std::vector<bus::package_record>>>(
+        std::move(reply));
+
+    auto finish = [this]
+    {
+        mf_flush_progress();
+        mf_release();
+    };
+
+    /* held from here, a password prompt can outlast the idle timeout */
+    mf_hold();
+
+    mf_authorize(
+        transaction_action,
+        [this, state, finish, trans = std::move(trans)](result<void> allowed) mutable
+        {
+            if (!allowed)
+            {
+                state->returnError(bus::to_error(allowed.error()));
+                return mf_release();
+            }
+
+            auto res = m_alpm.transaction(std::move(trans));
+            if (!res)
+            {
+                state->returnError(bus::to_error(res.error()));
+                return mf_release();
+            }
+
+            res.value()
+                ->on_result(
+                    [state, finish](std::vector<package> installed)
+                    {
+                        Glib::MainContext::get_default()->invoke(
+                            [state, finish, installed = std::move(installed)]
+                            {
+                                state->returnResults(to_records(installed));
+                                finish();
+                                return false;
+                            });
+                    })
+                .on_error(
+                    [state, finish](error e)
+                    {
+                        Glib::MainContext::get_default()->invoke(
+                            [state, finish, e]
+                            {
+                                state->returnError(bus::to_error(e));
+                                finish();
+                                return false;
+                            });
+                    });
+        });
+}
+
+
+/* only the databases the mirrors had something newer for are read again */
+void
+helper::mf_refresh(refresh_reply &&reply, bool force)
+{
+    AURGH_TRACE_ID_SCOPE(trace::next_id());
+    AURGH_TRACE_SPAN("helper", "Refresh");
+
+    auto state = std::make_shared<refresh_reply>(std::move(reply));
+
+    auto finish = [this]
+    {
+        mf_flush_progress();
+        mf_release();
+    };
+
+    mf_hold();
+
+    mf_authorize(
+        refresh_action,
+        [this, state, finish, force](result<void> allowed)
+        {
+            if (!allowed)
+            {
+                state->returnError(bus::to_error(allowed.error()));
+                return mf_release();
+            }
+
+            auto res = m_alpm.refresh(force);
+            if (!res)
+            {
+                state->returnError(bus::to_error(res.error()));
+                return mf_release();
+            }
+
+            res.value()
+                ->on_result(
+                    [state, finish](alpm::sync_delta delta)
+                    {
+                        Glib::MainContext::get_default()->invoke(
+                            [state, finish, delta = std::move(delta)]
+                            {
+                                state->returnResults(delta.repos, to_records(delta.added),
+                                                     to_records(delta.changed),
+                                                     to_records(delta.removed));
+                                finish();
+                                return false;
+                            });
+                    })
+                .on_error(
+                    [state, finish](error e)
+                    {
+                        Glib::MainContext::get_default()->invoke(
+                            [state, finish, e]
+                            {
+                                state->returnError(bus::to_error(e));
+                                finish();
+                                return false;
+                            });
+                    });
+        });
+}
+
+
+void
+helper::mf_queue_progress(std::string_view step, std::string_view target, double value)
+{
+    m_pending_progress.insert_or_assign({ std::string { step }, std::string { target } }, value);
+
+    if (!m_progress_flush.connected())
+        m_progress_flush = Glib::signal_timeout().connect(
+            [this]
+            {
+                mf_flush_progress();
+                return false;
+            },
+            progress_interval.count());
+}
+
+
+void
+helper::mf_flush_progress()
+{
+    m_progress_flush.disconnect();
+    if (m_pending_progress.empty()) return;
+
+    std::vector<bus::progress_record> records;
+    records.reserve(m_pending_progress.size());
+
+    for (auto &[key, value] : m_pending_progress)
+        records.emplace_back(key.first, key.second, value);
+    m_pending_progress.clear();
+
+    m_object->emitSignal(sdbus::SignalName { "TransactionProgress" })
+        .onInterface(sdbus::InterfaceName { bus::helper_interface_name })
+        .withArguments(records);
+}
+
+
+void
+helper::mf_hold()
+{
+    m_busy++;
+    m_idle_timer.disconnect();
+}
+
+
+void
+helper::mf_release()
+{
+    if (--m_busy == 0) mf_arm_idle_timer();
+}
+
+
+void
+helper::mf_arm_idle_timer()
+{
+    if (!m_on_idle or m_idle_timeout <= std::chrono::seconds::zero()) return;
+
+    m_idle_timer.disconnect();
+    m_idle_timer = Glib::signal_timeout().connect_seconds(
+        [this]
+        {
+            if (m_busy == 0) m_on_idle();
+            return false;
+        },
+        m_idle_timeout.count());
+}
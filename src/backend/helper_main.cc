@@ -0,0 +1,94 @@
+#include <cstdlib>
+#include <iostream>
+#include <print>
+
+#include <glibmm/init.h>
+#include <glibmm/main.h>
+#include <lyra/lyra.hpp>
+
+#include "bus.hh"
+#include "helper.hh"
+#include "trace.hh"
+
+
+auto
+main(int argc, char **argv) -> int
+{
+    aurgh::trace::init();
+
+    std::string pacman_conf = "/etc/pacman.conf";
+    std::size_t idle_exit   = 60;
+    bool        show_help   = false;
+
+    auto cli = lyra::cli {}
+             | lyra::help(show_help)
+             | lyra::opt(pacman_conf, "path")["-c"]["--config"]("pacman configuration to load")
+             | lyra::opt(idle_exit, "seconds")["--idle-exit"]("exit after this long without "
+                                                              "requests, 0 to keep running");
+
+    if (auto res = cli.parse({ argc, argv }); !res)
+    {
+        std::println(stderr, "error: {}", res.message());
+        return EXIT_FAILURE;
+    }
+
+    if (show_help)
+    {
+        std::cout << cli << '\n';
+        return EXIT_SUCCESS;
+    }
+
+    Glib::init();
+    auto loop = Glib::MainLoop::create();
+
+    std::unique_ptr<sdbus::IConnection> connection;
+
+    try
+    {
+        connection = sdbus::createSystemBusConnection(
+            sdbus::ServiceName { aurgh::bus::helper_service_name });
+    }
+    catch (const sdbus::Error &e)
+    {
+        std::println(stderr, "error: failed to own {}: {}", aurgh::bus::helper_service_name,
+                     e.getMessage());
+        return EXIT_FAILURE;
+    }
+
+    aurgh::bus::main_loop_source source { *connection };
+
+    auto http = aurgh::http::client::create();
+    if (!http)
+    {
+        std::println(stderr, "error: {}", http.error());
+        return EXIT_FAILURE;
+    }
+
+    auto helper = aurgh::helper::create(*connection, http.value(), pacman_conf);
+    if (!helper)
+    {
+        std::println(stderr, "error: {}", helper.error());
+        return EXIT_FAILURE;
+    }
+
+    /* the system bus activates us again for the next caller */
+    helper.value()->exit_when_idle(
+        std::chrono::seconds(idle_exit),
+        [loop, &connection]
+        {
+            try
+            {
+                connection->releaseName(sdbus::ServiceName { aurgh::bus::helper_service_name });
+            }
+            catch (const sdbus::Error &e)
+            {
+                std::println(stderr, "warning: failed to release {}: {}",
+                             aurgh::bus::helper_service_name, e.getMessage());
+            }
+
+            loop->quit();
+        });
+
+    loop->run();
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,121 @@
+#include <cstdlib>
+#include <iostream>
+#include <print>
+
+#include <glibmm/init.h>
+#include <glibmm/main.h>
+#include <lyra/lyra.hpp>
+
+#include "bus.hh"
+#include "service.hh"
+#include "trace.hh"
+
+
+namespace
+{
+    [[nodiscard]]
+    auto
+    cache_dir() -> std::filesystem::path
+    {
+        if (const char *cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr and *cache != '\0')
+            return std::filesystem::path { cache } / "aurgh";
+        if (const char *home = std::getenv("HOME"); home != nullptr)
+            return std::filesystem::path { home } / ".cache" / "aurgh";
+        return {};
+    }
+}
+
+
 auto
-main() -> int
+main(int argc, char **argv) -> int
 {
+    aurgh::trace::init();
+
+    std::string pacman_conf = "/etc/pacman.conf";
+    std::string clone_dir   = (cache_dir() / "clone").string();
+    std::string state_dir   = (cache_dir() / "daemon").string();
+    std::size_t clone_jobs  = aurgh::git::executor::default_concurrency;
+    std::size_t cache_ttl   = aurgh::service::default_cache_ttl.count();
+    std::size_t idle_exit   = 300;
+    bool        show_help   = false;
+
+    auto cli = lyra::cli {}
+             | lyra::help(show_help)
+             | lyra::opt(pacman_conf, "path")["-c"]["--config"]("pacman configuration to load")
+             | lyra::opt(clone_dir, "path")["--clone-dir"]("where Clone puts packages")
+             | lyra::opt(clone_jobs, "count")["-j"]["--clone-jobs"]("clones run at once")
+             | lyra::opt(cache_ttl, "seconds")["--cache-ttl"]("how long answers are shared, 0 to "
+                                                               "only share running lookups")
+             | lyra::opt(idle_exit, "seconds")["--idle-exit"]("exit after this long without "
+                                                              "requests, 0 to keep running")
+             | lyra::opt(state_dir, "path")["--state-dir"]("where the warm index is kept "
+                                                           "between runs");
+
+    if (auto res = cli.parse({ argc, argv }); !res)
+    {
+        std::println(stderr, "error: {}", res.message());
+        return EXIT_FAILURE;
+    }
+
+    if (show_help)
+    {
+        std::cout << cli << '\n';
+        return EXIT_SUCCESS;
+    }
+
+    Glib::init();
+    auto loop = Glib::MainLoop::create();
+
+    std::unique_ptr<sdbus::IConnection> connection;
+
+    try
+    {
+        connection
+            = sdbus::createSessionBusConnection(sdbus::ServiceName { aurgh::bus::service_name });
+    }
+    catch (const sdbus::Error &e)
+    {
+        std::println(stderr, "error: failed to own {}: {}", aurgh::bus::service_name,
+                     e.getMessage());
+        return EXIT_FAILURE;
+    }
+
+    aurgh::bus::main_loop_source source { *connection };
+
+    auto http = aurgh::http::client::create();
+    if (!http)
+    {
+        std::println(stderr, "error: {}", http.error());
+        return EXIT_FAILURE;
+    }
+
+    auto service
+        = aurgh::service::create(*connection, http.value(), clone_dir, pacman_conf, clone_jobs,
+                                 state_dir, std::chrono::seconds(cache_ttl));
+    if (!service)
+    {
+        std::println(stderr, "error: {}", service.error());
+        return EXIT_FAILURE;
+    }
+
+    /* bus activation starts us again on the next request, which must not be queued here */
+    service.value()->exit_when_idle(
+        std::chrono::seconds(idle_exit),
+        [loop, &connection]
+        {
+            try
+            {
+                connection->releaseName(sdbus::ServiceName { aurgh::bus::service_name });
+            }
+            catch (const sdbus::Error &e)
+            {
+                std::println(stderr, "warning: failed to release {}: {}", aurgh::bus::service_name,
+                             e.getMessage());
+            }
+
+            loop->quit();
+        });
 
+    loop->run();
+    return EXIT_SUCCESS;
 }
@@ -0,0 +1,564 @@
+#include <algorithm>
+#include <print>
+#include <ranges>
+
+#include <glibmm/main.h>
+
+#include "bulk.hh"
+#include "git.hh"
+#include "git/transport.hh"
+#include "service.hh"
+#include "trace.hh"
+
+using aurgh::service;
+namespace bus = aurgh::bus;
+
+namespace
+{
+    /* one answer merged from the AUR and libalpm */
+    template <typename T>
+    struct merged
+    {
+        service::responder<T> respond;
+        std::vector<T>        items;
+        std::uint8_t          remaining = 2;
+        bool                  done      = false;
+
+        /* the requests are still emitting when the answer goes out,
+           so they are only dropped from an idle callback */
+        std::vector<std::shared_ptr<void>> requests;
+    };
+
+
+    /* must run on the main loop */
+    template <typename T>
+    void
+    deliver(const std::shared_ptr<merged<T>> &state, aurgh::result<std::vector<T>> res)
+    {
+        if (state->done) return;
+
+        if (res.has_value())
+        {
+            state->items.insert(state->items.end(), std::make_move_iterator(res->begin()),
+                                std::make_move_iterator(res->end()));
+            if (--state->remaining != 0) return;
+
+            state->respond(std::move(state->items));
+        }
+        else
+            state->respond(res.error().unexpected());
+
+        state->done = true;
+        Glib::signal_idle().connect_once([state] { state->requests.clear(); });
+    }
+
+
+    template <typename T>
+    void
+    attach_aur(const std::shared_ptr<merged<T>>                           &state,
+               const std::shared_ptr<aurgh::aur::request<std::vector<T>>> &req)
+    {
+        state->requests.emplace_back(req);
+
+        req->on_result([state](std::vector<T> items) { deliver<T>(state, std::move(items)); })
+            .on_error([state](aurgh::error e) { deliver<T>(state, e.unexpected()); });
+    }
+
+
+    /* libalpm answers on its own thread */
+    template <typename T>
+    void
+    attach_alpm(const std::shared_ptr<merged<T>>                                   &state,
+                const std::shared_ptr<aurgh::alpm::async::request<std::vector<T>>> &req)
+    {
+        state->requests.emplace_back(req);
+
+        req->on_result(
+               [state](std::vector<T> items)
+               {
+                   Glib::MainContext::get_default()->invoke(
+                       [state, items = std::move(items)] mutable
+                       {
+                           deliver<T>(state, std::move(items));
+                           return false;
+                       });
+               })
+            .on_error(
+                [state](aurgh::error e)
+                {
+                    Glib::MainContext::get_default()->invoke(
+                        [state, e]
+                        {
+                            deliver<T>(state, e.unexpected());
+                            return false;
+                        });
+                });
+    }
+
+
+    template <typename Record, typename T>
+    [[nodiscard]]
+    auto
+    reply_records(sdbus::Result<std::vector<Record>> &&reply) -> service::responder<T>
+    {
+        return [reply = std::move(reply)](aurgh::result<std::vector<T>> res) mutable
+        {
+            if (!res) return reply.returnError(bus::to_error(res.error()));
+
+            std::vector<Record> records;
+            records.reserve(res->size());
+
+            for (const auto &item : *res) records.emplace_back(bus::to_record(item));
+            reply.returnResults(records);
+        };
+    }
+
+
+    template <typename T>
+    [[nodiscard]]
+    auto
+    reply_bulk(sdbus::Result<sdbus::UnixFd> &&reply) -> service::responder<T>
+    {
+        return [reply = std::move(reply)](aurgh::result<std::vector<T>> res) mutable
+        {
+            if (!res) return reply.returnError(bus::to_error(res.error()));
+
+            if (auto file = aurgh::bulk::write(std::span<const T> { *res }); file.has_value())
+                reply.returnResults(file.value());
+            else
+                reply.returnError(bus::to_error(file.error()));
+        };
+    }
+
+
+    /* the same set of names is the same question whatever order it came in */
+    [[nodiscard]]
+    auto
+    info_key(std::vector<std::string> names) -> std::string
+    {
+        std::ranges::sort(names);
+        auto [first, last] = std::ranges::unique(names);
+        names.erase(first, last);
+
+        std::string key;
+        for (const auto &name : names) key.append(name).push_back('\n');
+        return key;
+    }
+
+
+    struct clone_reply
+    {
+        sdbus::Result<std::string>           reply;
+        std::shared_ptr<aurgh::git::cloning> task;
+    };
+}
+
+
+auto
+service::create(sdbus::IConnection                  &connection,
+                const std::shared_ptr<http::client> &http,
+                std::filesystem::path                clone_dir,
+                const std::filesystem::path         &pacman_conf,
+                std::size_t                          clone_jobs,
+                std::filesystem::path                state_dir,
+                std::chrono::seconds                 cache_ttl) noexcept
+    -> result<std::unique_ptr<service>>
+try
+{
+    std::shared_ptr<git::executor> git;
+
+    if (auto res = git::executor::create(clone_jobs); res.has_value())
+        git = std::move(res.value());
+    else
+        return res.error().unexpected();
+
+    if (auto res = git::register_http_transport(http); !res) return res.error().unexpected();
+
+    /* without scores servers keep their pacman.conf order, which is no reason not to start */
+    std::shared_ptr<alpm::mirror_scores> mirrors;
+
+    if (!state_dir.empty())
+    {
+        if (auto res = alpm::mirror_scores::load(state_dir / "mirrors"); res.has_value())
+            mirrors = std::move(res.value());
+        else
+            std::println(stderr, "warning: {}", res.error());
+    }
+
+    std::filesystem::path config_cache;
+    if (!state_dir.empty()) config_cache = state_dir / "pacman.conf.cache";
+
+    if (auto res = alpm::handle::create(pacman_conf, http, mirrors, config_cache);
+        res.has_value())
+        return std::unique_ptr<service> {
+            new service { connection, http, git, std::move(clone_dir), std::move(res.value()),
+                          std::move(mirrors), std::move(state_dir), cache_ttl }
+        };
+    else /* NOLINT */
+        return res.error().unexpected();
+}
+catch (const sdbus::Error &e)
+{
+    return error { "failed to export the daemon object: {}", e.getMessage() }.unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { "failed to create the daemon service: {}", e.what() }.unexpected();
+}
+
+
+service::service(sdbus::IConnection                   &connection,
+                 const std::shared_ptr<http::client>  &http,
+                 const std::shared_ptr<git::executor> &git,
+                 std::filesystem::path               &&clone_dir,
+                 alpm::handle                        &&handle,
+                 std::shared_ptr<alpm::mirror_scores>  mirrors,
+                 std::filesystem::path               &&state_dir,
+                 std::chrono::seconds                  cache_ttl)
+    : m_http { http }, m_git { git }, m_clone_dir { std::move(clone_dir) }, m_aur { m_http },
+      m_alpm { std::move(handle) }, m_mirrors { std::move(mirrors) },
+      m_state_dir { std::move(state_dir) },
+      m_searches { cache_ttl, cache_capacity },
+      m_infos { cache_ttl, cache_capacity },
+      m_object { sdbus::createObject(connection, sdbus::ObjectPath { bus::object_path }) }
+{
+    m_object
+        ->addVTable(
+            sdbus::registerMethod(sdbus::MethodName { "Search" })
+                .withInputParamNames("query")
+                .withOutputParamNames("packages")
+                .implementedAs(
+                    [this](sdbus::Result<std::vector<bus::package_record>> &&reply,
+                           std::string                                        query)
+                    {
+                        mf_search(std::move(query),
+                                  reply_records<bus::package_record, package>(std::move(reply)));
+                    }),
+            sdbus::registerMethod(sdbus::MethodName { "SearchBulk" })
+                .withInputParamNames("query")
+                .withOutputParamNames("packages")
+                .implementedAs(
+                    [this](sdbus::Result<sdbus::UnixFd> &&reply, std::string query)
+                    { mf_search(std::move(query), reply_bulk<package>(std::move(reply))); }),
+            sdbus::registerMethod(sdbus::MethodName { "Info" })
+                .withInputParamNames("names")
+                .withOutputParamNames("details")
+                .implementedAs(
+                    [this](sdbus::Result<std::vector<bus::details_record>> &&reply,
+                           std::vector<std::string>                           names)
+                    {
+                        mf_info(std::move(names),
+                                reply_records<bus::details_record, package_details>(
+                                    std::move(reply)));
+                    }),
+            sdbus::registerMethod(sdbus::MethodName { "InfoBulk" })
+                .withInputParamNames("names")
+                .withOutputParamNames("details")
+                .implementedAs(
+                    [this](sdbus::Result<sdbus::UnixFd> &&reply, std::vector<std::string> names)
+                    { mf_info(std::move(names), reply_bulk<package_details>(std::move(reply))); }),
+            sdbus::registerMethod(sdbus::MethodName { "Clone" })
+                .withInputParamNames("url")
+                .withOutputParamNames("path")
+                .implementedAs([this](sdbus::Result<std::string> &&reply, std::string url)
+                               { mf_clone(std::move(reply), std::move(url)); }),
+            sdbus::registerProperty(sdbus::PropertyName { "CloneDir" })
+                .withGetter([this] { return m_clone_dir.string(); }),
+            sdbus::registerSignal(sdbus::SignalName { "CloneProgress" })
+                .withParameters<std::string, double>("url", "progress"))
+        .forInterface(sdbus::InterfaceName { bus::interface_name });
+
+    /* nothing has been queued on the libalpm thread yet, so its handle is still ours */
+    if (!m_state_dir.empty())
+    {
+        if (auto res = warm_index::load(m_state_dir, m_alpm.sync_time()); res.has_value())
+            m_index.emplace(std::move(res.value()));
+        m_index_fresh = m_index.has_value();
+    }
+
+    /* the sources are read before anything on the libalpm thread can reload them */
+    if (auto res = alpm::config_watch::create([this] { mf_reload_config(); }); res.has_value())
+    {
+        m_config_watch = std::move(res.value());
+        if (auto watched = m_config_watch->watch(m_alpm.configuration().sources()); !watched)
+            std::println(stderr, "warning: {}", watched.error());
+    }
+    else
+        std::println(stderr, "warning: {}", res.error());
+
+    /* the probe reads the server lists before anything on the libalpm thread can reorder them */
+    if (m_mirrors != nullptr)
+        m_mirrors->probe(*m_http, m_alpm.configuration().repos,
+                         [this]
+                         {
+                             if (auto res = m_mirrors->save(); !res)
+                                 std::println(stderr, "warning: {}", res.error());
+                             std::ignore = m_alpm.reorder_servers();
+                         });
+
+    if (auto res = m_alpm.preload(); res.has_value())
+        res.value()->on_result(
+            [this](std::monostate)
+            {
+                Glib::MainContext::get_default()->invoke(
+                    [this]
+                    {
+                        m_alpm_ready = true;
+                        m_index.reset();
+                        return false;
+                    });
+            });
+    else
+        m_alpm_ready = true;
+}
+
+
+void
+service::exit_when_idle(std::chrono::seconds timeout, std::move_only_function<void()> quit)
+{
+    m_idle_timeout = timeout;
+    m_on_idle      = std::move(quit);
+    if (m_busy == 0) mf_arm_idle_timer();
+}
+
+
+void
+service::mf_search(std::string query, responder<package> respond)
+{
+    if (!m_searches.join(query, std::move(respond))) return;
+    mf_hold();
+
+    AURGH_TRACE_ID_SCOPE(trace::next_id());
+    AURGH_TRACE_SPAN("service", "Search", query);
+
+    auto state = std::make_shared<merged<package>>(
+        [this, key = query](result<std::vector<package>> res)
+        {
+            m_searches.settle(key, std::move(res));
+            mf_release();
+        });
+
+    if (auto res = m_aur.search(query); res.has_value())
+        attach_aur(state, res.value());
+    else
+        return deliver(state, result<std::vector<package>> { res.error().unexpected() });
+
+    if (!m_alpm_ready and m_index.has_value())
+        deliver(state, result<std::vector<package>> { m_index->search(query) });
+    else if (auto res = m_alpm.search(std::move(query)); res.has_value())
+        attach_alpm(state, res.value());
+    else
+        deliver(state, result<std::vector<package>> { res.error().unexpected() });
+}
+
+
+void
+service::mf_info(std::vector<std::string> names, responder<package_details> respond)
+{
+    std::string key = info_key(names);
+    if (!m_infos.join(key, std::move(respond))) return;
+    mf_hold();
+
+    AURGH_TRACE_ID_SCOPE(trace::next_id());
+    AURGH_TRACE_SPAN("service", "Info", key);
+
+    auto state = std::make_shared<merged<package_details>>(
+        [this, key](result<std::vector<package_details>> res)
+        {
+            m_infos.settle(key, std::move(res));
+            mf_release();
+        });
+
+    if (auto res = m_aur.info(names); res.has_value())
+        attach_aur(state, res.value());
+    else
+        return deliver(state, result<std::vector<package_details>> { res.error().unexpected() });
+
+    if (!m_alpm_ready and m_index.has_value())
+        deliver(state, result<std::vector<package_details>> { m_index->info(names) });
+    else if (auto res = m_alpm.info(names); res.has_value())
+        attach_alpm(state, res.value());
+    else
+        deliver(state, result<std::vector<package_details>> { res.error().unexpected() });
+}
+
+
+void
+service::mf_clone(sdbus::Result<std::string> &&reply, std::string url)
+{
+    AURGH_TRACE_ID_SCOPE(trace::next_id());
+    AURGH_TRACE_SPAN("service", "Clone", url);
+
+    /* always the daemon's own directory, a caller does not get to pick what is cleared */
+    auto res = git::clone(url, m_clone_dir, *m_git);
+    if (!res)
+    {
+        reply.returnError(bus::to_error(res.error()));
+        return;
+    }
+
+    auto state = std::make_shared<clone_reply>(std::move(reply), std::move(res.value()));
+    mf_hold();
+
+    /* the task answers from inside its own signals, it is dropped once they are done */
+    auto finish = [this, state]
+    {
+        Glib::signal_idle().connect_once([state] { state->task.reset(); });
+        mf_release();
+    };
+
+    state->task
+        ->on_transfer_progress(
+            [this, url](double progress)
+            {
+                m_object->emitSignal(sdbus::SignalName { "CloneProgress" })
+                    .onInterface(sdbus::InterfaceName { bus::interface_name })
+                    .withArguments(url, progress);
+            })
+        .on_completed(
+            [state, finish](std::filesystem::path dst)
+            {
+                state->reply.returnResults(dst.string());
+                finish();
+            })
+        .on_error(
+            [state, finish](error e)
+            {
+                state->reply.returnError(bus::to_error(e));
+                finish();
+            });
+}
+
+
+/* a database that was registered again is read from scratch, whatever came from it is stale */
+void
+service::mf_reload_config()
+{
+    auto res = m_alpm.reload();
+    if (!res) return std::println(stderr, "warning: {}", res.error());
+
+    mf_hold();
+
+    res.value()
+        ->on_result(
+            [this](alpm::config_delta delta)
+            {
+                Glib::MainContext::get_default()->invoke(
+                    [this, delta = std::move(delta)]
+                    {
+                        if (!delta.repos.empty())
+                        {
+                            m_searches.clear();
+                            m_infos.clear();
+                            m_index_fresh = false;
+                        }
+
+                        /* an Include may have been added or dropped */
+                        if (auto res = m_config_watch->watch(delta.sources); !res)
+                            std::println(stderr, "warning: {}", res.error());
+
+                        mf_release();
+                        return false;
+                    });
+            })
+        .on_error(
+            [this](error e)
+            {
+                Glib::MainContext::get_default()->invoke(
+                    [this, e]
+                    {
+                        std::println(stderr, "warning: {}", e);
+                        mf_release();
+                        return false;
+                    });
+            });
+}
+
+
+void
+service::mf_hold()
+{
+    m_busy++;
+    m_idle_timer.disconnect();
+}
+
+
+void
+service::mf_release()
+{
+    if (--m_busy == 0) mf_arm_idle_timer();
+}
+
+
+void
+service::mf_arm_idle_timer()
+{
+    if (!m_on_idle or m_idle_timeout <= std::chrono::seconds::zero()) return;
+
+    m_idle_timer.disconnect();
+    m_idle_timer = Glib::signal_timeout().connect_seconds(
+        [this]
+        {
+            mf_on_idle();
+            return false;
+        },
+        m_idle_timeout.count());
+}
+
+
+/* the index is only rebuilt when the sync databases moved past the saved one */
+void
+service::mf_on_idle()
+{
+    if (m_busy != 0) return;
+
+    if (m_mirrors != nullptr)
+        if (auto res = m_mirrors->save(); !res) std::println(stderr, "warning: {}", res.error());
+
+    if (m_index_fresh or m_state_dir.empty()) return mf_quit();
+
+    auto res = m_alpm.index();
+    if (!res) return mf_quit();
+
+    /* holds off another timer while libalpm builds the index; a call that arrives meanwhile
+       holds the service too, and the timer is armed again once it is answered */
+    mf_hold();
+
+    auto done = [this](bool saved)
+    {
+        Glib::MainContext::get_default()->invoke(
+            [this, saved]
+            {
+                if (saved) m_index_fresh = true;
+
+                mf_release();
+                mf_quit();
+                return false;
+            });
+    };
+
+    res.value()
+        ->on_result(
+            [this, done](const alpm::sync_index &index)
+            {
+                auto res = warm_index::save(m_state_dir, index);
+                if (!res) std::println(stderr, "warning: {}", res.error());
+                done(res.has_value());
+            })
+        .on_error(
+            [done](error e)
+            {
+                std::println(stderr, "warning: failed to index the sync databases: {}", e);
+                done(false);
+            });
+}
+
+
+void
+service::mf_quit()
+{
+    if (m_busy != 0) return;
+
+    m_idle_timer.disconnect();
+    m_on_idle();
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <cctype>
+
+#include "warm_index.hh"
+
+using aurgh::warm_index;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::string_view packages_file = "sync-packages.bulk";
+    constexpr std::string_view details_file  = "sync-details.bulk";
+
+
+    [[nodiscard]]
+    auto
+    contains_nocase(std::string_view haystack, std::string_view needle) -> bool
+    {
+        auto equal = [](char a, char b)
+        {
+            return std::tolower(static_cast<unsigned char>(a))
+                == std::tolower(static_cast<unsigned char>(b));
+        };
+
+        return needle.empty() or !std::ranges::search(haystack, needle, equal).empty();
+    }
+
+
+    [[nodiscard]]
+    auto
+    to_vector(const aurgh::bulk::strings &list) -> std::vector<std::string>
+    {
+        std::vector<std::string> out;
+        out.reserve(list.size());
+
+        for (std::size_t i = 0; i < list.size(); i++) out.emplace_back(list[i]);
+        return out;
+    }
+}
+
+
+auto
+warm_index::load(const fs::path &dir, fs::file_time_type sync_time) noexcept -> result<warm_index>
+try
+{
+    fs::path packages_path = dir / packages_file;
+
+    std::error_code ec;
+    auto            saved = fs::last_write_time(packages_path, ec);
+    if (ec)
+        return error { "no warm index in \"{}\": {}", dir.c_str(), ec.message() }.unexpected();
+    if (saved < sync_time)
+        return error { "warm index in \"{}\" is older than the sync databases", dir.c_str() }
+            .unexpected();
+
+    auto packages = bulk::package_table::load(packages_path);
+    if (!packages) return packages.error().unexpected();
+
+    auto details = bulk::details_table::load(dir / details_file);
+    if (!details) return details.error().unexpected();
+
+    if (packages->size() != details->size())
+        return error { "warm index in \"{}\" is inconsistent", dir.c_str() }.unexpected();
+
+    return warm_index { std::move(packages.value()), std::move(details.value()) };
+}
+catch (const std::exception &e)
+{
+    return error { "failed to load the warm index: {}", e.what() }.unexpected();
+}
+
+
+auto
+warm_index::matches(std::string_view query, std::string_view name, std::string_view description)
+    -> bool
+{ return contains_nocase(name, query) or contains_nocase(description, query); }
+
+
+/* packages go last: load trusts their mtime, so a save cut short leaves a stale index */
+auto
+warm_index::save(const fs::path &dir, const alpm::sync_index &index) noexcept -> result<void>
+try
+{
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+        return error { "failed to create \"{}\": {}", dir.c_str(), ec.message() }.unexpected();
+
+    if (auto res = bulk::save(std::span { index.details }, dir / details_file); !res)
+        return res.error().unexpected();
+    return bulk::save(std::span { index.packages }, dir / packages_file);
+}
+catch (const std::exception &e)
+{
+    return error { "failed to save the warm index: {}", e.what() }.unexpected();
+}
+
+
+warm_index::warm_index(bulk::package_table &&packages, bulk::details_table &&details) noexcept
+    : m_packages { std::move(packages) }, m_details { std::move(details) }
+{
+}
+
+
+auto
+warm_index::search(std::string_view query) const -> std::vector<package>
+{
+    std::vector<package> out;
+
+    for (std::size_t i = 0; i < m_packages.size(); i++)
+    {
+        auto pkg = m_packages[i];
+        if (!matches(query, pkg.name(), pkg.description())) continue;
+
+        out.emplace_back(package { .name        = std::string { pkg.name() },
+                                   .version     = std::string { pkg.version() },
+                                   .description = std::string { pkg.description() },
+                                   .repo        = std::string { pkg.repo() },
+                                   .base        = std::string { pkg.base() } });
+    }
+
+    return out;
+}
+
+
+/* one entry per repository carrying the name, in database order like alpm::handle::info */
+auto
+warm_index::info(std::span<const std::string> names) const -> std::vector<package_details>
+{
+    std::vector<package_details> out;
+
+    for (const auto &name : names)
+        for (std::size_t i = 0; i < m_packages.size(); i++)
+        {
+            if (m_packages[i].name() != name) continue;
+
+            auto detail = m_details[i];
+            out.emplace_back(package_details { .licenses     = to_vector(detail.licenses()),
+                                               .depends      = to_vector(detail.depends()),
+                                               .make_depends = to_vector(detail.make_depends()),
+                                               .opt_depends  = to_vector(detail.opt_depends()),
+                                               .url          = std::string { detail.url() },
+                                               .last_updated = detail.last_updated(),
+                                               .base         = std::string { detail.base() } });
+        }
+
+    return out;
+}
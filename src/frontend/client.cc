@@ -1,23 +1,55 @@
+#include <algorithm>
 #include <memory>
+#include <print>
+
+#include <glibmm/main.h>
 
 #include "client.hh"
+#include "git/transport.hh"
 #include "result.hh"
 
 using aurgh::client;
 
+namespace
+{
+    constexpr std::string_view devel_cache_name = ".devel-heads";
+
+
+    [[nodiscard]]
+    auto
+    same_directory(const std::filesystem::path &a, const std::filesystem::path &b) -> bool
+    { return (a / "").lexically_normal() == (b / "").lexically_normal(); }
+}
+
 
 auto
 client::create(const std::shared_ptr<http::client> &http,
                std::filesystem::path                clone_dir,
-               const std::filesystem::path &pacman_conf) noexcept -> result<std::unique_ptr<client>>
+               const std::filesystem::path         &pacman_conf,
+               std::size_t                          clone_jobs) noexcept
+    -> result<std::unique_ptr<client>>
 try
 {
-    if (auto res = alpm::handle::create(pacman_conf); res.has_value())
-        return std::unique_ptr<client> {
-            new client { http, std::move(clone_dir), std::move(res.value()) }
-        };
-    else /* NOLINT */
+    std::shared_ptr<git::executor> git;
+
+    if (auto res = git::executor::create(clone_jobs); res.has_value())
+        git = std::move(res.value());
+    else
         return res.error().unexpected();
+
+    if (auto res = git::register_http_transport(http); !res) return res.error().unexpected();
+
+    /* without a session bus everything runs here, as before the daemon existed */
+    std::unique_ptr<daemon_client> daemon;
+    if (auto res = daemon_client::connect(); res.has_value()) daemon = std::move(res.value());
+
+    std::unique_ptr<client> self { new client { http, git, std::move(clone_dir), pacman_conf,
+                                                std::move(daemon) } };
+
+    if (self->m_daemon == nullptr)
+        if (auto res = self->mf_local_alpm(); !res) return res.error().unexpected();
+
+    return self;
 }
 catch (error &e)
 {
@@ -29,12 +61,19 @@ catch (const std::exception &e)
 }
 
 
-client::client(const std::shared_ptr<http::client> &http,
-               std::filesystem::path              &&clone_dir,
-               alpm::handle                       &&handle)
-    : m_client { http }, m_clone_dir { std::move(clone_dir) }, m_aur { m_client },
-      m_alpm { std::move(handle) }
+client::client(const std::shared_ptr<http::client>  &http,
+               const std::shared_ptr<git::executor> &git,
+               std::filesystem::path               &&clone_dir,
+               std::filesystem::path                 pacman_conf,
+               std::unique_ptr<daemon_client>      &&daemon)
+    : m_client { http }, m_git { git }, m_clone_dir { std::move(clone_dir) }, m_aur { m_client },
+      m_pacman_conf { std::move(pacman_conf) }, m_daemon { std::move(daemon) }
+{ m_alpm_dispatcher.connect(sigc::mem_fun(*this, &client::mf_alpm_loaded)); }
+
+
+client::~client()
 {
+    if (m_alpm_loader.joinable()) m_alpm_loader.join();
 }
 
 
@@ -42,7 +81,23 @@ auto
 client::search(const std::string &query) noexcept -> result<void>
 try
 {
-    return m_search_operation.perform(query, m_aur, m_alpm, &aur::search, &alpm::async::search);
+    if (m_daemon == nullptr or !m_daemon->available()) return mf_search_locally(query);
+
+    m_daemon->search(query,
+                     [this, query](result<std::vector<package>> res)
+                     {
+                         /* the daemon went away, the local operation emits instead */
+                         if (!res and !m_daemon->available())
+                         {
+                             auto local = mf_search_locally(query);
+                             if (local) return;
+
+                             res = local.error().unexpected();
+                         }
+
+                         m_search_operation.signal.emit(std::move(res));
+                     });
+    return {};
 }
 catch (const std::exception &e)
 {
@@ -54,7 +109,23 @@ auto
 client::info(const std::vector<std::string> &args) noexcept -> result<void>
 try
 {
-    return m_info_operation.perform(args, m_aur, m_alpm, &aur::info, &alpm::async::info);
+    if (m_daemon == nullptr or !m_daemon->available()) return mf_info_locally(args);
+
+    m_daemon->info(args,
+                   [this, args](result<std::vector<package_details>> res)
+                   {
+                       /* the daemon went away, the local operation emits instead */
+                       if (!res and !m_daemon->available())
+                       {
+                           auto local = mf_info_locally(args);
+                           if (local) return;
+
+                           res = local.error().unexpected();
+                       }
+
+                       m_info_operation.signal.emit(std::move(res));
+                   });
+    return {};
 }
 catch (const std::exception &e)
 {
@@ -64,13 +135,129 @@ catch (const std::exception &e)
 
 
 auto
-client::clone(std::string_view url) noexcept -> result<std::reference_wrapper<clone_process>>
+client::search_bulk(const std::string &query) noexcept -> result<void>
+try
+{
+    if (m_daemon == nullptr or !m_daemon->available())
+        return error { "bulk search needs a running aurgh-daemon" }.unexpected();
+
+    m_daemon->search_bulk(query, [this](result<std::shared_ptr<bulk::package_table>> res)
+                          { m_signal_on_search_bulk.emit(std::move(res)); });
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to perform bulk search of \"{}\": {}", query.c_str(), e.what() }
+        .unexpected();
+}
+
+
+auto
+client::info_bulk(const std::vector<std::string> &args) noexcept -> result<void>
+try
+{
+    if (m_daemon == nullptr or !m_daemon->available())
+        return error { "bulk info needs a running aurgh-daemon" }.unexpected();
+
+    m_daemon->info_bulk(args, [this](result<std::shared_ptr<bulk::details_table>> res)
+                        { m_signal_on_info_bulk.emit(std::move(res)); });
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to perform bulk info retrieval for {} packages: {}", args.size(),
+                   e.what() }
+        .unexpected();
+}
+
+
+auto
+client::mf_local_alpm() noexcept -> result<alpm::async *>
+try
+{
+    if (m_alpm.has_value()) return &*m_alpm;
+    if (m_alpm_loader.joinable()) return nullptr;
+
+    m_alpm_loader = std::thread {
+        [this, pacman_conf = m_pacman_conf]
+        {
+            m_alpm_loaded.emplace(alpm::handle::create(pacman_conf));
+            m_alpm_dispatcher.emit();
+        }
+    };
+
+    return nullptr;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to load libalpm: {}", e.what() }.unexpected();
+}
+
+
+void
+client::mf_alpm_loaded()
+{
+    m_alpm_loader.join();
+
+    /* a failed load is tried again by the next lookup that needs libalpm */
+    auto loaded = std::exchange(m_alpm_loaded, std::nullopt).value();
+    auto res    = loaded.transform([this](alpm::handle &h)
+                                   { return std::ref(m_alpm.emplace(std::move(h))); });
+
+    m_search_operation.resume(res);
+    m_info_operation.resume(res);
+}
+
+
+auto
+client::mf_search_locally(const std::string &query) noexcept -> result<void>
+{
+    if (auto res = mf_local_alpm(); res.has_value())
+        return m_search_operation.perform(query, m_aur, res.value(), &aur::search,
+                                          &alpm::async::search);
+    else /* NOLINT */
+        return res.error().unexpected();
+}
+
+
+auto
+client::mf_info_locally(const std::vector<std::string> &args) noexcept -> result<void>
+{
+    if (auto res = mf_local_alpm(); res.has_value())
+        return m_info_operation.perform(args, m_aur, res.value(), &aur::info, &alpm::async::info);
+    else /* NOLINT */
+        return res.error().unexpected();
+}
+
+
+auto
+client::clone(std::string_view url, git::executor::priority prio) noexcept
+    -> result<std::reference_wrapper<clone_process>>
 try
 {
-    if (auto res = git::clone(url, m_clone_dir); res.has_value())
+    auto base = git::repository_name(url);
+    if (!base) return base.error().unexpected();
+
+    std::scoped_lock lock { m_clone_mutex };
+
+    if (clone_process *running = mf_find_active(*base); running != nullptr) return *running;
+
+    /* the daemon's Clone only makes standalone clones, and only into its own directory */
+    if (mf_clones_on_daemon())
     {
-        std::scoped_lock lock { m_clone_mutex };
-        return m_clones.emplace_back(std::move(res.value()));
+        auto &process  = m_clones.emplace_back(*this, std::string { url }, std::move(*base));
+        process.m_self = std::prev(m_clones.end());
+
+        mf_clone_on_daemon(process, prio);
+        return process;
+    }
+
+    if (auto res = git::clone(url, m_clone_dir, *m_git, prio, m_clone_layout); res.has_value())
+    {
+        auto &process  = m_clones.emplace_back(*this, std::move(res.value()), std::string { url },
+                                               std::move(*base));
+        process.m_self = std::prev(m_clones.end());
+        return process;
     }
     else /* NOLINT */
         return res.error().unexpected();
@@ -83,112 +270,370 @@ catch (const std::exception &e)
 
 
 auto
-client::signal_on_search_complete() const -> sigc::signal<void(result<std::vector<package>>)>
-{ return m_search_operation.signal; }
+client::clone_packages(std::span<const package> packages, git::executor::priority prio) noexcept
+    -> result<std::vector<std::reference_wrapper<clone_process>>>
+try
+{
+    std::vector<std::string_view>                       bases;
+    std::vector<std::reference_wrapper<clone_process>> processes;
+
+    for (const auto &pkg : packages)
+    {
+        /* repository packages have no AUR git repository to clone */
+        if (pkg.repo != "aur") continue;
+
+        std::string_view base = pkg.base.empty() ? std::string_view { pkg.name.raw() } : pkg.base;
+        if (std::ranges::contains(bases, base)) continue;
+
+        bases.emplace_back(base);
+
+        if (auto res = clone(aur::git_url(base), prio); res.has_value())
+            processes.emplace_back(res.value());
+        else
+            return res.error().unexpected();
+    }
+
+    return processes;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to clone {} packages: {}", packages.size(), e.what() }.unexpected();
+}
 
 
 auto
-client::signal_on_info_complete() const -> sigc::signal<void(result<std::vector<package_details>>)>
-{ return m_info_operation.signal; }
+client::download_snapshot(std::string_view pkgbase, git::executor::priority prio) noexcept
+    -> result<std::reference_wrapper<clone_process>>
+try
+{
+    std::scoped_lock lock { m_clone_mutex };
 
+    if (clone_process *running = mf_find_active(pkgbase); running != nullptr) return *running;
 
-using clone_process = client::clone_process;
+    if (auto res = fetch_snapshot(m_client, m_snapshot_url, pkgbase, m_clone_dir, *m_git, prio);
+        res.has_value())
+    {
+        auto &process  = m_clones.emplace_back(*this, std::move(res.value()),
+                                               std::format("{}/{}.tar.gz", m_snapshot_url, pkgbase),
+                                               std::string { pkgbase });
+        process.m_self = std::prev(m_clones.end());
+        return process;
+    }
+    else /* NOLINT */
+        return res.error().unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { R"(failed to download the snapshot of "{}": {})", pkgbase, e.what() }
+        .unexpected();
+}
 
 
-clone_process::clone_process(std::shared_ptr<git::cloning> &&cloning)
-    : m_cloning { std::move(cloning) }
+auto
+client::peek(std::string_view url) noexcept
+    -> result<std::shared_ptr<git::request<git::head_files>>>
+try
+{
+    return git::peek(url, *m_git);
+}
+catch (const std::exception &e)
 {
-    m_complete_dispatcher.connect([this] { m_signal_on_complete.emit(m_dst); });
-    m_progress_dispatcher.connect([this] { m_signal_on_progress.emit(m_progress); });
+    return error { "failed to peek at remote repository \"{}\": {}", url, e.what() }.unexpected();
+}
 
-    m_cloning
-        ->on_transfer_progress(
-            [this](double progress)
-            {
-                m_progress.store(progress, std::memory_order_relaxed);
-                m_progress_dispatcher.emit();
-            })
-        .on_completed(
-            [this](std::filesystem::path dst)
-            {
-                m_dst = std::move(dst);
-                m_complete_dispatcher.emit();
-            })
-        .on_error(
-            [this](error e)
-            {
-                m_dst = e.unexpected();
-                m_complete_dispatcher.emit();
-            });
+
+auto
+client::check_updates(std::size_t concurrency) noexcept
+    -> result<std::shared_ptr<git::request<git::update_report>>>
+try
+{
+    if (auto res = git::list_clones(m_clone_dir); res.has_value())
+        return git::find_updates(std::move(res.value()), *m_git, concurrency);
+    else /* NOLINT */
+        return res.error().unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { "failed to check clones for updates: {}", e.what() }.unexpected();
 }
 
 
-clone_process::clone_process(clone_process &&other) noexcept
-    : m_signal_on_complete { std::move(other.m_signal_on_complete) },
-      m_signal_on_progress { std::move(other.m_signal_on_progress) },
-      m_dst { std::move(other.m_dst) }, m_progress { other.m_progress.load() },
-      m_cloning { std::move(other.m_cloning) }
+auto
+client::check_devel(std::size_t concurrency) noexcept
+    -> result<std::shared_ptr<git::request<git::devel_report>>>
+try
 {
-    m_complete_dispatcher.connect([this] { m_signal_on_complete.emit(m_dst); });
-    m_progress_dispatcher.connect([this] { m_signal_on_progress.emit(m_progress); });
+    auto cache = git::devel_cache::load(m_clone_dir / devel_cache_name);
+    if (!cache) return cache.error().unexpected();
 
-    m_cloning
-        ->on_transfer_progress(
-            [this](double progress)
-            {
-                m_progress.store(progress, std::memory_order_relaxed);
-                m_progress_dispatcher.emit();
-            })
-        .on_completed(
-            [this](std::filesystem::path dst)
-            {
-                m_dst = std::move(dst);
-                m_complete_dispatcher.emit();
-            })
-        .on_error(
-            [this](error e)
+    auto clones = git::list_clones(m_clone_dir);
+    if (!clones) return clones.error().unexpected();
+
+    auto req = git::find_devel_updates(std::move(clones.value()), cache->commits(), *m_git,
+                                       concurrency);
+
+    /* connected first, so it runs before any handler of the caller */
+    req->on_result(
+        [this, cache = std::move(cache.value())](const git::devel_report &report) mutable
+        {
+            /* a source seen for the first time is assumed to be what was last built */
+            for (const auto &[clone, heads] : report.heads)
+                for (const auto &[key, commit] : heads)
+                    if (!cache.commits().contains(key)) cache.set(key, commit);
+
+            for (const auto &[clone, heads] : report.heads) m_devel_heads[clone] = heads;
+
+            /* the report still stands, the next check just takes these commits as new again */
+            if (auto res = cache.save(); !res) std::println(stderr, "warning: {}", res.error());
+        });
+
+    return req;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to check devel packages: {}", e.what() }.unexpected();
+}
+
+
+auto
+client::mark_rebuilt(std::string_view pkgbase) noexcept -> result<void>
+try
+{
+    auto it = m_devel_heads.find(m_clone_dir / pkgbase);
+    if (it == m_devel_heads.end())
+        return error { "\"{}\" has not been checked for devel updates", pkgbase }.unexpected();
+
+    auto cache = git::devel_cache::load(m_clone_dir / devel_cache_name);
+    if (!cache) return cache.error().unexpected();
+
+    for (const auto &[key, commit] : it->second) cache->set(key, commit);
+    return cache->save();
+}
+catch (const std::exception &e)
+{
+    return error { "failed to mark \"{}\" as rebuilt: {}", pkgbase, e.what() }.unexpected();
+}
+
+
+auto
+client::local_info(std::string_view pkgbase) const noexcept -> result<std::vector<package_details>>
+try
+{
+    if (auto res = srcinfo::parse(m_clone_dir / pkgbase / ".SRCINFO"); res.has_value())
+        return res->details();
+    else /* NOLINT */
+        return res.error().unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { "failed to read local info of \"{}\": {}", pkgbase, e.what() }.unexpected();
+}
+
+
+auto
+client::active_clones() const -> std::vector<std::reference_wrapper<const clone_process>>
+{
+    std::scoped_lock lock { m_clone_mutex };
+
+    std::vector<std::reference_wrapper<const clone_process>> active;
+    for (const auto &process : m_clones)
+        if (!process.finished()) active.emplace_back(process);
+    return active;
+}
+
+
+auto
+client::mf_find_active(std::string_view base) noexcept -> clone_process *
+{
+    for (auto &process : m_clones)
+        if (!process.finished() and process.m_base == base) return &process;
+    return nullptr;
+}
+
+
+auto
+client::mf_clones_on_daemon() const noexcept -> bool
+{
+    if (m_daemon == nullptr or !m_daemon->available()) return false;
+    if (m_clone_layout != git::layout::standalone) return false;
+
+    const auto &dir = m_daemon->clone_dir();
+    return dir.has_value() and same_directory(dir.value(), m_clone_dir);
+}
+
+
+void
+client::mf_clone_on_daemon(clone_process &process, git::executor::priority prio)
+{
+    process.m_daemon_progress = m_daemon->signal_on_clone_progress().connect(
+        [&process](const std::string &url, double progress)
+        {
+            if (url != process.m_url) return;
+
+            process.m_progress = progress;
+            process.m_signal_on_progress.emit(progress);
+        });
+
+    m_daemon->clone(
+        process.m_url,
+        [this, &process, prio](result<std::filesystem::path> res)
+        {
+            process.m_daemon_progress.disconnect();
+
+            /* the daemon went away, the clone is made here instead */
+            if (!res and !m_daemon->available())
             {
-                m_dst = e.unexpected();
-                m_complete_dispatcher.emit();
-            });
+                auto local = git::clone(process.m_url, m_clone_dir, *m_git, prio, m_clone_layout);
+                if (local.has_value())
+                {
+                    process.mf_connect(*local.value());
+                    process.m_source = std::move(local.value());
+                    return;
+                }
+
+                res = local.error().unexpected();
+            }
+
+            process.m_dst = std::move(res);
+            process.mf_finish();
+        });
 }
 
 
 auto
-clone_process::operator=(clone_process &&other) noexcept -> clone_process &
+client::finished_clones() const -> std::deque<clone_record>
 {
-    if (this == &other) return *this;
+    std::scoped_lock lock { m_clone_mutex };
+    return m_finished_clones;
+}
+
 
-    m_signal_on_complete = std::move(other.m_signal_on_complete);
-    m_signal_on_progress = std::move(other.m_signal_on_progress);
-    m_dst                = std::move(other.m_dst);
-    m_progress           = other.m_progress.load();
-    m_cloning            = std::move(other.m_cloning);
+void
+client::mf_clone_finished(clone_process &process)
+{
+    {
+        std::scoped_lock lock { m_clone_mutex };
+
+        if (m_finished_clones.size() == max_finished_clones) m_finished_clones.pop_front();
+        m_finished_clones.emplace_back(process.m_url, process.m_dst);
+    }
+
+    /* the process is still inside its completion signal here */
+    Glib::signal_idle().connect_once(
+        sigc::bind(sigc::mem_fun(*this, &client::mf_reclaim), process.m_self));
+}
 
-    m_complete_dispatcher.connect([this] { m_signal_on_complete.emit(m_dst); });
-    m_progress_dispatcher.connect([this] { m_signal_on_progress.emit(m_progress); });
 
-    m_cloning
-        ->on_transfer_progress(
+void
+client::mf_reclaim(std::list<clone_process>::iterator it)
+{
+    std::scoped_lock lock { m_clone_mutex };
+    m_clones.erase(it);
+}
+
+
+void
+client::set_clone_layout(git::layout layout) noexcept
+{ m_clone_layout = layout; }
+
+
+void
+client::set_snapshot_url(std::string base_url) noexcept
+{
+    while (base_url.ends_with('/')) base_url.pop_back();
+    m_snapshot_url = std::move(base_url);
+}
+
+
+auto
+client::signal_on_search_complete() const -> sigc::signal<void(result<std::vector<package>>)>
+{ return m_search_operation.signal; }
+
+
+auto
+client::signal_on_info_complete() const -> sigc::signal<void(result<std::vector<package_details>>)>
+{ return m_info_operation.signal; }
+
+
+auto
+client::signal_on_search_bulk_complete() const
+    -> sigc::signal<void(result<std::shared_ptr<bulk::package_table>>)>
+{ return m_signal_on_search_bulk; }
+
+
+auto
+client::signal_on_info_bulk_complete() const
+    -> sigc::signal<void(result<std::shared_ptr<bulk::details_table>>)>
+{ return m_signal_on_info_bulk; }
+
+
+using clone_process = client::clone_process;
+
+
+clone_process::clone_process(client                          &owner,
+                             std::shared_ptr<git::cloning> &&source,
+                             std::string                     url,
+                             std::string                     base)
+    : m_owner { &owner }, m_url { std::move(url) }, m_base { std::move(base) },
+      m_dst { error { "clone has not finished yet" }.unexpected() }
+{
+    mf_connect(*source);
+    m_source = std::move(source);
+}
+
+
+clone_process::clone_process(client                     &owner,
+                             std::shared_ptr<snapshot> &&source,
+                             std::string                url,
+                             std::string                base)
+    : m_owner { &owner }, m_url { std::move(url) }, m_base { std::move(base) },
+      m_dst { error { "snapshot has not finished yet" }.unexpected() }
+{
+    mf_connect(*source);
+    m_source = std::move(source);
+}
+
+
+clone_process::clone_process(client &owner, std::string url, std::string base)
+    : m_owner { &owner }, m_url { std::move(url) }, m_base { std::move(base) },
+      m_dst { error { "clone has not finished yet" }.unexpected() }
+{
+}
+
+
+/* both sources already report on the main loop */
+template <typename Source>
+void
+clone_process::mf_connect(Source &source)
+{
+    source
+        .on_transfer_progress(
             [this](double progress)
             {
-                m_progress.store(progress, std::memory_order_relaxed);
-                m_progress_dispatcher.emit();
+                m_progress = progress;
+                m_signal_on_progress.emit(progress);
             })
         .on_completed(
             [this](std::filesystem::path dst)
             {
                 m_dst = std::move(dst);
-                m_complete_dispatcher.emit();
+                mf_finish();
             })
         .on_error(
             [this](error e)
             {
                 m_dst = e.unexpected();
-                m_complete_dispatcher.emit();
+                mf_finish();
             });
+}
+
 
-    return *this;
+void
+clone_process::mf_finish()
+{
+    m_finished = true;
+    m_signal_on_complete.emit(m_dst);
+    m_owner->mf_clone_finished(*this);
 }
 
 
@@ -201,3 +646,22 @@ auto
 clone_process::signal_on_clone_progress() const -> sigc::signal<void(double)>
 { return m_signal_on_progress; }
 
+
+auto
+clone_process::url() const noexcept -> std::string_view
+{ return m_url; }
+
+
+auto
+clone_process::base() const noexcept -> std::string_view
+{ return m_base; }
+
+
+auto
+clone_process::progress() const noexcept -> double
+{ return m_progress; }
+
+
+auto
+clone_process::finished() const noexcept -> bool
+{ return m_finished; }
@@ -0,0 +1,197 @@
+#include <chrono>
+
+#include "daemon_client.hh"
+
+using aurgh::daemon_client;
+namespace bus = aurgh::bus;
+
+namespace
+{
+    /* a clone answers once it is done, which takes longer than the bus default allows */
+    constexpr std::chrono::minutes clone_timeout { 30 };
+
+
+    template <typename Record>
+    [[nodiscard]]
+    auto
+    from_records(std::vector<Record> &&records)
+    {
+        std::vector<decltype(bus::from_record(std::move(records.front())))> out;
+        out.reserve(records.size());
+
+        for (auto &record : records) out.emplace_back(bus::from_record(std::move(record)));
+        return out;
+    }
+
+
+    [[nodiscard]]
+    auto
+    from_error(const sdbus::Error &e) -> aurgh::error
+    { return aurgh::error { "aurgh-daemon: {}", e.getMessage() }; }
+
+
+    /* errors the daemon itself reports mean it is alive */
+    [[nodiscard]]
+    auto
+    is_bus_failure(const sdbus::Error &e) -> bool
+    { return e.getName() != bus::error_name; }
+}
+
+
+auto
+daemon_client::connect() noexcept -> result<std::unique_ptr<daemon_client>>
+try
+{
+    return std::unique_ptr<daemon_client> { new daemon_client {
+        sdbus::createSessionBusConnection() } };
+}
+catch (const sdbus::Error &e)
+{
+    return error { "failed to connect to the session bus: {}", e.getMessage() }.unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { "failed to connect to aurgh-daemon: {}", e.what() }.unexpected();
+}
+
+
+daemon_client::daemon_client(std::unique_ptr<sdbus::IConnection> &&connection)
+    : m_connection { std::move(connection) },
+      m_source { std::make_unique<bus::main_loop_source>(*m_connection) },
+      m_proxy { sdbus::createProxy(*m_connection, sdbus::ServiceName { bus::service_name },
+                                   sdbus::ObjectPath { bus::object_path }) }
+{
+    m_proxy->uponSignal(sdbus::SignalName { "CloneProgress" })
+        .onInterface(sdbus::InterfaceName { bus::interface_name })
+        .call([this](std::string url, double progress)
+              { m_signal_on_clone_progress.emit(std::move(url), progress); });
+
+    /* clones only go to the daemon once it is known where it puts them */
+    m_proxy->getPropertyAsync(sdbus::PropertyName { "CloneDir" })
+        .onInterface(sdbus::InterfaceName { bus::interface_name })
+        .uponReplyInvoke(
+            [this](std::optional<sdbus::Error> e, sdbus::Variant value)
+            {
+                if (!e.has_value())
+                    m_clone_dir = value.get<std::string>();
+                else if (is_bus_failure(*e))
+                    m_available = false;
+            });
+}
+
+
+auto
+daemon_client::available() const noexcept -> bool
+{ return m_available; }
+
+
+void
+daemon_client::search(const std::string &query, callback<std::vector<package>> done)
+{
+    m_proxy->callMethodAsync(sdbus::MethodName { "Search" })
+        .onInterface(sdbus::InterfaceName { bus::interface_name })
+        .withArguments(query)
+        .uponReplyInvoke(
+            [this, done = std::move(done)](std::optional<sdbus::Error>      e,
+                                           std::vector<bus::package_record> records)
+            {
+                if (e.has_value())
+                {
+                    if (is_bus_failure(*e)) m_available = false;
+                    done(from_error(*e).unexpected());
+                }
+                else
+                    done(from_records(std::move(records)));
+            });
+}
+
+
+void
+daemon_client::info(const std::vector<std::string>       &names,
+                    callback<std::vector<package_details>> done)
+{
+    m_proxy->callMethodAsync(sdbus::MethodName { "Info" })
+        .onInterface(sdbus::InterfaceName { bus::interface_name })
+        .withArguments(names)
+        .uponReplyInvoke(
+            [this, done = std::move(done)](std::optional<sdbus::Error>      e,
+                                           std::vector<bus::details_record> records)
+            {
+                if (e.has_value())
+                {
+                    if (is_bus_failure(*e)) m_available = false;
+                    done(from_error(*e).unexpected());
+                }
+                else
+                    done(from_records(std::move(records)));
+            });
+}
+
+
+void
+daemon_client::search_bulk(const std::string                             &query,
+                           callback<std::shared_ptr<bulk::package_table>> done)
+{ mf_call_bulk<bulk::package_table>("SearchBulk", query, std::move(done)); }
+
+
+void
+daemon_client::info_bulk(const std::vector<std::string>                &names,
+                         callback<std::shared_ptr<bulk::details_table>> done)
+{ mf_call_bulk<bulk::details_table>("InfoBulk", names, std::move(done)); }
+
+
+void
+daemon_client::clone(const std::string &url, callback<std::filesystem::path> done)
+{
+    m_proxy->callMethodAsync(sdbus::MethodName { "Clone" })
+        .onInterface(sdbus::InterfaceName { bus::interface_name })
+        .withTimeout(clone_timeout)
+        .withArguments(url)
+        .uponReplyInvoke(
+            [this, done = std::move(done)](std::optional<sdbus::Error> e, std::string path)
+            {
+                if (e.has_value())
+                {
+                    if (is_bus_failure(*e)) m_available = false;
+                    done(from_error(*e).unexpected());
+                }
+                else
+                    done(std::filesystem::path { std::move(path) });
+            });
+}
+
+
+auto
+daemon_client::clone_dir() const noexcept -> const std::optional<std::filesystem::path> &
+{ return m_clone_dir; }
+
+
+auto
+daemon_client::signal_on_clone_progress() const -> sigc::signal<void(std::string, double)>
+{ return m_signal_on_clone_progress; }
+
+
+template <typename Table, typename Arg>
+void
+daemon_client::mf_call_bulk(std::string_view method, const Arg &arg,
+                            callback<std::shared_ptr<Table>> done)
+{
+    m_proxy->callMethodAsync(sdbus::MethodName { std::string { method } })
+        .onInterface(sdbus::InterfaceName { bus::interface_name })
+        .withArguments(arg)
+        .uponReplyInvoke(
+            [this, done = std::move(done)](std::optional<sdbus::Error> e, sdbus::UnixFd fd)
+            {
+                if (e.has_value())
+                {
+                    if (is_bus_failure(*e)) m_available = false;
+                    return done(from_error(*e).unexpected());
+                }
+
+                /* the mapping keeps the memory alive, the descriptor closes with fd */
+                if (auto table = Table::open(fd.get()); table.has_value())
+                    done(std::make_shared<Table>(std::move(table.value())));
+                else
+                    done(table.error().unexpected());
+            });
+}
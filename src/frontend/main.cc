@@ -1,11 +1,14 @@
 #include <gtkmm/application.h>
 
+#include "trace.hh"
 #include "window.hh"
 
 
 auto
 main(int argc, char **argv) -> int
 {
+    aurgh::trace::init();
+
     return Gtk::Application::create("org.kei.aurgh")
         ->make_window_and_run<aurgh::window>(argc, argv);
 }
@@ -0,0 +1,339 @@
+#include <array>
+#include <format>
+
+#include <archive.h>
+#include <archive_entry.h>
+#include <glibmm/main.h>
+
+#include "snapshot.hh"
+#include "utils.hh"
+
+using aurgh::snapshot;
+namespace fs = std::filesystem;
+
+namespace
+{
+    using read_destructor  = aurgh::util::destructor<archive, archive_read_free>;
+    using write_destructor = aurgh::util::destructor<archive, archive_write_free>;
+
+
+    /* no SECURE_NOABSOLUTEPATHS: every entry is rebased onto the absolute staging directory,
+       rebase has already refused the entries that are absolute or climb out of it */
+    constexpr int extract_flags = ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM
+                                | ARCHIVE_EXTRACT_SECURE_SYMLINKS
+                                | ARCHIVE_EXTRACT_SECURE_NODOTDOT;
+
+
+    /* feeds libarchive straight from the response body, nothing touches the disk compressed */
+    struct body_reader
+    {
+        aurgh::http::pipe          *body;
+        std::array<char, 64 * 1024> buffer;
+    };
+
+
+    auto
+    read_callback(archive *a, void *client_data, const void **buffer) -> la_ssize_t
+    {
+        auto *reader = static_cast<body_reader *>(client_data);
+
+        auto res = reader->body->read(reader->buffer.data(), reader->buffer.size());
+        if (!res)
+        {
+            archive_set_error(a, EIO, "%s", std::string { res.error().message() }.c_str());
+            return -1;
+        }
+
+        *buffer = reader->buffer.data();
+        return la_ssize_t(res.value());
+    }
+
+
+    /* cgit puts everything under <pkgbase>/, the entry is rebased onto @p root instead;
+       nullopt for the <pkgbase>/ directory itself */
+    [[nodiscard]]
+    auto
+    rebase(const char *path, const fs::path &root) -> aurgh::result<std::optional<fs::path>>
+    {
+        fs::path entry { path };
+        if (entry.has_root_path())
+            return aurgh::error { R"(the snapshot has an absolute entry "{}")", path }.unexpected();
+
+        fs::path relative;
+        bool     first = true;
+
+        for (const auto &part : entry)
+        {
+            if (part == "..")
+                return aurgh::error { R"(the snapshot entry "{}" leaves its directory)", path }
+                    .unexpected();
+
+            if (std::exchange(first, false) or part.empty() or part == ".") continue;
+            relative /= part;
+        }
+
+        if (relative.empty()) return std::nullopt;
+        return root / relative;
+    }
+}
+
+
+snapshot::snapshot(const std::shared_ptr<http::client> &http, std::string url, fs::path dst)
+    : m_http { http }, m_url { std::move(url) }, m_dst { std::move(dst) }
+{
+    if (!fs::exists(m_dst.parent_path())) fs::create_directories(m_dst.parent_path());
+    if (!fs::is_directory(m_dst.parent_path()))
+        throw error { "clone base directory is not a directory" };
+
+    m_dispatch_done.connect(sigc::mem_fun(*this, &snapshot::mf_on_done));
+}
+
+
+void
+snapshot::cancel()
+{
+    m_stop_source.request_stop();
+    m_body.fail("the snapshot download was cancelled");
+
+    if (m_transfer != nullptr) std::ignore = m_transfer->cancel();
+}
+
+
+auto
+snapshot::mf_start() -> result<void>
+{
+    if (m_stop_source.stop_requested()) return {};
+
+    if (auto res = m_http->get(m_url); res.has_value())
+        m_transfer = std::move(res.value());
+    else
+        return res.error().unexpected();
+
+    m_transfer
+        ->on_data(
+            [this](std::string_view data)
+            {
+                if (m_refused) return;
+
+                if (int code = m_transfer->response_code(); code != 200)
+                {
+                    m_body.fail(std::format("server returned code {}", code));
+                    m_refused = true;
+
+                    /* libcurl refuses to remove handles from inside its own callbacks */
+                    Glib::signal_idle().connect_once([t = m_transfer]
+                                                     { std::ignore = t->cancel(); });
+                    return;
+                }
+
+                m_body.push(data);
+
+                /* taken with the first data, so that a queued snapshot holds no slot */
+                if (m_received == 0)
+                {
+                    auto res = progress::acquire(
+                        [this](double value) { m_signal_on_transfer_progress.emit(value); });
+                    if (res.has_value()) m_progress = std::move(res.value());
+                }
+
+                m_received += data.size();
+                if (curl_off_t length = m_transfer->content_length(); length > 0)
+                    m_progress.store(double(m_received) / double(length));
+            })
+        .on_complete(
+            [this](http::completion complete)
+            {
+                if (complete.curl_result != CURLE_OK)
+                    m_body.fail(curl_easy_strerror(complete.curl_result));
+                else if (complete.return_code != 200)
+                    m_body.fail(std::format("server returned code {}", complete.return_code));
+                else
+                    m_body.close();
+            })
+        .on_error([this](std::string_view e) { m_body.fail(std::string { e }); });
+
+    return {};
+}
+
+
+void
+snapshot::mf_run()
+{
+    auto staging = m_dst.parent_path() / std::format(".{}.snapshot", m_dst.filename().string());
+
+    auto res = [&] -> result<void>
+    {
+        if (m_stop_source.stop_requested())
+            return error { R"(snapshot of "{}" was cancelled)", m_url }.unexpected();
+
+        if (fs::exists(m_dst / ".git"))
+            return error { R"("{}" is a git clone, it will not be replaced by a snapshot)",
+                           m_dst.c_str() }
+                .unexpected();
+
+        std::error_code ec;
+        fs::remove_all(staging, ec);
+        if (fs::create_directories(staging, ec); ec)
+            return error { R"(failed to create "{}": {})", staging.c_str(), ec.message() }
+                .unexpected();
+
+        /* the download only starts once the job runs, a queued snapshot buffers nothing */
+        Glib::MainContext::get_default()->invoke(
+            [self = shared_from_this()]
+            {
+                if (auto res = self->mf_start(); !res)
+                    self->m_body.fail(std::string { res.error().message() });
+                return false;
+            });
+
+        if (auto res = mf_extract(staging); !res) return res;
+
+        fs::remove_all(m_dst, ec);
+        if (fs::rename(staging, m_dst, ec); ec)
+            return error { R"(failed to move the snapshot to "{}": {})", m_dst.c_str(),
+                           ec.message() }
+                .unexpected();
+
+        return {};
+    }();
+
+    if (!res)
+    {
+        std::error_code ec;
+        fs::remove_all(staging, ec);
+        m_pending_error = std::move(res.error());
+    }
+
+    m_dispatch_done.emit();
+}
+
+
+auto
+snapshot::mf_extract(const fs::path &staging) -> result<void>
+{
+    std::unique_ptr<archive, read_destructor>  reader { archive_read_new() };
+    std::unique_ptr<archive, write_destructor> writer { archive_write_disk_new() };
+
+    if (reader == nullptr or writer == nullptr)
+        return error { "failed to allocate libarchive handles" }.unexpected();
+
+    archive_read_support_filter_all(reader.get());
+    archive_read_support_format_tar(reader.get());
+    archive_write_disk_set_options(writer.get(), extract_flags);
+    archive_write_disk_set_standard_lookup(writer.get());
+
+    auto fail = [&](archive *a) -> result<void>
+    {
+        const char *message = archive_error_string(a);
+        return error { R"(failed to extract "{}": {})", m_url,
+                       message != nullptr ? message : "unknown error" }
+            .unexpected();
+    };
+
+    auto body = std::make_unique<body_reader>(&m_body);
+
+    if (archive_read_open(reader.get(), body.get(), nullptr, read_callback, nullptr) != ARCHIVE_OK)
+        return fail(reader.get());
+
+    archive_entry *entry = nullptr;
+
+    while (true)
+    {
+        if (m_stop_source.stop_requested())
+            return error { R"(snapshot of "{}" was cancelled)", m_url }.unexpected();
+
+        int status = archive_read_next_header(reader.get(), &entry);
+        if (status == ARCHIVE_EOF) break;
+        if (status < ARCHIVE_WARN) return fail(reader.get());
+
+        auto path = rebase(archive_entry_pathname(entry), staging);
+        if (!path) return path.error().unexpected();
+        if (!path->has_value()) continue; /* the <pkgbase>/ directory itself */
+
+        archive_entry_set_pathname(entry, path->value().c_str());
+
+        if (const char *link = archive_entry_hardlink(entry); link != nullptr)
+        {
+            auto target = rebase(link, staging);
+            if (!target) return target.error().unexpected();
+            if (!target->has_value())
+                return error { R"(the snapshot entry "{}" links to its directory)", link }
+                    .unexpected();
+
+            archive_entry_set_hardlink(entry, target->value().c_str());
+        }
+
+        if (archive_write_header(writer.get(), entry) < ARCHIVE_WARN) return fail(writer.get());
+
+        const void *block;
+        std::size_t size;
+        la_int64_t  offset;
+
+        while ((status = archive_read_data_block(reader.get(), &block, &size, &offset))
+               == ARCHIVE_OK)
+            if (archive_write_data_block(writer.get(), block, size, offset) < ARCHIVE_WARN)
+                return fail(writer.get());
+
+        if (status != ARCHIVE_EOF) return fail(reader.get());
+        if (archive_write_finish_entry(writer.get()) < ARCHIVE_WARN) return fail(writer.get());
+    }
+
+    if (archive_write_close(writer.get()) != ARCHIVE_OK) return fail(writer.get());
+    return {};
+}
+
+
+void
+snapshot::mf_on_done()
+{
+    /* an extraction error leaves the download running */
+    if (m_transfer != nullptr)
+    {
+        std::ignore = m_transfer->cancel();
+        m_transfer.reset();
+    }
+
+    m_progress.release();
+
+    if (m_pending_error.has_value())
+        m_signal_on_error.emit(m_pending_error.value());
+    else
+        m_signal_on_completed.emit(m_dst);
+}
+
+
+auto
+aurgh::fetch_snapshot(const std::shared_ptr<http::client> &http,
+                      std::string_view                     base_url,
+                      std::string_view                     pkgbase,
+                      const fs::path                      &clone_dir,
+                      git::executor                       &exec,
+                      git::executor::priority              prio) noexcept
+    -> result<std::shared_ptr<snapshot>>
+try
+{
+    if (pkgbase.empty() or pkgbase.starts_with('.') or pkgbase.contains('/'))
+        return error { R"("{}" is not a valid package base)", pkgbase }.unexpected();
+
+    while (base_url.ends_with('/')) base_url.remove_suffix(1);
+
+    auto task = std::make_shared<snapshot>(http, std::format("{}/{}.tar.gz", base_url, pkgbase),
+                                           clone_dir / pkgbase);
+
+    /* the job keeps the snapshot alive until it has run, a dropped one reports the cancel */
+    exec.submit([task] { task->mf_run(); }, prio,
+                [task]
+                {
+                    task->m_stop_source.request_stop();
+                    task->mf_run();
+                });
+    return task;
+}
+catch (const std::exception &e)
+{
+    return error { R"(failed to fetch the snapshot of "{}": {})", pkgbase, e.what() }.unexpected();
+}
+catch (error &e)
+{
+    return e.unexpected();
+}
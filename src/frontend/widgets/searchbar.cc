@@ -1,5 +1,6 @@
 #include <gtkmm.h>
 
+#include "trace.hh"
 #include "widgets/searchbar.hh"
 
 using aurgh::widget::searchbar;
@@ -14,7 +15,11 @@ try
     m_searchbar->connect_entry(*m_searchentry);
 
     m_searchentry->signal_search_changed().connect(
-        [this]() { m_signal_on_search.emit(m_searchentry->get_text()); });
+        [this]()
+        {
+            AURGH_TRACE_SPAN("ui", "searchbar::search_changed", m_searchentry->get_text().raw());
+            m_signal_on_search.emit(m_searchentry->get_text());
+        });
 
     return {};
 }
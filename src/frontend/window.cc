@@ -1,19 +1,62 @@
+#include <chrono>
+#include <cstdlib>
 #include <print>
+#include <string_view>
 
 #include <gtkmm.h>
 
+#include "trace.hh"
 #include "window.hh"
 
 using aurgh::window;
 
+namespace
+{
+    /* as close to process start as static initialisation gets */
+    const auto started = std::chrono::steady_clock::now();
+
+
+    /* with AURGH_TIMINGS set, prints how long it took until the window first painted; with
+       AURGH_TIMINGS=exit the window then closes, so that runs can be repeated from a script */
+    void
+    report_first_frame(Gtk::Window &window)
+    {
+        const char *timings = std::getenv("AURGH_TIMINGS");
+        if (timings == nullptr and !aurgh::trace::enabled()) return;
+
+        bool print = timings != nullptr;
+        bool exit  = print and std::string_view { timings } == "exit";
+
+        window.add_tick_callback(
+            [&window, print, exit](const Glib::RefPtr<Gdk::FrameClock> &)
+            {
+                AURGH_TRACE_INSTANT("ui", "first_frame");
+                if (!print) return false;
+
+                auto elapsed = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - started);
+
+                std::println(stderr, "first frame after {:.1f}ms", elapsed.count());
+
+                /* not from inside the frame clock */
+                if (exit) Glib::signal_idle().connect_once([&window] { window.close(); });
+                return false;
+            });
+    }
+}
+
 
 window::window()
     : m_client {
           client::create(http::client::create().value(), "/home/kei/project/aurgh/clone/").value()
       }
 {
+    AURGH_TRACE_SPAN("ui", "window::window");
+
     auto builder = Gtk::Builder::create_from_resource("/org/kei/aurgh/window.ui");
 
+    report_first_frame(*this);
+
     this->set_title("aurgh");
     this->set_child(*builder->get_widget<Gtk::Box>("main_container"));
 
@@ -25,9 +25,11 @@ async::~async()
 void
 async::run()
 {
+    AURGH_TRACE_THREAD("alpm");
+
     while (true)
     {
-        std::move_only_function<void()> job;
+        job next;
 
         {
             std::unique_lock lock { m_mutex };
@@ -36,11 +38,12 @@ async::run()
 
             if (m_stopping and m_queue.empty()) break;
 
-            job = std::move(m_queue.front());
+            next = std::move(m_queue.front());
             m_queue.pop_front();
         }
 
-        job();
+        AURGH_TRACE_ID_SCOPE(next.id);
+        next.fn();
     }
 }
 
@@ -77,3 +80,113 @@ async::info(const std::vector<std::string> &args) noexcept
     m_cv.notify_one();
     return req;
 }
+
+
+auto
+async::transaction(transaction_request trans) noexcept
+    -> result<std::shared_ptr<async::request<std::vector<package>>>>
+{
+    auto req = make_request<std::vector<package>>();
+
+    {
+        std::lock_guard lock { m_mutex };
+
+        m_queue.emplace_back([this, req, trans = std::move(trans)]
+                             { req->complete(m_handle.transaction(trans)); });
+    }
+
+    m_cv.notify_one();
+    return req;
+}
+
+
+auto
+async::reorder_servers() noexcept -> result<std::shared_ptr<request<std::monostate>>>
+{
+    auto req = make_request<std::monostate>();
+
+    {
+        std::lock_guard lock { m_mutex };
+
+        m_queue.emplace_back(
+            [this, req]
+            {
+                if (auto res = m_handle.reorder_servers(); res.has_value())
+                    req->complete(std::monostate {});
+                else
+                    req->complete(res.error().unexpected());
+            });
+    }
+
+    m_cv.notify_one();
+    return req;
+}
+
+
+auto
+async::preload() noexcept -> result<std::shared_ptr<request<std::monostate>>>
+{
+    auto req = make_request<std::monostate>();
+
+    {
+        std::lock_guard lock { m_mutex };
+
+        m_queue.emplace_back(
+            [this, req]
+            {
+                m_handle.preload();
+                req->complete(std::monostate {});
+            });
+    }
+
+    m_cv.notify_one();
+    return req;
+}
+
+
+auto
+async::index() noexcept -> result<std::shared_ptr<request<sync_index>>>
+{
+    auto req = make_request<sync_index>();
+
+    {
+        std::lock_guard lock { m_mutex };
+
+        m_queue.emplace_back([this, req] { req->complete(m_handle.index()); });
+    }
+
+    m_cv.notify_one();
+    return req;
+}
+
+
+auto
+async::refresh(bool force) noexcept -> result<std::shared_ptr<request<sync_delta>>>
+{
+    auto req = make_request<sync_delta>();
+
+    {
+        std::lock_guard lock { m_mutex };
+
+        m_queue.emplace_back([this, req, force] { req->complete(m_handle.refresh(force)); });
+    }
+
+    m_cv.notify_one();
+    return req;
+}
+
+
+auto
+async::reload() noexcept -> result<std::shared_ptr<request<config_delta>>>
+{
+    auto req = make_request<config_delta>();
+
+    {
+        std::lock_guard lock { m_mutex };
+
+        m_queue.emplace_back([this, req] { req->complete(m_handle.reload()); });
+    }
+
+    m_cv.notify_one();
+    return req;
+}
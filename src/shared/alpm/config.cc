@@ -1,8 +1,15 @@
+#include <cstring>
+#include <fstream>
+
 #include <glob.h>
+#include <pwd.h>
 #include <sigc++/sigc++.h>
+#include <sys/stat.h>
 #include <sys/utsname.h>
 
 #include "alpm/config.hh"
+#include "mapped_file.hh"
+#include "trace.hh"
 
 using config = aurgh::alpm::config;
 
@@ -237,6 +244,8 @@ namespace
     register_repo(alpm_handle_t *handle, const aurgh::alpm::repo &repo) noexcept
         -> aurgh::result<void>
     {
+        AURGH_TRACE_SPAN("alpm", "alpm_register_syncdb", repo.name);
+
         alpm_db_t *db = alpm_register_syncdb(handle, repo.name.c_str(), repo.siglevel);
 
         if (db == nullptr)
@@ -261,6 +270,35 @@ namespace
     }
 
 
+    using list_ptr
+        = std::unique_ptr<alpm_list_t, aurgh::util::destructor<alpm_list_t, alpm_list_free>>;
+
+
+    /* libalpm copies what it keeps, the list only borrows the strings of @p values */
+    template <typename Range>
+    [[nodiscard]]
+    auto
+    borrowed_list(const Range &values) -> list_ptr
+    {
+        alpm_list_t *list = nullptr;
+
+        for (const auto &value : values)
+            list = alpm_list_add(list, const_cast<char *>(value.c_str())); /* NOLINT */
+        return list_ptr { list };
+    }
+
+
+    [[nodiscard]]
+    auto
+    find_syncdb(alpm_handle_t *handle, std::string_view name) -> alpm_db_t *
+    {
+        for (alpm_list_t *i = alpm_get_syncdbs(handle); i != nullptr; i = alpm_list_next(i))
+            if (name == alpm_db_get_name(static_cast<alpm_db_t *>(i->data)))
+                return static_cast<alpm_db_t *>(i->data);
+        return nullptr;
+    }
+
+
     auto
     get_system_arch() -> std::string
     {
@@ -268,14 +306,219 @@ namespace
         uname(&un);
         return un.machine;
     }
+
+
+    /* bumped whenever config gains, loses or reorders a cached member */
+    constexpr std::string_view cache_magic = "aurghcf1";
+
+
+    /* the cache is native-endian, it is only ever read back on the machine that wrote it */
+    struct cache_writer
+    {
+        std::string out;
+
+
+        template <typename T>
+            requires std::is_arithmetic_v<T>
+        void
+        operator()(const T &value)
+        { out.append(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+
+        void
+        operator()(std::string_view value)
+        {
+            (*this)(std::uint64_t { value.size() });
+            out.append(value);
+        }
+
+
+        void
+        operator()(const std::string &value)
+        { (*this)(std::string_view { value }); }
+
+
+        void
+        operator()(const std::filesystem::path &value)
+        { (*this)(std::string_view { value.native() }); }
+
+
+        void
+        operator()(const aurgh::alpm::repo &value)
+        {
+            (*this)(value.name);
+            (*this)(value.cache_servers);
+            (*this)(value.servers);
+            (*this)(value.usage);
+            (*this)(value.siglevel);
+            (*this)(value.siglevel_mask);
+        }
+
+
+        template <typename T>
+        void
+        operator()(const std::vector<T> &values)
+        {
+            (*this)(std::uint64_t { values.size() });
+            for (const auto &value : values) (*this)(value);
+        }
+    };
+
+
+    /* stops at the first short read, after which good stays false */
+    struct cache_reader
+    {
+        std::string_view in;
+        bool             good = true;
+
+
+        template <typename T>
+            requires std::is_arithmetic_v<T>
+        void
+        operator()(T &value)
+        {
+            if (!good or in.size() < sizeof(T))
+            {
+                good = false;
+                return;
+            }
+
+            std::memcpy(&value, in.data(), sizeof(T));
+            in.remove_prefix(sizeof(T));
+        }
+
+
+        void
+        operator()(std::string &value)
+        {
+            std::uint64_t size = 0;
+            (*this)(size);
+
+            if (!good or in.size() < size)
+            {
+                good = false;
+                return;
+            }
+
+            value.assign(in.substr(0, size));
+            in.remove_prefix(size);
+        }
+
+
+        void
+        operator()(std::filesystem::path &value)
+        {
+            std::string native;
+            (*this)(native);
+            value = std::move(native);
+        }
+
+
+        void
+        operator()(aurgh::alpm::repo &value)
+        {
+            (*this)(value.name);
+            (*this)(value.cache_servers);
+            (*this)(value.servers);
+            (*this)(value.usage);
+            (*this)(value.siglevel);
+            (*this)(value.siglevel_mask);
+        }
+
+
+        template <typename T>
+        void
+        operator()(std::vector<T> &values)
+        {
+            std::uint64_t size = 0;
+            (*this)(size);
+
+            /* every element takes at least a byte, a larger count is a corrupt file */
+            if (!good or size > in.size())
+            {
+                good = false;
+                return;
+            }
+
+            values.clear();
+            values.reserve(size);
+
+            /* a repo has no default constructor, its name is read over the empty one */
+            for (std::uint64_t i = 0; i < size and good; i++)
+            {
+                if constexpr (std::is_same_v<T, aurgh::alpm::repo>)
+                    (*this)(values.emplace_back(std::string {}));
+                else
+                    (*this)(values.emplace_back());
+            }
+        }
+    };
+}
+
+
+template <typename F, typename... Self>
+void
+config::fields(F &&field, Self &...self)
+{
+    field(self.root_dir...);
+    field(self.db_path...);
+    field(self.gpg_dir...);
+    field(self.log_file...);
+    field(self.cache_dir...);
+    field(self.hook_dir...);
+    field(self.hold_pkg...);
+    field(self.ignore_pkg...);
+    field(self.ignore_group...);
+    field(self.architecture...);
+    field(self.no_upgrade...);
+    field(self.no_extract...);
+    field(self.sandbox_user...);
+    field(self.parallel_downloads...);
+    field(self.flag...);
+    field(self.siglevel...);
+    field(self.local_siglevel...);
+    field(self.remote_siglevel...);
+    field(self.siglevel_mask...);
+    field(self.local_siglevel_mask...);
+    field(self.remote_siglevel_mask...);
+    field(self.use_syslog...);
+    field(self.check_space...);
+    field(self.disable_download_timeout...);
+    field(self.disable_sandbox...);
+    field(self.disable_sandbox_filesystem...);
+    field(self.disable_sandbox_syscalls...);
+    field(self.repos...);
 }
 
 
 auto
-config::parse(const std::filesystem::path &pacman_conf) noexcept -> result<std::unique_ptr<config>>
+config::source::stat(std::filesystem::path path) noexcept -> source
+{
+    struct stat st;
+    if (::stat(path.c_str(), &st) == -1) return source { .path = std::move(path) };
+
+    return source { .path  = std::move(path),
+                    .mtime = std::int64_t { st.st_mtim.tv_sec } * 1'000'000'000
+                           + st.st_mtim.tv_nsec,
+                    .size  = std::int64_t { st.st_size } };
+}
+
+
+auto
+config::parse(const std::filesystem::path &pacman_conf, const std::filesystem::path &cache) noexcept
+    -> result<std::unique_ptr<config>>
 try
 {
+    AURGH_TRACE_SPAN("alpm", "config::parse", pacman_conf.native());
+
+    if (!cache.empty())
+    {
+        AURGH_TRACE_SPAN("alpm", "config::load_cache");
+        if (auto res = load_cache(cache, pacman_conf); res.has_value()) return res;
+    }
+
     auto cfg = std::make_unique<config>();
+    cfg->m_sources.emplace_back(source::stat(pacman_conf));
 
     if (auto res
         = ini::parse(pacman_conf, [&](ini::callback_data data) { return cfg->mf_parse_cb(data); });
@@ -284,6 +527,9 @@ try
 
     if (auto res = cfg->mf_set_defaults(); !res) return res.error().unexpected();
 
+    /* a cache that cannot be written only costs the next start a parse */
+    if (!cache.empty()) std::ignore = cfg->mf_save_cache(cache, pacman_conf);
+
     return cfg;
 }
 catch (const std::exception &e)
@@ -333,12 +579,20 @@ try
                        res.error().message() }
             .unexpected();
 
+    /* a file added to a globbed directory changes the directory's mtime */
+    if (data.value.find_first_of("*?[") != std::string_view::npos)
+        m_sources.emplace_back(source::stat(std::filesystem::path { data.value }.parent_path()));
+
     for (auto &path : paths)
+    {
+        m_sources.emplace_back(source::stat(path));
+
         if (auto res = ini::parse(
                 path, [&](ini::callback_data data) { return mf_parse_cb(data, depth + 1); },
-                std::string { data.section });
+                data.section);
             !res)
             return res.error().unexpected();
+    }
 
     return {};
 }
@@ -549,9 +803,121 @@ config::mf_set_defaults() noexcept -> result<void>
 }
 
 
+auto
+config::load_cache(const std::filesystem::path &cache,
+                   const std::filesystem::path &pacman_conf) noexcept
+    -> result<std::unique_ptr<config>>
+try
+{
+    auto file = mapped_file::open(cache);
+    if (!file) return file.error().unexpected();
+
+    cache_reader read { .in = file->view() };
+    if (!read.in.starts_with(cache_magic))
+        return error { "\"{}\" is not a configuration cache", cache.c_str() }.unexpected();
+    read.in.remove_prefix(cache_magic.size());
+
+    std::filesystem::path conf;
+    std::uint64_t         count = 0;
+    read(conf);
+    read(count);
+
+    if (!read.good or conf != pacman_conf)
+        return error { "configuration cache \"{}\" belongs to another file", cache.c_str() }
+            .unexpected();
+
+    auto cfg = std::make_unique<config>();
+
+    for (std::uint64_t i = 0; i < count and read.good; i++)
+    {
+        source recorded;
+        read(recorded.path);
+        read(recorded.mtime);
+        read(recorded.size);
+
+        if (read.good and source::stat(recorded.path) != recorded)
+            return error { "configuration cache \"{}\" is older than \"{}\"", cache.c_str(),
+                           recorded.path.c_str() }
+                .unexpected();
+
+        cfg->m_sources.emplace_back(std::move(recorded));
+    }
+
+    fields(read, *cfg);
+
+    if (!read.good or !read.in.empty())
+        return error { "configuration cache \"{}\" is corrupt", cache.c_str() }.unexpected();
+    return cfg;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to load configuration cache \"{}\": {}", cache.c_str(), e.what() }
+        .unexpected();
+}
+
+
+auto
+config::mf_save_cache(const std::filesystem::path &cache,
+                      const std::filesystem::path &pacman_conf) const noexcept -> result<void>
+try
+{
+    cache_writer write;
+    write.out.append(cache_magic);
+    write(pacman_conf);
+    write(std::uint64_t { m_sources.size() });
+
+    for (const auto &recorded : m_sources)
+    {
+        write(recorded.path);
+        write(recorded.mtime);
+        write(recorded.size);
+    }
+
+    fields(write, *this);
+
+    std::filesystem::path tmp = cache;
+    tmp += ".tmp";
+
+    std::filesystem::create_directories(cache.parent_path());
+
+    {
+        std::ofstream stream { tmp, std::ios::binary | std::ios::trunc };
+        if (!stream.write(write.out.data(), std::streamsize(write.out.size())).flush())
+            return error { "failed to write configuration cache \"{}\"", tmp.c_str() }
+                .unexpected();
+    }
+
+    std::filesystem::rename(tmp, cache);
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to save configuration cache \"{}\": {}", cache.c_str(), e.what() }
+        .unexpected();
+}
+
+
+void
+config::fetch_with(std::shared_ptr<http::client> http, std::shared_ptr<mirror_scores> mirrors)
+{
+    m_fetcher = std::make_unique<fetcher>(std::move(http), *this);
+    m_mirrors = std::move(mirrors);
+}
+
+
+void
+config::rank_servers()
+{
+    if (m_mirrors == nullptr) return;
+    for (auto &repo : repos) m_mirrors->rank(repo.servers);
+}
+
+
 auto
 config::build() noexcept -> result<alpm_handle_t *>
 {
+    AURGH_TRACE_SPAN("alpm", "config::build");
+
     alpm_errno_t   err;
     alpm_handle_t *handle;
 
@@ -568,7 +934,122 @@ config::build() noexcept -> result<alpm_handle_t *>
     alpm_option_set_eventcb(handle, config::event_callback, this);
     alpm_option_set_questioncb(handle, config::question_callback, this);
     alpm_option_set_progresscb(handle, config::progress_callback, this);
+    if (m_fetcher != nullptr) alpm_option_set_fetchcb(handle, fetcher::callback, m_fetcher.get());
+
+    if (auto res = mf_apply_options(handle); !res) return res.error().unexpected();
+
+    rank_servers();
+
+    for (const auto &repo : repos)
+        if (auto res = register_repo(handle, repo); !res) return res.error().unexpected();
+
+    return handle;
+}
+
+
+auto
+config::apply(alpm_handle_t *handle, config &&next) noexcept -> result<std::vector<std::string>>
+try
+{
+    auto get_error = [&] { return alpm_strerror(alpm_errno(handle)); };
+
+    if (next.root_dir != root_dir or next.db_path != db_path)
+        return error { "RootDir and DBPath only change on a restart" }.unexpected();
+
+    /* nothing below is undone on failure, so whatever can be checked up front is, and the
+       options go first while the databases are all still registered */
+    if (auto res = next.mf_validate(); !res) return res.error().unexpected();
+    if (auto res = next.mf_apply_options(handle); !res) return res.error().unexpected();
+
+    /* libalpm looks through databases in the order they were registered, so from the first
+       one that differs on everything is registered again in the new order */
+    std::size_t kept = 0;
+    while (kept < repos.size() and kept < next.repos.size()
+           and repos[kept].name == next.repos[kept].name
+           and repos[kept].siglevel == next.repos[kept].siglevel)
+        kept++;
+
+    std::vector<std::string> changed;
+
+    for (const auto &repo : repos | std::views::drop(kept))
+    {
+        if (alpm_db_t *db = find_syncdb(handle, repo.name);
+            db != nullptr and alpm_db_unregister(db) != 0)
+            return error { "failed to unregister database \"{}\": {}", repo.name, get_error() }
+                .unexpected();
+        changed.emplace_back(repo.name);
+    }
+
+    fields([](auto &to, auto &from) { to = std::move(from); }, *this, next);
+    m_sources = std::move(next.m_sources);
+
+    rank_servers();
+
+    for (const auto &repo : repos | std::views::take(kept))
+    {
+        alpm_db_t *db = find_syncdb(handle, repo.name);
+        if (db == nullptr) continue;
+
+        alpm_db_set_usage(db, repo.usage);
+
+        if (alpm_db_set_servers(db, borrowed_list(repo.servers).get()) != 0
+            or alpm_db_set_cache_servers(db, borrowed_list(repo.cache_servers).get()) != 0)
+            return error { "failed to replace the servers of database \"{}\": {}", repo.name,
+                           get_error() }
+                .unexpected();
+    }
+
+    for (const auto &repo : repos | std::views::drop(kept))
+    {
+        if (auto res = register_repo(handle, repo); !res) return res.error().unexpected();
+        if (!std::ranges::contains(changed, repo.name)) changed.emplace_back(repo.name);
+    }
 
+    return changed;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to apply the reloaded configuration: {}", e.what() }.unexpected();
+}
+
+
+auto
+config::sources() const -> std::vector<std::filesystem::path>
+{
+    return m_sources | std::views::transform(&source::path)
+         | std::ranges::to<std::vector<std::filesystem::path>>();
+}
+
+
+/* what libalpm would refuse halfway through apply */
+auto
+config::mf_validate() const noexcept -> result<void>
+try
+{
+    if (!sandbox_user.empty() and getpwnam(sandbox_user.c_str()) == nullptr)
+        return error { "DownloadUser \"{}\" doesn't exist", sandbox_user }.unexpected();
+
+    for (auto it = repos.begin(); it != repos.end(); it++)
+    {
+        if (it->name.empty() or it->name == "local" or it->name.contains('/'))
+            return error { "\"{}\" is not a valid repository name", it->name }.unexpected();
+
+        if (std::ranges::contains(repos.begin(), it, it->name, &repo::name))
+            return error { "repository \"{}\" is listed twice", it->name }.unexpected();
+    }
+
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to validate the configuration: {}", e.what() }.unexpected();
+}
+
+
+/* every list is replaced whole, so a fresh handle and a reloaded one end up the same */
+auto
+config::mf_apply_options(alpm_handle_t *handle) noexcept -> result<void>
+{
     auto get_error = [&] { return alpm_strerror(alpm_errno(handle)); };
 
     if (alpm_option_set_logfile(handle, log_file.c_str()) != 0)
@@ -579,27 +1060,23 @@ config::build() noexcept -> result<alpm_handle_t *>
         return error { "failed to set GnuPG dir to \"{}\": {}", gpg_dir.c_str(), get_error() }
             .unexpected();
 
+    /* libalpm starts out with its system hook dir, which replacing the list would drop */
+    std::vector<std::filesystem::path> hooks { std::filesystem::path { default_hook_dir } };
     for (const auto &dir : hook_dir)
-        if (alpm_option_add_hookdir(handle, dir.c_str()) != 0)
-            return error { "failed to add hook dir \"{}\": {}", dir.c_str(), get_error() }
-                .unexpected();
+        if (!std::ranges::contains(hooks, dir)) hooks.emplace_back(dir);
 
-    for (const auto &dir : cache_dir)
-        if (alpm_option_add_cachedir(handle, dir.c_str()) != 0)
-            return error { "failed to add cache dir \"{}\": {}", dir.c_str(), get_error() }
-                .unexpected();
+    if (alpm_option_set_hookdirs(handle, borrowed_list(hooks).get()) != 0)
+        return error { "failed to set hook dirs: {}", get_error() }.unexpected();
+
+    if (alpm_option_set_cachedirs(handle, borrowed_list(cache_dir).get()) != 0)
+        return error { "failed to set cache dirs: {}", get_error() }.unexpected();
 
     alpm_option_set_default_siglevel(handle, siglevel);
     alpm_option_set_local_file_siglevel(handle, local_siglevel);
     alpm_option_set_remote_file_siglevel(handle, remote_siglevel);
 
-    for (const auto &repo : repos)
-        if (auto res = register_repo(handle, repo); !res) return res.error().unexpected();
-
-    for (const auto &arch : architecture)
-        if (alpm_option_add_architecture(handle, arch.c_str()) != 0)
-            return error { "failed to add architecture \"{}\": {}", arch, get_error() }
-                .unexpected();
+    if (alpm_option_set_architectures(handle, borrowed_list(architecture).get()) != 0)
+        return error { "failed to set architectures: {}", get_error() }.unexpected();
 
     alpm_option_set_checkspace(handle, check_space);
     alpm_option_set_usesyslog(handle, use_syslog);
@@ -611,15 +1088,15 @@ config::build() noexcept -> result<alpm_handle_t *>
     alpm_option_set_disable_sandbox_filesystem(handle, disable_sandbox_filesystem);
     alpm_option_set_disable_sandbox_syscalls(handle, disable_sandbox_syscalls);
 
-    for (const auto &pkg : ignore_pkg) alpm_option_add_ignorepkg(handle, pkg.c_str());
-    for (const auto &group : ignore_group) alpm_option_add_ignoregroup(handle, group.c_str());
-    for (const auto &pkg : no_upgrade) alpm_option_add_noupgrade(handle, pkg.c_str());
-    for (const auto &pkg : no_extract) alpm_option_add_noextract(handle, pkg.c_str());
+    alpm_option_set_ignorepkgs(handle, borrowed_list(ignore_pkg).get());
+    alpm_option_set_ignoregroups(handle, borrowed_list(ignore_group).get());
+    alpm_option_set_noupgrades(handle, borrowed_list(no_upgrade).get());
+    alpm_option_set_noextracts(handle, borrowed_list(no_extract).get());
 
     alpm_option_set_disable_dl_timeout(handle, disable_download_timeout);
     alpm_option_set_parallel_downloads(handle, parallel_downloads);
 
-    return handle;
+    return {};
 }
 
 
@@ -653,16 +1130,32 @@ config::download_callback(void                      *ctx,
     switch (event)
     {
     case ALPM_DOWNLOAD_INIT:
+        if (auto res = progress::acquire(
+                [cfg, name = std::string { filename }](double value)
+                { cfg->signal_on_download_progress.emit(name, value); });
+            res.has_value())
+            cfg->m_download_slots.insert_or_assign(filename, std::move(res.value()));
+
         cfg->signal_on_download.emit(filename, static_cast<alpm_download_event_init_t *>(data));
         break;
     case ALPM_DOWNLOAD_PROGRESS:
-        cfg->signal_on_download.emit(filename,
-                                     static_cast<_alpm_download_event_progress_t *>(data));
+    {
+        auto *stats = static_cast<_alpm_download_event_progress_t *>(data);
+
+        if (auto it = cfg->m_download_slots.find(filename);
+            it != cfg->m_download_slots.end() && stats->total > 0)
+            it->second.store(double(stats->downloaded) / double(stats->total));
+
+        cfg->signal_on_download.emit(filename, stats);
         break;
+    }
     case ALPM_DOWNLOAD_RETRY:
         cfg->signal_on_download.emit(filename, static_cast<alpm_download_event_retry_t *>(data));
         break;
     case ALPM_DOWNLOAD_COMPLETED:
+        if (auto it = cfg->m_download_slots.find(filename); it != cfg->m_download_slots.end())
+            cfg->m_download_slots.erase(it);
+
         cfg->signal_on_download.emit(filename,
                                      static_cast<alpm_download_event_completed_t *>(data));
         break;
@@ -688,6 +1181,23 @@ config::progress_callback(void           *ctx,
                           std::size_t     total_amount,
                           std::size_t     current_amount)
 {
-    static_cast<config *>(ctx)->signal_on_progress.emit(progress, pkg, percent, total_amount,
-                                                        current_amount);
+    auto *cfg = static_cast<config *>(ctx);
+
+    std::string key = std::format("{}:{}", int(progress), pkg != nullptr ? pkg : "");
+    auto        it  = cfg->m_package_slots.find(key);
+
+    if (it == cfg->m_package_slots.end() and percent < 100)
+        if (auto res = progress::acquire(
+                [cfg, progress, name = std::string { pkg != nullptr ? pkg : "" }](double value)
+                { cfg->signal_on_package_progress.emit(progress, name, value); });
+            res.has_value())
+            it = cfg->m_package_slots.emplace(key, std::move(res.value())).first;
+
+    if (it != cfg->m_package_slots.end())
+    {
+        it->second.store(percent / 100.0);
+        if (percent >= 100) cfg->m_package_slots.erase(it);
+    }
+
+    cfg->signal_on_progress.emit(progress, pkg, percent, total_amount, current_amount);
 }
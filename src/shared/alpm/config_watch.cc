@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <ranges>
+
+#include <glibmm/main.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "alpm/config_watch.hh"
+
+using aurgh::alpm::config_watch;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE
+                                       | IN_DELETE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+}
+
+
+auto
+config_watch::create(std::function<void()> changed) noexcept
+    -> result<std::unique_ptr<config_watch>>
+try
+{
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1) return error { "inotify_init1: {}", std::strerror(errno) }.unexpected();
+
+    std::unique_ptr<config_watch> watch { new config_watch { fd, std::move(changed) } };
+
+    watch->m_io = Glib::signal_io().connect(
+        [self = watch.get()](Glib::IOCondition condition) { return self->mf_on_io(condition); },
+        fd, Glib::IOCondition::IO_IN);
+
+    return watch;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to watch the configuration: {}", e.what() }.unexpected();
+}
+
+
+config_watch::config_watch(int fd, std::function<void()> changed)
+    : m_fd { fd }, m_changed { std::move(changed) }
+{
+}
+
+
+config_watch::~config_watch()
+{
+    m_io.disconnect();
+    m_settle.disconnect();
+    close(m_fd);
+}
+
+
+auto
+config_watch::watch(const std::vector<fs::path> &paths) noexcept -> result<void>
+try
+{
+    for (const auto &[wd, _] : m_dirs) inotify_rm_watch(m_fd, wd);
+    m_dirs.clear();
+    m_paths.clear();
+
+    for (const auto &path : paths)
+    {
+        std::error_code ec;
+        fs::path        dir = fs::is_directory(path, ec) ? path : path.parent_path();
+
+        m_paths.emplace(path);
+        if (std::ranges::contains(m_dirs | std::views::values, dir)) continue;
+
+        int wd = inotify_add_watch(m_fd, dir.c_str(), watch_mask);
+        if (wd == -1)
+            return error { "failed to watch \"{}\": {}", dir.c_str(), std::strerror(errno) }
+                .unexpected();
+
+        m_dirs.insert_or_assign(wd, std::move(dir));
+    }
+
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to watch the configuration: {}", e.what() }.unexpected();
+}
+
+
+auto
+config_watch::mf_on_io(Glib::IOCondition /* condition */) -> bool
+{
+    alignas(inotify_event) std::array<char, 4096> buffer;
+    bool                                          relevant = false;
+
+    for (;;)
+    {
+        ssize_t n = read(m_fd, buffer.data(), buffer.size());
+        if (n == -1 and errno == EINTR) continue;
+        if (n <= 0) break;
+
+        for (ssize_t offset = 0; offset < n;)
+        {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+            offset += ssize_t(sizeof(inotify_event) + event->len);
+
+            auto it = m_dirs.find(event->wd);
+            if (it == m_dirs.end()) continue;
+
+            /* a watched directory counts as a whole, a file only by its own name */
+            fs::path path = event->len > 0 ? it->second / event->name : it->second;
+            if (m_paths.contains(path) or m_paths.contains(it->second)) relevant = true;
+        }
+    }
+
+    if (relevant)
+    {
+        m_settle.disconnect();
+        m_settle = Glib::signal_timeout().connect(
+            [this]
+            {
+                m_changed();
+                return false;
+            },
+            settle_time.count());
+    }
+
+    return true;
+}
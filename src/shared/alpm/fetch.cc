@@ -0,0 +1,519 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <future>
+#include <ranges>
+
+#include <fcntl.h>
+#include <glibmm/main.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include "alpm/config.hh"
+#include "alpm/fetch.hh"
+#include "http/segmented.hh"
+#include "progress.hh"
+
+using aurgh::alpm::fetcher;
+namespace fs = std::filesystem;
+
+namespace
+{
+    constexpr std::string_view part_suffix = ".part";
+
+    /* "<server>\n<etag>", an ETag only means something to the mirror that sent it */
+    constexpr const char *etag_attribute = "user.aurgh.etag";
+
+
+    [[nodiscard]]
+    auto
+    write_all(int fd, std::string_view data) -> bool
+    {
+        while (!data.empty())
+        {
+            ssize_t n = ::write(fd, data.data(), data.size());
+            if (n == -1 and errno == EINTR) continue;
+            if (n <= 0) return false;
+
+            data.remove_prefix(std::size_t(n));
+        }
+
+        return true;
+    }
+
+
+    /* the stored ETag of @p path if @p server is the one that sent it */
+    [[nodiscard]]
+    auto
+    stored_etag(const fs::path &path, std::string_view server) -> std::optional<std::string>
+    {
+        std::array<char, 1024> buffer {};
+
+        ssize_t n = getxattr(path.c_str(), etag_attribute, buffer.data(), buffer.size());
+        if (n <= 0) return std::nullopt;
+
+        std::string_view value { buffer.data(), std::size_t(n) };
+        std::size_t      newline = value.find('\n');
+
+        if (newline == std::string_view::npos or value.substr(0, newline) != server)
+            return std::nullopt;
+        return std::string { value.substr(newline + 1) };
+    }
+
+
+    [[nodiscard]]
+    auto
+    http_date(fs::file_time_type time) -> std::string
+    {
+        auto utc = std::chrono::floor<std::chrono::seconds>(
+            std::chrono::clock_cast<std::chrono::system_clock>(time));
+        return std::format("{:%a, %d %b %Y %H:%M:%S} GMT", utc);
+    }
+
+
+    /* runs @p start on the main loop and blocks until it reports through its argument */
+    template <typename Start>
+    [[nodiscard]]
+    auto
+    run_on_main_loop(Start &&start) -> bool
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto future  = promise->get_future();
+
+        Glib::MainContext::get_default()->invoke(
+            [promise, start = std::forward<Start>(start)] mutable
+            {
+                start([promise](bool ok) { promise->set_value(ok); });
+                return false;
+            });
+
+        return future.get();
+    }
+}
+
+
+struct fetcher::race
+{
+    static constexpr std::size_t none = -1;
+
+    target   tgt;
+    fs::path dest;
+    fs::path part;
+
+    int        fd       = -1;
+    curl_off_t offset   = 0; /* bytes already in the .part file */
+    curl_off_t received = 0;
+
+    /* set when there is a file to keep unless the mirror has a newer one */
+    bool                              conditional = false;
+    bool                              unchanged   = false;
+    std::optional<fs::file_time_type> mtime;
+    std::optional<std::string>        etag;          /* of the winning response */
+    time_t                            modified = -1; /* and its Last-Modified */
+
+    std::vector<std::shared_ptr<http::transfer>> candidates;
+    std::vector<std::string>                     servers; /* the mirror of each candidate */
+
+    std::size_t winner  = none;
+    std::size_t failed  = 0;
+    bool        settled = false;
+
+    /* a big file moves on from the race winner to chunks over several mirrors */
+    bool                             segmenting = false;
+    std::shared_ptr<http::segmented> split;
+
+    progress::slot            progress;
+    std::function<void(bool)> done;
+};
+
+
+fetcher::fetcher(std::shared_ptr<http::client> http, config &cfg)
+    : m_http { std::move(http) }, m_config { cfg }
+{
+}
+
+
+auto
+fetcher::fetch(std::string_view url, const fs::path &dir, bool force) -> result<fetched>
+try
+{
+    if (Glib::MainContext::get_default()->is_owner())
+        return error { "cannot fetch \"{}\" from the main loop it would wait on", url }
+            .unexpected();
+
+    auto r  = std::make_shared<race>();
+    r->tgt  = mf_resolve(url);
+    r->dest = dir / r->tgt.filename;
+    r->part = dir / (r->tgt.filename + std::string { part_suffix });
+
+    /* a conditional request cannot resume, the leftover may belong to an older file */
+    std::error_code ec;
+    if (auto time = fs::last_write_time(r->dest, ec); !force and !ec)
+    {
+        r->conditional = true;
+        r->mtime       = time;
+    }
+
+    if (force or r->conditional) fs::remove(r->part);
+
+    bool ok = run_on_main_loop(
+        [this, r](std::function<void(bool)> done)
+        {
+            r->done = std::move(done);
+            mf_start(r);
+        });
+
+    if (!ok) return error { "failed to download \"{}\"", url }.unexpected();
+    return r->unchanged ? fetched::unchanged : fetched::downloaded;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to download \"{}\": {}", url, e.what() }.unexpected();
+}
+
+
+void
+fetcher::prefetch(const std::vector<std::pair<std::string, std::string>> &files,
+                  const fs::path                                         &dir,
+                  std::size_t                                             parallel)
+{
+    if (Glib::MainContext::get_default()->is_owner()) return;
+
+    struct batch
+    {
+        std::deque<std::shared_ptr<race>> pending;
+        std::size_t                       running = 0;
+        std::size_t                       width   = 1;
+        std::function<void(bool)>         done;
+    };
+
+    auto b   = std::make_shared<batch>();
+    b->width = std::max<std::size_t>(parallel, 1);
+
+    for (const auto &[repo, filename] : files)
+    {
+        std::error_code ec;
+        if (fs::exists(dir / filename, ec)) continue;
+
+        auto it = std::ranges::find(m_config.repos, repo, &alpm::repo::name);
+        if (it == m_config.repos.end() or it->servers.empty()) continue;
+
+        auto r  = std::make_shared<race>();
+        r->tgt  = target { .repo = repo, .filename = filename, .servers = it->servers };
+        r->dest = dir / filename;
+        r->part = dir / (filename + std::string { part_suffix });
+        b->pending.emplace_back(std::move(r));
+    }
+
+    if (b->pending.empty()) return;
+
+    std::ignore = run_on_main_loop(
+        [this, b](std::function<void(bool)> done)
+        {
+            b->done = std::move(done);
+
+            /* a finished race frees its place for the next pending one */
+            auto next = std::make_shared<std::function<void()>>();
+            *next     = [this, b, weak = std::weak_ptr { next }]
+            {
+                while (b->running < b->width and !b->pending.empty())
+                {
+                    auto r = std::move(b->pending.front());
+                    b->pending.pop_front();
+                    b->running++;
+
+                    r->done = [b, next = weak.lock()](bool)
+                    {
+                        b->running--;
+                        (*next)();
+                    };
+                    mf_start(r);
+                }
+
+                if (b->running == 0 and b->pending.empty() and b->done)
+                    std::exchange(b->done, nullptr)(true);
+            };
+
+            (*next)();
+        });
+}
+
+
+auto
+fetcher::callback(void *ctx, const char *url, const char *localpath, int force) -> int
+{
+    auto *self = static_cast<fetcher *>(ctx);
+
+    auto res = self->fetch(url, localpath, force != 0);
+    if (!res) return -1;
+    return res.value() == fetched::unchanged ? 1 : 0;
+}
+
+
+auto
+fetcher::mf_resolve(std::string_view url) const -> target
+{
+    for (const auto &repo : m_config.repos)
+        for (std::size_t i = 0; i < repo.servers.size(); i++)
+        {
+            std::string_view server = repo.servers[i];
+            if (!url.starts_with(server) or url.size() <= server.size()
+                or url[server.size()] != '/')
+                continue;
+
+            /* libalpm walks the list itself, start from the mirror it is on */
+            std::vector<std::string> servers;
+            servers.reserve(repo.servers.size());
+
+            for (std::size_t j = 0; j < repo.servers.size(); j++)
+                servers.emplace_back(repo.servers[(i + j) % repo.servers.size()]);
+
+            return target { .repo     = repo.name,
+                            .filename = std::string { url.substr(server.size() + 1) },
+                            .servers  = std::move(servers) };
+        }
+
+    std::size_t slash = url.rfind('/');
+    return target { .repo     = std::string { url },
+                    .filename = std::string { url.substr(slash + 1) },
+                    .servers  = { std::string { url.substr(0, slash) } } };
+}
+
+
+void
+fetcher::mf_start(const std::shared_ptr<race> &r)
+{
+    r->fd = ::open(r->part.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (r->fd == -1) return mf_finish(r, false);
+
+    r->offset = lseek(r->fd, 0, SEEK_END);
+    if (r->offset == -1) return mf_finish(r, false);
+
+    std::vector<std::string> headers;
+    if (r->offset > 0) headers.emplace_back(std::format("Range: bytes={}-", r->offset));
+    if (r->mtime.has_value())
+        headers.emplace_back(std::format("If-Modified-Since: {}", http_date(*r->mtime)));
+
+    std::vector<std::string> servers;
+
+    if (auto it = m_preferred.find(r->tgt.repo);
+        it != m_preferred.end() and std::ranges::contains(r->tgt.servers, it->second))
+        servers.emplace_back(it->second);
+    else
+        for (const auto &server : r->tgt.servers | std::views::take(race_width))
+            servers.emplace_back(server);
+
+    for (auto &server : servers)
+    {
+        auto request = headers;
+
+        if (auto etag = r->conditional ? stored_etag(r->dest, server) : std::nullopt; etag)
+            request.emplace_back(std::format("If-None-Match: {}", *etag));
+
+        auto res = m_http->get(std::format("{}/{}", server, r->tgt.filename), request);
+        if (!res) continue;
+
+        std::size_t i = r->candidates.size();
+        r->candidates.emplace_back(res.value());
+        r->servers.emplace_back(std::move(server));
+
+        res.value()
+            ->on_data(
+                [this, r, i](std::string_view data)
+                {
+                    if (r->settled) return;
+                    if (r->winner == race::none) mf_claim(r, i);
+                    if (r->winner != i or r->segmenting) return;
+
+                    if (!write_all(r->fd, data)) return mf_finish(r, false);
+
+                    r->received += curl_off_t(data.size());
+                    if (curl_off_t length = r->candidates[i]->content_length(); length > 0)
+                        r->progress.store(double(r->offset + r->received)
+                                          / double(r->offset + length));
+                })
+            .on_complete(
+                [this, r, i](http::completion done)
+                {
+                    if (r->settled or r->segmenting) return;
+
+                    /* any mirror with nothing newer settles it, there is no body to race */
+                    if (done.return_code == 304 and r->conditional and r->winner == race::none)
+                    {
+                        r->unchanged = true;
+                        return mf_finish(r, true);
+                    }
+
+                    bool good = done.return_code == 200 or done.return_code == 206;
+
+                    /* an empty body never claimed the race through on_data */
+                    if (r->winner == race::none and good) mf_claim(r, i);
+                    if (r->winner == i) return mf_finish(r, good);
+
+                    /* the .part file is whole already or no longer matches, start over */
+                    if (done.return_code == 416) std::ignore = ftruncate(r->fd, 0);
+
+                    if (r->winner == race::none and ++r->failed == r->candidates.size())
+                        mf_finish(r, false);
+                })
+            .on_error(
+                [this, r, i](std::string_view)
+                {
+                    if (auto *mirrors = m_config.mirrors(); mirrors != nullptr)
+                        mirrors->record_failure(r->servers[i]);
+
+                    if (r->settled or r->segmenting) return;
+                    if (r->winner == i) return mf_finish(r, false);
+
+                    if (r->winner == race::none and ++r->failed == r->candidates.size())
+                        mf_finish(r, false);
+                });
+    }
+
+    if (r->candidates.empty()) mf_finish(r, false);
+}
+
+
+/* only a successful status claims the race; an error page is not a winner */
+void
+fetcher::mf_claim(const std::shared_ptr<race> &r, std::size_t i)
+{
+    int code = r->candidates[i]->response_code();
+    if (code != 200 and code != 206) return;
+
+    r->winner = i;
+    m_preferred.insert_or_assign(r->tgt.repo, r->servers[i]);
+
+    r->etag = r->candidates[i]->header("ETag");
+    if (auto modified = r->candidates[i]->header("Last-Modified"); modified.has_value())
+        r->modified = curl_getdate(modified->c_str(), nullptr);
+
+    /* the server ignored the Range header and sends the whole file */
+    if (code == 200 and r->offset > 0)
+    {
+        std::ignore = ftruncate(r->fd, 0);
+        lseek(r->fd, 0, SEEK_SET);
+        r->offset = 0;
+    }
+
+    if (auto res = progress::acquire(
+            [this, name = r->tgt.filename](double value)
+            { m_config.signal_on_download_progress.emit(name, value); });
+        res.has_value())
+        r->progress = std::move(res.value());
+
+    if (curl_off_t length = r->candidates[i]->content_length();
+        code == 200 and length >= http::segmented::threshold)
+        return mf_segment(r, length);
+
+    /* libcurl refuses to remove handles from inside its own callbacks */
+    Glib::signal_idle().connect_once(
+        [r]
+        {
+            for (std::size_t j = 0; j < r->candidates.size(); j++)
+                if (j != r->winner) std::ignore = r->candidates[j]->cancel();
+        });
+}
+
+
+void
+fetcher::mf_finish(const std::shared_ptr<race> &r, bool ok)
+{
+    if (r->settled) return;
+    r->settled = true;
+
+    /* a split download leaves holes, only its unbroken start is worth resuming */
+    if (!ok and r->split != nullptr and r->fd != -1)
+        std::ignore = ftruncate(r->fd, r->split->contiguous());
+
+    /* what the next conditional request for this file compares against */
+    if (ok and !r->unchanged and r->fd != -1)
+    {
+        if (r->etag.has_value())
+        {
+            std::string value = std::format("{}\n{}", r->servers[r->winner], *r->etag);
+            std::ignore = fsetxattr(r->fd, etag_attribute, value.data(), value.size(), 0);
+        }
+        else
+            std::ignore = fremovexattr(r->fd, etag_attribute);
+
+        if (r->modified != -1)
+        {
+            std::array<timespec, 2> times { timespec { .tv_sec = 0, .tv_nsec = UTIME_OMIT },
+                                            timespec { .tv_sec = r->modified, .tv_nsec = 0 } };
+            std::ignore = futimens(r->fd, times.data());
+        }
+    }
+
+    if (r->fd != -1) close(r->fd);
+    r->fd = -1;
+
+    std::error_code ec;
+    if (ok and r->unchanged)
+        fs::remove(r->part, ec);
+    else if (ok)
+    {
+        fs::rename(r->part, r->dest, ec);
+        ok = !ec;
+    }
+
+    /* a mirror that failed mid-file is not kept as the preferred one */
+    if (!ok and r->winner != race::none) m_preferred.erase(r->tgt.repo);
+
+    /* every real download refines the score its mirror is ranked by */
+    if (auto *mirrors = m_config.mirrors();
+        mirrors != nullptr and r->winner != race::none and !r->segmenting)
+    {
+        if (ok)
+            mirrors->record(r->servers[r->winner], r->candidates[r->winner]->measured());
+        else
+            mirrors->record_failure(r->servers[r->winner]);
+    }
+
+    r->progress.release();
+    if (r->done) std::exchange(r->done, nullptr)(ok);
+
+    /* the transfers are still emitting, they and their closures go once that is over */
+    Glib::signal_idle().connect_once(
+        [r]
+        {
+            for (auto &t : r->candidates) std::ignore = t->cancel();
+            r->candidates.clear();
+
+            if (r->split != nullptr) r->split->cancel();
+            r->split.reset();
+        });
+}
+
+
+/* the winner only told how big the file is; the chunks start over from its first byte */
+void
+fetcher::mf_segment(const std::shared_ptr<race> &r, curl_off_t size)
+{
+    r->segmenting = true;
+
+    std::vector<std::string> urls { std::format("{}/{}", r->servers[r->winner], r->tgt.filename) };
+    for (const auto &server : r->tgt.servers)
+        if (server != r->servers[r->winner])
+            urls.emplace_back(std::format("{}/{}", server, r->tgt.filename));
+
+    /* libcurl refuses to add or remove handles from inside its own callbacks */
+    Glib::signal_idle().connect_once(
+        [this, r, size, urls = std::move(urls)] mutable
+        {
+            for (auto &t : r->candidates) std::ignore = t->cancel();
+            if (r->settled) return;
+
+            auto res = http::segmented::start(m_http, std::move(urls), r->fd, size);
+            if (!res) return mf_finish(r, false);
+
+            r->split = std::move(res.value());
+            r->split->on_progress([r](double value) { r->progress.store(value); })
+                .on_complete([this, r] { mf_finish(r, true); })
+                .on_error([this, r](std::string_view) { mf_finish(r, false); });
+        });
+}
@@ -1,20 +1,91 @@
+#include <algorithm>
+#include <format>
+#include <map>
+#include <optional>
+
 #include <sigc++/sigc++.h>
+#include <unistd.h>
 
 #include "alpm/handle.hh"
+#include "trace.hh"
 
 using aurgh::alpm::handle;
 namespace fs = std::filesystem;
 
+namespace
+{
+    /* frees what alpm_trans_prepare or alpm_trans_commit left in @p data,
+       the element type depends on @p err */
+    [[nodiscard]]
+    auto
+    describe_trans_data(alpm_errno_t err, alpm_list_t *data) -> std::string
+    {
+        std::string out;
+
+        for (alpm_list_t *i = data; i != nullptr; i = alpm_list_next(i))
+            switch (err)
+            {
+            case ALPM_ERR_UNSATISFIED_DEPS:
+            {
+                auto *miss = static_cast<alpm_depmissing_t *>(i->data);
+                char *dep  = alpm_dep_compute_string(miss->depend);
+
+                out += std::format("\n  {} requires {}", miss->target, dep != nullptr ? dep : "?");
+                free(dep);
+                alpm_depmissing_free(miss);
+                break;
+            }
+            case ALPM_ERR_CONFLICTING_DEPS:
+            {
+                auto *conflict = static_cast<alpm_conflict_t *>(i->data);
+
+                out += std::format("\n  {} conflicts with {}",
+                                   alpm_pkg_get_name(conflict->package1),
+                                   alpm_pkg_get_name(conflict->package2));
+                alpm_conflict_free(conflict);
+                break;
+            }
+            case ALPM_ERR_FILE_CONFLICTS:
+            {
+                auto *conflict = static_cast<alpm_fileconflict_t *>(i->data);
+
+                out += std::format("\n  {} exists in {}", conflict->file, conflict->target);
+                alpm_fileconflict_free(conflict);
+                break;
+            }
+            case ALPM_ERR_PKG_INVALID:
+            case ALPM_ERR_PKG_INVALID_CHECKSUM:
+            case ALPM_ERR_PKG_INVALID_SIG:
+            case ALPM_ERR_PKG_INVALID_ARCH:
+                out += std::format("\n  {}", static_cast<const char *>(i->data));
+                free(i->data);
+                break;
+            default: break; /* nothing else fills the list */
+            }
+
+        alpm_list_free(data);
+        return out;
+    }
+}
+
 
 auto
-handle::create(const std::filesystem::path &config) noexcept -> result<handle>
+handle::create(const std::filesystem::path   &config,
+               std::shared_ptr<http::client>  http,
+               std::shared_ptr<mirror_scores> mirrors,
+               const std::filesystem::path   &config_cache) noexcept -> result<handle>
 try
 {
+    AURGH_TRACE_SPAN("alpm", "handle::create", config.native());
+
     handle h;
 
-    if (auto res = config::parse(config); res.has_value())
+    if (auto res = config::parse(config, config_cache); res.has_value())
     {
-        h.m_config = std::move(res.value());
+        h.m_config       = std::move(res.value());
+        h.m_config_path  = config;
+        h.m_config_cache = config_cache;
+        if (http != nullptr) h.m_config->fetch_with(std::move(http), std::move(mirrors));
 
         if (auto res = h.m_config->build(); res.has_value())
             h.m_handle.reset(res.value());
@@ -43,6 +114,8 @@ handle::get_error() const noexcept -> const char *
 auto
 handle::search(std::string_view name) noexcept -> result<std::vector<package>>
 {
+    AURGH_TRACE_SPAN("alpm", "handle::search", name);
+
     std::string search { name };
 
     alpm_list_t *syncdbs = alpm_get_syncdbs(m_handle.get());
@@ -57,6 +130,8 @@ handle::search(std::string_view name) noexcept -> result<std::vector<package>>
         alpm_list_t *res = nullptr;
         auto        *db  = static_cast<alpm_db_t *>(i->data);
 
+        AURGH_TRACE_SPAN("alpm", "alpm_db_search", alpm_db_get_name(db));
+
         if (alpm_db_search(db, needle, &res) != 0)
             return error { "failed to search for a package on syncdb \"{}\": {}",
                            alpm_db_get_name(db), get_error() }
@@ -81,6 +156,8 @@ handle::search(std::string_view name) noexcept -> result<std::vector<package>>
 auto
 handle::info(std::span<const std::string> args) noexcept -> result<std::vector<package_details>>
 {
+    AURGH_TRACE_SPAN("alpm", "handle::info", args.empty() ? std::string_view {} : args.front());
+
     alpm_list_t *syncdbs = alpm_get_syncdbs(m_handle.get());
 
     std::vector<package_details> details;
@@ -99,6 +176,289 @@ handle::info(std::span<const std::string> args) noexcept -> result<std::vector<p
 }
 
 
+void
+handle::preload() noexcept
+{
+    /* an unreadable database shows up as an empty one, like it would on a lookup */
+    for (alpm_list_t *i = alpm_get_syncdbs(m_handle.get()); i != nullptr; i = alpm_list_next(i))
+    {
+        auto *db = static_cast<alpm_db_t *>(i->data);
+
+        AURGH_TRACE_SPAN("alpm", "alpm_db_get_pkgcache", alpm_db_get_name(db));
+        std::ignore = alpm_db_get_pkgcache(db);
+    }
+}
+
+
+auto
+handle::index() noexcept -> result<sync_index>
+try
+{
+    AURGH_TRACE_SPAN("alpm", "handle::index");
+
+    sync_index index;
+
+    for (alpm_list_t *i = alpm_get_syncdbs(m_handle.get()); i != nullptr; i = alpm_list_next(i))
+    {
+        alpm_list_t *cache = alpm_db_get_pkgcache(static_cast<alpm_db_t *>(i->data));
+
+        index.packages.reserve(index.packages.size() + alpm_list_count(cache));
+        index.details.reserve(index.details.size() + alpm_list_count(cache));
+
+        for (alpm_list_t *j = cache; j != nullptr; j = alpm_list_next(j))
+        {
+            auto *pkg = static_cast<alpm_pkg_t *>(j->data);
+
+            index.packages.emplace_back(package::from_alpm(pkg));
+            index.details.emplace_back(package_details::from_alpm(pkg));
+        }
+    }
+
+    return index;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to index the sync databases: {}", e.what() }.unexpected();
+}
+
+
+auto
+handle::refresh(bool force) noexcept -> result<sync_delta>
+try
+{
+    AURGH_TRACE_SPAN("alpm", "handle::refresh");
+
+    alpm_handle_t *h       = m_handle.get();
+    alpm_list_t   *syncdbs = alpm_get_syncdbs(h);
+    fs::path       sync    = fs::path { alpm_option_get_dbpath(h) } / "sync";
+
+    auto written = [&sync](alpm_db_t *db) -> std::optional<fs::file_time_type>
+    {
+        std::error_code ec;
+        auto time = fs::last_write_time(sync / std::format("{}.db", alpm_db_get_name(db)), ec);
+        return ec ? std::nullopt : std::optional { time };
+    };
+
+    struct snapshot
+    {
+        std::optional<fs::file_time_type> written;
+        std::map<std::string, package>    packages;
+    };
+
+    /* libalpm drops the cache of every database it downloads, so it is copied first */
+    std::map<std::string, snapshot> before;
+
+    for (alpm_list_t *i = syncdbs; i != nullptr; i = alpm_list_next(i))
+    {
+        auto *db   = static_cast<alpm_db_t *>(i->data);
+        auto &snap = before[alpm_db_get_name(db)];
+
+        snap.written = written(db);
+
+        for (alpm_list_t *j = alpm_db_get_pkgcache(db); j != nullptr; j = alpm_list_next(j))
+        {
+            auto *pkg = static_cast<alpm_pkg_t *>(j->data);
+            snap.packages.try_emplace(alpm_pkg_get_name(pkg), package::from_alpm(pkg));
+        }
+    }
+
+    if (alpm_db_update(h, syncdbs, force ? 1 : 0) < 0)
+        return error { "failed to refresh the sync databases: {}", get_error() }.unexpected();
+
+    sync_delta delta;
+
+    for (alpm_list_t *i = syncdbs; i != nullptr; i = alpm_list_next(i))
+    {
+        auto *db   = static_cast<alpm_db_t *>(i->data);
+        auto &snap = before[alpm_db_get_name(db)];
+
+        /* a database left alone keeps its mtime, which is all a 304 leaves behind */
+        if (auto time = written(db); time.has_value() and time == snap.written) continue;
+
+        delta.repos.emplace_back(alpm_db_get_name(db));
+
+        for (alpm_list_t *j = alpm_db_get_pkgcache(db); j != nullptr; j = alpm_list_next(j))
+        {
+            auto *pkg = static_cast<alpm_pkg_t *>(j->data);
+            auto  old = snap.packages.extract(alpm_pkg_get_name(pkg));
+
+            if (old.empty())
+                delta.added.emplace_back(package::from_alpm(pkg));
+            else if (old.mapped().version != alpm_pkg_get_version(pkg))
+                delta.changed.emplace_back(package::from_alpm(pkg));
+        }
+
+        for (auto &[_, pkg] : snap.packages) delta.removed.emplace_back(std::move(pkg));
+    }
+
+    return delta;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to refresh the sync databases: {}", e.what() }.unexpected();
+}
+
+
+auto
+handle::transaction(const transaction_request &request) noexcept -> result<std::vector<package>>
+try
+{
+    AURGH_TRACE_SPAN("alpm", "handle::transaction");
+
+    /* nothing may be prefetched into the package cache by a process that cannot commit */
+    if (uid_t self = geteuid(); self != 0)
+        return error { "a transaction needs root, not uid {}", self }.unexpected();
+
+    alpm_handle_t *h       = m_handle.get();
+    alpm_list_t   *syncdbs = alpm_get_syncdbs(h);
+
+    if (request.refresh and alpm_db_update(h, syncdbs, 0) < 0)
+        return error { "failed to refresh the sync databases: {}", get_error() }.unexpected();
+
+    if (alpm_trans_init(h, m_config->flag) != 0)
+        return error { "failed to start a transaction: {}", get_error() }.unexpected();
+
+    /* alpm_trans_release fits the deleter shape, the handle itself is not freed */
+    using trans_destructor = util::destructor<alpm_handle_t, alpm_trans_release>;
+    std::unique_ptr<alpm_handle_t, trans_destructor> trans { h };
+
+    if (request.sysupgrade and alpm_sync_sysupgrade(h, 0) != 0)
+        return error { "failed to queue a system upgrade: {}", get_error() }.unexpected();
+
+    for (const auto &target : request.targets)
+    {
+        alpm_pkg_t *pkg = alpm_find_dbs_satisfier(h, syncdbs, target.c_str());
+        if (pkg == nullptr)
+            return error { "target not found in the sync databases: {}", target }.unexpected();
+
+        if (alpm_add_pkg(h, pkg) != 0 and alpm_errno(h) != ALPM_ERR_TRANS_DUP_TARGET)
+            return error { "failed to add \"{}\" to the transaction: {}", target, get_error() }
+                .unexpected();
+    }
+
+    alpm_list_t *data = nullptr;
+
+    if (alpm_trans_prepare(h, &data) != 0)
+        return error { "failed to prepare the transaction: {}{}", get_error(),
+                       describe_trans_data(alpm_errno(h), data) }
+            .unexpected();
+
+    std::vector<package>                             installed;
+    std::vector<std::pair<std::string, std::string>> downloads;
+
+    for (alpm_list_t *i = alpm_trans_get_add(h); i != nullptr; i = alpm_list_next(i))
+    {
+        auto *pkg = static_cast<alpm_pkg_t *>(i->data);
+
+        installed.emplace_back(package::from_alpm(pkg));
+        if (alpm_pkg_get_origin(pkg) == ALPM_PKG_FROM_SYNCDB)
+            downloads.emplace_back(alpm_db_get_name(alpm_pkg_get_db(pkg)),
+                                   alpm_pkg_get_filename(pkg));
+    }
+
+    if (installed.empty() and alpm_trans_get_remove(h) == nullptr) return installed;
+
+    /* libalpm hands a fetch callback one file at a time, so the packages are pulled into
+       the cache ParallelDownloads at a time first and the commit finds them there */
+    if (auto *fetch = m_config->http_fetcher(); fetch != nullptr and !m_config->cache_dir.empty())
+        fetch->prefetch(downloads, m_config->cache_dir.front(), m_config->parallel_downloads);
+
+    if (alpm_trans_commit(h, &data) != 0)
+        return error { "failed to commit the transaction: {}{}", get_error(),
+                       describe_trans_data(alpm_errno(h), data) }
+            .unexpected();
+
+    return installed;
+}
+catch (const std::exception &e)
+{
+    return error { "transaction failed: {}", e.what() }.unexpected();
+}
+
+
+/* libalpm has no way to reorder servers, so each list is dropped and added back */
+auto
+handle::reorder_servers() noexcept -> result<void>
+try
+{
+    m_config->rank_servers();
+
+    for (const auto &repo : m_config->repos)
+    {
+        alpm_db_t *db = nullptr;
+
+        for (alpm_list_t *i = alpm_get_syncdbs(m_handle.get()); i != nullptr;
+             i = alpm_list_next(i))
+            if (repo.name == alpm_db_get_name(static_cast<alpm_db_t *>(i->data)))
+                db = static_cast<alpm_db_t *>(i->data);
+
+        if (db == nullptr) continue;
+
+        for (const auto &url : repo.servers) alpm_db_remove_server(db, url.c_str());
+        for (const auto &url : repo.servers)
+            if (alpm_db_add_server(db, url.c_str()) != 0)
+                return error { "failed to add server URL to database \"{}\": {}", repo.name,
+                               get_error() }
+                    .unexpected();
+    }
+
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to reorder servers: {}", e.what() }.unexpected();
+}
+
+
+auto
+handle::reload() noexcept -> result<config_delta>
+try
+{
+    AURGH_TRACE_SPAN("alpm", "handle::reload");
+
+    auto next = config::parse(m_config_path, m_config_cache);
+    if (!next) return next.error().unexpected();
+
+    config_delta delta;
+
+    auto res = m_config->apply(m_handle.get(), std::move(*next.value()));
+
+    /* the names point into the repos, which a failed apply may have replaced all the same */
+    m_repos = m_config->repos | std::views::transform(&repo::name)
+            | std::ranges::to<std::vector<std::string_view>>();
+
+    if (res.has_value())
+        delta.repos = std::move(res.value());
+    else
+        return res.error().unexpected();
+
+    delta.sources = m_config->sources();
+    return delta;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to reload \"{}\": {}", m_config_path.c_str(), e.what() }.unexpected();
+}
+
+
+auto
+handle::sync_time() const noexcept -> fs::file_time_type
+{
+    fs::path sync = fs::path { alpm_option_get_dbpath(m_handle.get()) } / "sync";
+
+    fs::file_time_type newest {};
+    std::error_code    ec;
+
+    for (std::string_view repo : m_repos)
+    {
+        auto time = fs::last_write_time(sync / std::format("{}.db", repo), ec);
+        if (!ec) newest = std::max(newest, time);
+    }
+
+    return newest;
+}
+
+
 auto
 handle::get_repos() const noexcept -> std::span<const std::string_view>
 { return m_repos; }
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <fstream>
+
+#include <glibmm/main.h>
+
+#include "alpm/config.hh"
+#include "alpm/mirrors.hh"
+
+using aurgh::alpm::mirror_scores;
+
+namespace
+{
+    /* how much a new sample counts against a fresh score */
+    constexpr double sample_weight = 0.3;
+
+    /* a failure costs as much as this many seconds of transfer */
+    constexpr double failure_cost = 2.0;
+}
+
+
+auto
+mirror_scores::load(std::filesystem::path path) noexcept -> result<std::shared_ptr<mirror_scores>>
+try
+{
+    auto scores    = std::make_shared<mirror_scores>();
+    scores->m_path = std::move(path);
+
+    std::ifstream stream { scores->m_path };
+    if (!stream.is_open()) return scores; /* nothing measured yet */
+
+    entry        e;
+    std::int64_t seconds;
+
+    for (std::string host; stream >> e.latency >> e.throughput >> e.penalty >> seconds >> host;)
+    {
+        e.updated = clock::time_point { std::chrono::seconds { seconds } };
+        scores->m_hosts.insert_or_assign(std::move(host), e);
+    }
+
+    if (!stream.eof())
+        return error { "failed to read mirror scores \"{}\"", scores->m_path.c_str() }
+            .unexpected();
+    return scores;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to load mirror scores \"{}\": {}", path.c_str(), e.what() }
+        .unexpected();
+}
+
+
+auto
+mirror_scores::save() const noexcept -> result<void>
+try
+{
+    std::filesystem::path tmp = m_path;
+    tmp += ".tmp";
+
+    std::filesystem::create_directories(m_path.parent_path());
+
+    {
+        std::lock_guard lock { m_mutex };
+        std::ofstream   stream { tmp, std::ios::trunc };
+
+        for (const auto &[host, e] : m_hosts)
+            stream << e.latency << ' ' << e.throughput << ' ' << e.penalty << ' '
+                   << std::chrono::duration_cast<std::chrono::seconds>(
+                          e.updated.time_since_epoch())
+                          .count()
+                   << ' ' << host << '\n';
+
+        if (!stream.flush())
+            return error { "failed to write mirror scores \"{}\"", tmp.c_str() }.unexpected();
+    }
+
+    std::filesystem::rename(tmp, m_path);
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to save mirror scores \"{}\": {}", m_path.c_str(), e.what() }
+        .unexpected();
+}
+
+
+void
+mirror_scores::record(std::string_view server, const http::timings &timings)
+{
+    auto transfer = timings.total - timings.first_byte;
+    if (timings.bytes <= 0 or transfer.count() <= 0) return;
+
+    double latency    = double(timings.connect.count());
+    double throughput = double(timings.bytes) / (double(transfer.count()) / 1e6);
+
+    auto now = clock::now();
+
+    std::lock_guard lock { m_mutex };
+    auto [it, fresh] = m_hosts.try_emplace(host_of(server));
+    auto &e          = it->second;
+
+    if (fresh)
+    {
+        e.latency    = latency;
+        e.throughput = throughput;
+    }
+    else
+    {
+        double old   = (1 - sample_weight) * weight_of(e, now);
+        double total = old + sample_weight;
+
+        e.latency    = (old * e.latency + sample_weight * latency) / total;
+        e.throughput = (old * e.throughput + sample_weight * throughput) / total;
+        e.penalty *= weight_of(e, now);
+    }
+
+    e.updated = now;
+}
+
+
+void
+mirror_scores::record_failure(std::string_view server)
+{
+    auto now = clock::now();
+
+    std::lock_guard lock { m_mutex };
+    auto &e = m_hosts[host_of(server)];
+
+    e.penalty = e.penalty * weight_of(e, now) + 1;
+    e.updated = now;
+}
+
+
+auto
+mirror_scores::cost(std::string_view server) const -> std::chrono::microseconds
+{
+    std::lock_guard lock { m_mutex };
+
+    auto it = m_hosts.find(host_of(server));
+    if (it == m_hosts.end()) return unknown_cost;
+
+    const auto &e      = it->second;
+    double      weight = weight_of(e, clock::now());
+
+    /* a stale measurement drifts back towards the cost of an unknown host */
+    double measured = e.throughput > 0 ? e.latency + double(probe_bytes) / e.throughput * 1e6
+                                       : double(unknown_cost.count());
+    double penalty  = e.penalty * weight * failure_cost * 1e6;
+    double blended  = weight * measured + (1 - weight) * double(unknown_cost.count()) + penalty;
+
+    return std::chrono::microseconds { std::llround(blended) };
+}
+
+
+void
+mirror_scores::rank(std::vector<std::string> &servers) const
+{
+    std::vector<std::pair<std::chrono::microseconds, std::string>> costed;
+    costed.reserve(servers.size());
+
+    for (auto &server : servers) costed.emplace_back(cost(server), std::move(server));
+    std::ranges::stable_sort(costed, {}, &decltype(costed)::value_type::first);
+
+    servers.clear();
+    for (auto &[_, server] : costed) servers.emplace_back(std::move(server));
+}
+
+
+void
+mirror_scores::probe(http::client &http, const std::vector<repo> &repos, std::function<void()> done)
+{
+    struct state
+    {
+        std::size_t                                  remaining = 0;
+        std::function<void()>                        done;
+        std::vector<std::shared_ptr<http::transfer>> transfers;
+    };
+
+    auto s  = std::make_shared<state>();
+    s->done = std::move(done);
+
+    auto self   = shared_from_this();
+    auto finish = [s]
+    {
+        if (--s->remaining != 0) return;
+
+        if (s->done) std::exchange(s->done, nullptr)();
+        Glib::signal_idle().connect_once([s] { s->transfers.clear(); });
+    };
+
+    /* one probe per host is enough, the first repository it serves is as good as any */
+    std::map<std::string, std::string> urls;
+    for (const auto &r : repos)
+        for (const auto &server : r.servers)
+            urls.try_emplace(host_of(server), std::format("{}/{}.db", server, r.name));
+
+    for (const auto &[host, url] : urls)
+    {
+        auto res = http.get(url, { std::format("Range: bytes=0-{}", probe_bytes - 1) });
+        if (!res)
+        {
+            record_failure(host);
+            continue;
+        }
+
+        s->remaining++;
+        s->transfers.emplace_back(res.value());
+
+        std::weak_ptr<http::transfer> weak = res.value();
+        res.value()
+            ->on_complete(
+                [self, host, weak, finish](http::completion done)
+                {
+                    auto t = weak.lock();
+                    if (t != nullptr and (done.return_code == 200 or done.return_code == 206))
+                        self->record(host, t->measured());
+                    else
+                        self->record_failure(host);
+                    finish();
+                })
+            .on_error(
+                [self, host, finish](std::string_view)
+                {
+                    self->record_failure(host);
+                    finish();
+                });
+    }
+
+    /* nothing to wait for still answers on the main loop, never from inside this call */
+    if (s->remaining == 0)
+    {
+        s->remaining = 1;
+        Glib::signal_idle().connect_once(finish);
+    }
+}
+
+
+/* scheme and authority: every repository on a mirror shares its score */
+auto
+mirror_scores::host_of(std::string_view server) -> std::string
+{
+    std::size_t scheme = server.find("://");
+    std::size_t start  = scheme == std::string_view::npos ? 0 : scheme + 3;
+
+    return std::string { server.substr(0, server.find('/', start)) };
+}
+
+
+auto
+mirror_scores::weight_of(const entry &e, clock::time_point now) -> double
+{
+    double age  = std::chrono::duration<double>(now - e.updated).count();
+    double life = std::chrono::duration<double>(half_life).count();
+
+    return std::exp2(-std::max(age, 0.0) / life);
+}
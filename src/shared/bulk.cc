@@ -0,0 +1,417 @@
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "bulk.hh"
+
+namespace bulk = aurgh::bulk;
+using bulk::string_ref;
+using bulk::list_ref;
+
+namespace
+{
+    constexpr int required_seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+
+
+    [[nodiscard]]
+    constexpr auto
+    align(std::uint64_t value, std::uint64_t alignment) noexcept -> std::uint64_t
+    { return (value + alignment - 1) & ~(alignment - 1); }
+
+
+    /* fills the mapping of a file sized for its layout */
+    class writer
+    {
+    public:
+        writer(char *base, const bulk::header &layout) noexcept
+            : m_records { base + layout.records_offset },
+              m_refs { reinterpret_cast<string_ref *>(base + layout.refs_offset) },
+              m_strings { base + layout.strings_offset }
+        {
+        }
+
+
+        template <typename Record>
+        [[nodiscard]]
+        auto
+        record(std::size_t i) noexcept -> Record &
+        { return reinterpret_cast<Record *>(m_records)[i]; }
+
+
+        auto
+        string(std::string_view str) noexcept -> string_ref
+        {
+            std::memcpy(m_strings + m_string_cursor, str.data(), str.size());
+
+            string_ref ref { std::uint32_t(m_string_cursor), std::uint32_t(str.size()) };
+            m_string_cursor += str.size();
+            return ref;
+        }
+
+
+        auto
+        list(const std::vector<std::string> &items) noexcept -> list_ref
+        {
+            list_ref ref { m_ref_cursor, std::uint32_t(items.size()) };
+            for (const auto &item : items) m_refs[m_ref_cursor++] = string(item);
+            return ref;
+        }
+
+    private:
+        char       *m_records;
+        string_ref *m_refs;
+        char       *m_strings;
+
+        std::uint64_t m_string_cursor = 0;
+        std::uint32_t m_ref_cursor    = 0;
+    };
+
+
+    /* sizes @p fd for the layout and fills it through a shared mapping */
+    template <typename Record, typename Fill>
+    [[nodiscard]]
+    auto
+    fill_file(int fd, bulk::kind type, std::size_t count, std::size_t ref_count,
+              std::size_t strings_size, Fill &&fill) -> aurgh::result<void>
+    {
+        using aurgh::error;
+
+        constexpr auto max = std::numeric_limits<std::uint32_t>::max();
+        if (count > max or ref_count > max or strings_size > max)
+            return error { "result is too large for a bulk file" }.unexpected();
+
+        bulk::header layout { .magic          = bulk::magic,
+                              .version        = bulk::version,
+                              .type           = type,
+                              .count          = std::uint32_t(count),
+                              .ref_count      = std::uint32_t(ref_count),
+                              .records_offset = align(sizeof(bulk::header), alignof(Record)),
+                              .refs_offset    = 0,
+                              .strings_offset = 0,
+                              .strings_size   = strings_size };
+
+        layout.refs_offset    = align(layout.records_offset + count * sizeof(Record),
+                                      alignof(string_ref));
+        layout.strings_offset = layout.refs_offset + ref_count * sizeof(string_ref);
+
+        std::size_t total = layout.strings_offset + strings_size;
+
+        if (ftruncate(fd, off_t(total)) == -1)
+            return error { "failed to size the bulk file: {}", std::strerror(errno) }
+                .unexpected();
+
+        void *data = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+            return error { "failed to map the bulk file: {}", std::strerror(errno) }
+                .unexpected();
+
+        std::memcpy(data, &layout, sizeof(layout));
+
+        writer w { static_cast<char *>(data), layout };
+        fill(w);
+
+        munmap(data, total);
+        return {};
+    }
+
+
+    [[nodiscard]]
+    auto
+    encode(int fd, std::span<const aurgh::package> packages) -> aurgh::result<void>
+    {
+        std::size_t strings_size = 0;
+        for (const auto &pkg : packages)
+            strings_size += pkg.name.bytes() + pkg.version.size() + pkg.description.bytes()
+                          + pkg.repo.size() + pkg.base.size();
+
+        return fill_file<bulk::package_record>(
+            fd, bulk::kind::packages, packages.size(), 0, strings_size,
+            [&](writer &w)
+            {
+                for (std::size_t i = 0; i < packages.size(); i++)
+                {
+                    const auto &pkg = packages[i];
+
+                    w.record<bulk::package_record>(i) = {
+                        .name        = w.string(pkg.name.raw()),
+                        .version     = w.string(pkg.version),
+                        .description = w.string(pkg.description.raw()),
+                        .repo        = w.string(pkg.repo),
+                        .base        = w.string(pkg.base),
+                    };
+                }
+            });
+    }
+
+
+    [[nodiscard]]
+    auto
+    encode(int fd, std::span<const aurgh::package_details> details) -> aurgh::result<void>
+    {
+        std::size_t ref_count    = 0;
+        std::size_t strings_size = 0;
+
+        for (const auto &detail : details)
+        {
+            for (const auto *list :
+                 { &detail.licenses, &detail.depends, &detail.make_depends, &detail.opt_depends })
+            {
+                ref_count += list->size();
+                for (const auto &item : *list) strings_size += item.size();
+            }
+
+            strings_size += detail.url.size() + detail.base.size();
+        }
+
+        return fill_file<bulk::details_record>(
+            fd, bulk::kind::details, details.size(), ref_count, strings_size,
+            [&](writer &w)
+            {
+                for (std::size_t i = 0; i < details.size(); i++)
+                {
+                    const auto &detail = details[i];
+
+                    w.record<bulk::details_record>(i) = {
+                        .licenses     = w.list(detail.licenses),
+                        .depends      = w.list(detail.depends),
+                        .make_depends = w.list(detail.make_depends),
+                        .opt_depends  = w.list(detail.opt_depends),
+                        .url          = w.string(detail.url),
+                        .base         = w.string(detail.base),
+                        .last_updated = detail.last_updated.count(),
+                    };
+                }
+            });
+    }
+
+
+    template <typename T>
+    [[nodiscard]]
+    auto
+    write_sealed(std::span<const T> items) -> aurgh::result<sdbus::UnixFd>
+    {
+        using aurgh::error;
+
+        int fd = memfd_create("aurgh-bulk", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd == -1)
+            return error { "failed to create a memfd: {}", std::strerror(errno) }.unexpected();
+
+        /* adopted right away so every early return closes it */
+        sdbus::UnixFd file { fd, sdbus::adopt_fd };
+
+        if (auto res = encode(fd, items); !res) return res.error().unexpected();
+
+        /* F_SEAL_WRITE is refused while a writable mapping exists, encode has dropped it */
+        if (fcntl(fd, F_ADD_SEALS, required_seals | F_SEAL_SEAL) == -1)
+            return error { "failed to seal the memfd: {}", std::strerror(errno) }.unexpected();
+
+        return file;
+    }
+
+
+    /* written next to @p path and renamed over it, readers never see half a file */
+    template <typename T>
+    [[nodiscard]]
+    auto
+    save_file(std::span<const T> items, const std::filesystem::path &path) -> aurgh::result<void>
+    {
+        using aurgh::error;
+
+        std::filesystem::path tmp = path;
+        tmp += ".tmp";
+
+        int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd == -1)
+            return error { "failed to create \"{}\": {}", tmp.c_str(), std::strerror(errno) }
+                .unexpected();
+
+        auto res = encode(fd, items);
+        close(fd);
+
+        std::error_code ec;
+        if (res) std::filesystem::rename(tmp, path, ec);
+
+        if (!res or ec)
+        {
+            std::filesystem::remove(tmp, ec);
+            if (!res) return res.error().unexpected();
+            return error { "failed to replace \"{}\": {}", path.c_str(), ec.message() }
+                .unexpected();
+        }
+
+        return {};
+    }
+
+
+    [[nodiscard]]
+    auto
+    fits(string_ref ref, std::uint64_t strings_size) noexcept -> bool
+    { return ref.offset <= strings_size and ref.size <= strings_size - ref.offset; }
+
+
+    [[nodiscard]]
+    auto
+    fits(list_ref ref, std::uint32_t ref_count) noexcept -> bool
+    { return ref.first <= ref_count and ref.count <= ref_count - ref.first; }
+
+
+    [[nodiscard]]
+    auto
+    valid(const bulk::package_record &record, const bulk::header &hdr) noexcept -> bool
+    {
+        for (string_ref ref : { record.name, record.version, record.description, record.repo,
+                                record.base })
+            if (!fits(ref, hdr.strings_size)) return false;
+        return true;
+    }
+
+
+    [[nodiscard]]
+    auto
+    valid(const bulk::details_record &record, const bulk::header &hdr) noexcept -> bool
+    {
+        for (list_ref ref :
+             { record.licenses, record.depends, record.make_depends, record.opt_depends })
+            if (!fits(ref, hdr.ref_count)) return false;
+
+        return fits(record.url, hdr.strings_size) and fits(record.base, hdr.strings_size);
+    }
+}
+
+
+auto
+bulk::write(std::span<const package> packages) noexcept -> result<sdbus::UnixFd>
+try
+{
+    return write_sealed(packages);
+}
+catch (const std::exception &e)
+{
+    return error { "failed to write {} packages: {}", packages.size(), e.what() }.unexpected();
+}
+
+
+auto
+bulk::write(std::span<const package_details> details) noexcept -> result<sdbus::UnixFd>
+try
+{
+    return write_sealed(details);
+}
+catch (const std::exception &e)
+{
+    return error { "failed to write {} package details: {}", details.size(), e.what() }
+        .unexpected();
+}
+
+
+auto
+bulk::save(std::span<const package> packages, const std::filesystem::path &path) noexcept
+    -> result<void>
+try
+{
+    return save_file(packages, path);
+}
+catch (const std::exception &e)
+{
+    return error { "failed to save {} packages: {}", packages.size(), e.what() }.unexpected();
+}
+
+
+auto
+bulk::save(std::span<const package_details> details, const std::filesystem::path &path) noexcept
+    -> result<void>
+try
+{
+    return save_file(details, path);
+}
+catch (const std::exception &e)
+{
+    return error { "failed to save {} package details: {}", details.size(), e.what() }
+        .unexpected();
+}
+
+
+template <bulk::kind K>
+bulk::table<K>::table(mapped_file &&file) noexcept : m_file { std::move(file) }
+{
+    const char *base = m_file.view().data();
+
+    m_header  = reinterpret_cast<const header *>(base);
+    m_records = reinterpret_cast<const record_type *>(base + m_header->records_offset);
+    m_refs    = reinterpret_cast<const string_ref *>(base + m_header->refs_offset);
+    m_blob    = base + m_header->strings_offset;
+}
+
+
+template <bulk::kind K>
+auto
+bulk::table<K>::open(int fd) noexcept -> result<table>
+{
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals == -1 or (seals & required_seals) != required_seals)
+        return error { "bulk file is not sealed, it could change under the reader" }.unexpected();
+
+    auto file = mapped_file::map(fd);
+    if (!file) return error { "failed to map a bulk file: {}", file.error() }.unexpected();
+
+    return validate(std::move(file.value()));
+}
+
+
+template <bulk::kind K>
+auto
+bulk::table<K>::load(const std::filesystem::path &path) noexcept -> result<table>
+{
+    auto file = mapped_file::open(path);
+    if (!file) return file.error().unexpected();
+
+    return validate(std::move(file.value()));
+}
+
+
+/* everything is bounds-checked once here so the views never have to */
+template <bulk::kind K>
+auto
+bulk::table<K>::validate(mapped_file &&file) noexcept -> result<table>
+{
+    std::string_view data = file.view();
+    if (data.size() < sizeof(header)) return error { "bulk file is truncated" }.unexpected();
+
+    const auto &hdr = *reinterpret_cast<const header *>(data.data());
+
+    if (hdr.magic != magic or hdr.version != version or hdr.type != K)
+        return error { "not a bulk file of the expected kind or version" }.unexpected();
+
+    const std::uint64_t size = data.size();
+
+    bool fits_file = hdr.records_offset % alignof(record_type) == 0
+                 and hdr.refs_offset % alignof(string_ref) == 0
+                 and hdr.records_offset <= size
+                 and hdr.count <= (size - hdr.records_offset) / sizeof(record_type)
+                 and hdr.refs_offset <= size
+                 and hdr.ref_count <= (size - hdr.refs_offset) / sizeof(string_ref)
+                 and hdr.strings_offset <= size and hdr.strings_size <= size - hdr.strings_offset;
+    if (!fits_file) return error { "bulk file sections are out of bounds" }.unexpected();
+
+    const auto *records = reinterpret_cast<const record_type *>(data.data() + hdr.records_offset);
+    const auto *refs    = reinterpret_cast<const string_ref *>(data.data() + hdr.refs_offset);
+
+    for (std::uint32_t i = 0; i < hdr.count; i++)
+        if (!valid(records[i], hdr))
+            return error { "bulk record {} points out of bounds", i }.unexpected();
+
+    for (std::uint32_t i = 0; i < hdr.ref_count; i++)
+        if (!fits(refs[i], hdr.strings_size))
+            return error { "bulk string reference {} points out of bounds", i }.unexpected();
+
+    return table { std::move(file) };
+}
+
+
+template class aurgh::bulk::table<aurgh::bulk::kind::packages>;
+template class aurgh::bulk::table<aurgh::bulk::kind::details>;
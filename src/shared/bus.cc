@@ -0,0 +1,111 @@
+#include <utility>
+
+#include <glibmm/main.h>
+
+#include "bus.hh"
+
+namespace bus = aurgh::bus;
+using bus::main_loop_source;
+
+
+auto
+bus::to_record(const package &pkg) -> package_record
+{ return { pkg.name.raw(), pkg.version, pkg.description.raw(), pkg.repo, pkg.base }; }
+
+
+auto
+bus::to_record(const package_details &details) -> details_record
+{
+    return { details.licenses,
+             details.depends,
+             details.make_depends,
+             details.opt_depends,
+             details.url,
+             std::int64_t(details.last_updated.count()),
+             details.base };
+}
+
+
+auto
+bus::from_record(package_record &&record) -> package
+{
+    return package { .name        = std::move(std::get<0>(record)),
+                     .version     = std::move(std::get<1>(record)),
+                     .description = std::move(std::get<2>(record)),
+                     .repo        = std::move(std::get<3>(record)),
+                     .base        = std::move(std::get<4>(record)) };
+}
+
+
+auto
+bus::from_record(details_record &&record) -> package_details
+{
+    return package_details { .licenses     = std::move(std::get<0>(record)),
+                             .depends      = std::move(std::get<1>(record)),
+                             .make_depends = std::move(std::get<2>(record)),
+                             .opt_depends  = std::move(std::get<3>(record)),
+                             .url          = std::move(std::get<4>(record)),
+                             .last_updated = std::chrono::seconds { std::get<5>(record) },
+                             .base         = std::move(std::get<6>(record)) };
+}
+
+
+auto
+bus::to_error(const error &err) -> sdbus::Error
+{ return sdbus::Error { sdbus::Error::Name { error_name }, std::string { err.message() } }; }
+
+
+main_loop_source::main_loop_source(sdbus::IConnection &connection) : m_connection { connection }
+{
+    /* woken whenever another thread queues something on the connection */
+    m_wakeup = Glib::signal_io().connect([this](Glib::IOCondition) { return mf_dispatch(); },
+                                         m_connection.getEventLoopPollData().eventFd,
+                                         Glib::IOCondition::IO_IN);
+    mf_refresh();
+}
+
+
+main_loop_source::~main_loop_source()
+{
+    m_io.disconnect();
+    m_wakeup.disconnect();
+    m_timer.disconnect();
+}
+
+
+void
+main_loop_source::mf_refresh()
+{
+    auto data = m_connection.getEventLoopPollData();
+
+    if (data.fd != m_fd or data.events != m_events)
+    {
+        m_io.disconnect();
+        m_io = Glib::signal_io().connect([this](Glib::IOCondition) { return mf_dispatch(); },
+                                         data.fd, static_cast<Glib::IOCondition>(data.events));
+
+        m_fd     = data.fd;
+        m_events = data.events;
+    }
+
+    m_timer.disconnect();
+    if (int timeout = data.getPollTimeout(); timeout >= 0)
+        m_timer = Glib::signal_timeout().connect(
+            [this]
+            {
+                std::ignore = mf_dispatch();
+                return false;
+            },
+            timeout);
+}
+
+
+auto
+main_loop_source::mf_dispatch() -> bool
+{
+    while (m_connection.processPendingEvent()) {}
+
+    /* may replace the very source this runs from, which glib allows */
+    mf_refresh();
+    return true;
+}
@@ -0,0 +1,573 @@
+#include <mutex>
+#include <utility>
+
+#include <git2.h>
+
+#include "git.hh"
+
+using aurgh::git::cloning;
+
+namespace
+{
+    [[nodiscard]]
+    auto
+    get_libgit2_error() noexcept -> std::string_view
+    {
+        const auto *err = git_error_last();
+        if (err != nullptr and err->message != nullptr) return err->message;
+        return { "no error specified" };
+    }
+
+
+    /* m_dst comes from the url, so nothing outside of the clone directory is removed for it */
+    [[nodiscard]]
+    auto
+    inside(const std::filesystem::path &path, const std::filesystem::path &base) -> bool
+    {
+        auto relative = path.lexically_normal().lexically_relative(base.lexically_normal());
+        return !relative.empty() and relative != "." and *relative.begin() != "..";
+    }
+
+
+    auto
+    remove_checkout(const std::filesystem::path &path, const std::filesystem::path &base)
+        -> aurgh::result<void>
+    {
+        if (!inside(path, base))
+            return aurgh::error { R"(refusing to remove "{}", it is not inside "{}")",
+                                  path.c_str(), base.c_str() }
+                .unexpected();
+
+        if (std::filesystem::exists(path)) std::filesystem::remove_all(path);
+        return {};
+    }
+
+
+    constexpr std::string_view store_dir_name = ".store";
+
+    std::mutex store_mutex;
+
+
+    using repository_destructor
+        = aurgh::util::destructor<git_repository, git_repository_free>;
+
+
+    [[nodiscard]]
+    auto
+    open_store(const std::filesystem::path &path) noexcept
+        -> aurgh::result<std::unique_ptr<git_repository, repository_destructor>>
+    {
+        git_repository *repo = nullptr;
+
+        if (git_repository_open_bare(&repo, path.c_str()) == 0
+            or git_repository_init(&repo, path.c_str(), 1) == 0)
+            return std::unique_ptr<git_repository, repository_destructor> { repo };
+
+        return aurgh::error { R"(failed to open the shared store "{}": {})", path.c_str(),
+                              get_libgit2_error() }
+            .unexpected();
+    }
+
+
+    struct library
+    {
+        int status = git_libgit2_init();
+
+        library()                                    = default;
+        library(const library &)                     = delete;
+        auto operator=(const library &) -> library & = delete;
+
+        ~library()
+        {
+            if (status >= 0) git_libgit2_shutdown();
+        }
+    };
+}
+
+
+cloning::cloning(std::string_view url, std::filesystem::path base, layout mode)
+    : m_url { url }, m_base { std::move(base) }, m_layout { mode }
+{
+    if (auto name = repository_name(m_url); name.has_value())
+        m_dst = m_base / name.value();
+    else
+        throw name.error();
+
+    if (!std::filesystem::exists(m_base)) std::filesystem::create_directories(m_base);
+    if (!std::filesystem::is_directory(m_base))
+        throw error { "clone base directory is not a directory" };
+
+    m_dispatch_done.connect(sigc::mem_fun(*this, &cloning::mf_on_done));
+}
+
+
+void
+cloning::cancel()
+{ m_stop_source.request_stop(); }
+
+
+void
+cloning::mf_run()
+{
+    if (m_stop_source.stop_requested())
+    {
+        m_pending_error = error { R"(clone of "{}" was cancelled)", m_url };
+        m_dispatch_done.emit();
+        return;
+    }
+
+    /* taken only once the job runs, so that queued clones hold no slot and no frame timer.
+       Without a free slot the clone still runs, it just reports no progress */
+    if (auto res = progress::acquire([this](double value)
+                                     { m_signal_on_transfer_progress.emit(value); });
+        res.has_value())
+        m_progress = std::move(res.value());
+
+    git_repository *repo = nullptr;
+
+    result<void> res;
+    if (m_layout == layout::worktree)
+        res = mf_store();
+    else if (git_repository_open_ext(&repo, m_dst.c_str(), GIT_REPOSITORY_OPEN_NO_SEARCH, nullptr)
+             == 0)
+    {
+        res = mf_update(repo);
+        git_repository_free(repo);
+    }
+    else
+        res = mf_clone();
+
+    if (!res) m_pending_error = std::move(res.error());
+
+    m_dispatch_done.emit();
+}
+
+
+auto
+cloning::mf_clone() -> result<void>
+{
+    git_clone_options opts;
+    git_clone_options_init(&opts, GIT_CLONE_OPTIONS_VERSION);
+
+    opts.fetch_opts.callbacks.transfer_progress = &cloning::transfer_progress_callback;
+    opts.fetch_opts.callbacks.payload           = this;
+    opts.fetch_opts.depth                       = 1;
+
+    git_repository *repo = nullptr;
+
+    /* whatever is there is not a repository we can update */
+    if (auto res = remove_checkout(m_dst, m_base); !res) return res;
+
+    int res = git_clone(&repo, m_url.c_str(), m_dst.c_str(), &opts);
+
+    if (repo != nullptr) git_repository_free(repo);
+    if (res != 0)
+        return error { R"(failed to clone remote repository "{}" to "{}": {})", m_url,
+                       m_dst.c_str(), get_libgit2_error() }
+            .unexpected();
+    return {};
+}
+
+
+auto
+cloning::mf_update(git_repository *repo) -> result<void>
+{
+    auto fail = [this](std::string_view what)
+    {
+        return error { R"(failed to update "{}" from "{}": {}: {})", m_dst.c_str(), m_url, what,
+                       get_libgit2_error() }
+            .unexpected();
+    };
+
+    if (git_remote_set_url(repo, "origin", m_url.c_str()) != 0)
+        return fail("failed to set remote url");
+
+    std::unique_ptr<git_remote, remote_destructor> remote;
+
+    if (git_remote *ptr = nullptr; git_remote_lookup(&ptr, repo, "origin") == 0)
+        remote.reset(ptr);
+    else
+        return fail("failed to lookup remote");
+
+    git_fetch_options opts;
+    git_fetch_options_init(&opts, GIT_FETCH_OPTIONS_VERSION);
+
+    opts.callbacks.transfer_progress = &cloning::transfer_progress_callback;
+    opts.callbacks.payload           = this;
+    opts.prune                       = GIT_FETCH_PRUNE;
+    opts.depth                       = git_repository_is_shallow(repo) == 1 ? 1 : 0;
+
+    if (git_remote_fetch(remote.get(), nullptr, &opts, "aurgh: fetch") != 0)
+        return fail("failed to fetch");
+
+    std::unique_ptr<git_reference, reference_destructor> head;
+    std::unique_ptr<git_reference, reference_destructor> upstream;
+
+    if (git_reference *ptr = nullptr; git_repository_head(&ptr, repo) == 0)
+        head.reset(ptr);
+    else
+        return fail("failed to resolve HEAD");
+
+    if (git_reference *ptr = nullptr; git_branch_upstream(&ptr, head.get()) == 0)
+        upstream.reset(ptr);
+    else
+        return fail("failed to resolve the upstream branch");
+
+    return mf_fast_forward(repo, head.get(), git_reference_target(upstream.get()), false);
+}
+
+
+auto
+cloning::mf_fast_forward(git_repository *repo,
+                         git_reference  *head,
+                         const git_oid  *target,
+                         bool            shared_refs) -> result<void>
+{
+    auto fail = [this](std::string_view what)
+    {
+        return error { R"(failed to update "{}" from "{}": {}: {})", m_dst.c_str(), m_url, what,
+                       get_libgit2_error() }
+            .unexpected();
+    };
+
+    std::unique_ptr<git_annotated_commit, annotated_commit_destructor> annotated;
+
+    if (git_annotated_commit *ptr = nullptr;
+        git_annotated_commit_lookup(&ptr, repo, target) == 0)
+        annotated.reset(ptr);
+    else
+        return fail("failed to lookup the fetched commit");
+
+    git_merge_analysis_t   analysis;
+    git_merge_preference_t preference;
+
+    const git_annotated_commit *heads[] = { annotated.get() };
+    if (git_merge_analysis(&analysis, &preference, repo, heads, 1) != 0)
+        return fail("failed to analyze the fetched commit");
+
+    if ((analysis & GIT_MERGE_ANALYSIS_UP_TO_DATE) != 0) return {};
+    if ((analysis & GIT_MERGE_ANALYSIS_FASTFORWARD) == 0)
+        return error { R"(failed to update "{}": local branch has diverged from "{}")",
+                       m_dst.c_str(), m_url }
+            .unexpected();
+
+    std::unique_ptr<git_object, object_destructor> commit;
+
+    if (git_object *ptr = nullptr; git_object_lookup(&ptr, repo, target, GIT_OBJECT_COMMIT) == 0)
+        commit.reset(ptr);
+    else
+        return fail("failed to lookup the fetched commit");
+
+    git_checkout_options checkout;
+    git_checkout_options_init(&checkout, GIT_CHECKOUT_OPTIONS_VERSION);
+    checkout.checkout_strategy = GIT_CHECKOUT_SAFE;
+
+    if (git_checkout_tree(repo, commit.get(), &checkout) != 0)
+        return fail("failed to checkout the fetched tree");
+
+    /* a worktree's branch lives in the store, next to the refs every other job updates */
+    std::unique_lock<std::mutex> lock;
+    if (shared_refs) lock = std::unique_lock { store_mutex };
+
+    if (git_reference *ptr = nullptr;
+        git_reference_set_target(&ptr, head, target, "aurgh: fast-forward") == 0)
+        git_reference_free(ptr);
+    else
+        return fail("failed to fast-forward HEAD");
+
+    return {};
+}
+
+
+auto
+cloning::mf_store() -> result<void>
+{
+    auto fail = [this](std::string_view what)
+    {
+        return error { R"(failed to fetch "{}" into the shared store: {}: {})", m_url, what,
+                       get_libgit2_error() }
+            .unexpected();
+    };
+
+    std::string name    = m_dst.filename().string();
+    std::string tracked = std::format("refs/remotes/{}/", name);
+
+    std::unique_ptr<git_repository, repository_destructor> store;
+    std::unique_ptr<git_remote, remote_destructor>         remote;
+
+    {
+        /* the store config and its worktree list are shared by every job */
+        std::lock_guard lock { store_mutex };
+
+        if (auto res = open_store(m_base / store_dir_name); res.has_value())
+            store = std::move(res.value());
+        else
+            return res.error().unexpected();
+
+        if (git_remote *ptr = nullptr; git_remote_lookup(&ptr, store.get(), name.c_str()) == 0)
+        {
+            remote.reset(ptr);
+            if (m_url != git_remote_url(ptr)
+                and git_remote_set_url(store.get(), name.c_str(), m_url.c_str()) != 0)
+                return fail("failed to set remote url");
+        }
+        else if (git_remote_create(&ptr, store.get(), name.c_str(), m_url.c_str()) == 0)
+            remote.reset(ptr);
+        else
+            return fail("failed to create remote");
+    }
+
+    git_remote_callbacks callbacks;
+    git_remote_init_callbacks(&callbacks, GIT_REMOTE_CALLBACKS_VERSION);
+    callbacks.transfer_progress = &cloning::transfer_progress_callback;
+    callbacks.payload           = this;
+
+    if (git_remote_connect(remote.get(), GIT_DIRECTION_FETCH, &callbacks, nullptr, nullptr) != 0)
+        return fail("failed to connect");
+
+    git_buf default_branch = GIT_BUF_INIT;
+    if (git_remote_default_branch(&default_branch, remote.get()) != 0)
+        return fail("failed to find the default branch");
+
+    std::string_view branch { default_branch.ptr, default_branch.size };
+    branch.remove_prefix(std::min(branch.size(), std::string_view { "refs/heads/" }.size()));
+    tracked += branch;
+    git_buf_dispose(&default_branch);
+
+    git_fetch_options opts;
+    git_fetch_options_init(&opts, GIT_FETCH_OPTIONS_VERSION);
+
+    opts.callbacks = callbacks;
+
+    /* packs land under names of their own, only the refs below are shared */
+    if (git_remote_download(remote.get(), nullptr, &opts) != 0) return fail("failed to fetch");
+
+    git_oid target;
+
+    {
+        /* ref locks and packed-refs of the store are taken by every job that updates tips */
+        std::lock_guard lock { store_mutex };
+
+        /* no FETCH_HEAD, it would be shared between every job */
+        if (git_remote_update_tips(remote.get(), &callbacks, 0, GIT_REMOTE_DOWNLOAD_TAGS_AUTO,
+                                   "aurgh: fetch")
+            != 0)
+            return fail("failed to update remote-tracking branches");
+
+        if (git_reference_name_to_id(&target, store.get(), tracked.c_str()) != 0)
+            return fail("failed to resolve the fetched branch");
+    }
+
+    git_remote_disconnect(remote.get());
+
+    return mf_materialize(store.get(), name, &target);
+}
+
+
+auto
+cloning::mf_materialize(git_repository *store, const std::string &name, const git_oid *target)
+    -> result<void>
+{
+    auto fail = [this](std::string_view what)
+    {
+        return error { R"(failed to materialize "{}" at "{}": {}: {})", m_url, m_dst.c_str(), what,
+                       get_libgit2_error() }
+            .unexpected();
+    };
+
+    std::unique_ptr<git_repository, repository_destructor> repo;
+
+    {
+        /* the worktree list and its admin files are shared by every job */
+        std::lock_guard lock { store_mutex };
+
+        if (git_worktree *ptr = nullptr; git_worktree_lookup(&ptr, store, name.c_str()) == 0)
+        {
+            std::unique_ptr<git_worktree, worktree_destructor> worktree { ptr };
+
+            if (git_worktree_validate(ptr) == 0)
+            {
+                if (git_repository *repo_ptr = nullptr;
+                    git_repository_open_from_worktree(&repo_ptr, worktree.get()) == 0)
+                    repo.reset(repo_ptr);
+                else
+                    return fail("failed to open worktree");
+            }
+            else
+            {
+                /* the checkout went away behind our back, forget about it */
+                git_worktree_prune_options prune;
+                git_worktree_prune_options_init(&prune, GIT_WORKTREE_PRUNE_OPTIONS_VERSION);
+                prune.flags = GIT_WORKTREE_PRUNE_VALID;
+
+                if (git_worktree_prune(worktree.get(), &prune) != 0)
+                    return fail("failed to prune stale worktree");
+            }
+        }
+    }
+
+    /* only the branch update in there takes the lock, the checkout writes inside m_dst */
+    if (repo != nullptr)
+    {
+        std::unique_ptr<git_reference, reference_destructor> head;
+
+        if (git_reference *ptr = nullptr; git_repository_head(&ptr, repo.get()) == 0)
+            head.reset(ptr);
+        else
+            return fail("failed to resolve HEAD");
+
+        return mf_fast_forward(repo.get(), head.get(), target, true);
+    }
+
+    /* a standalone clone from before the store was used */
+    if (auto res = remove_checkout(m_dst, m_base); !res) return res;
+
+    {
+        /* the branch and the worktree admin files, but not the checkout, go in under the lock */
+        std::lock_guard lock { store_mutex };
+
+        std::unique_ptr<git_object, object_destructor>       commit;
+        std::unique_ptr<git_reference, reference_destructor> branch;
+
+        if (git_object *ptr = nullptr;
+            git_object_lookup(&ptr, store, target, GIT_OBJECT_COMMIT) == 0)
+            commit.reset(ptr);
+        else
+            return fail("failed to lookup the fetched commit");
+
+        if (git_reference *ptr = nullptr;
+            git_branch_create(&ptr, store, name.c_str(),
+                              reinterpret_cast<const git_commit *>(commit.get()), 1)
+            == 0)
+            branch.reset(ptr);
+        else
+            return fail("failed to create branch");
+
+        git_worktree_add_options opts;
+        git_worktree_add_options_init(&opts, GIT_WORKTREE_ADD_OPTIONS_VERSION);
+        opts.ref                                = branch.get();
+        opts.checkout_options.checkout_strategy = GIT_CHECKOUT_NONE;
+
+        std::unique_ptr<git_worktree, worktree_destructor> worktree;
+
+        if (git_worktree *ptr = nullptr;
+            git_worktree_add(&ptr, store, name.c_str(), m_dst.c_str(), &opts) == 0)
+            worktree.reset(ptr);
+        else
+            return fail("failed to add worktree");
+
+        if (git_repository *ptr = nullptr;
+            git_repository_open_from_worktree(&ptr, worktree.get()) == 0)
+            repo.reset(ptr);
+        else
+            return fail("failed to open worktree");
+    }
+
+    /* the directory was just created empty, there is nothing of anyone's to keep */
+    git_checkout_options checkout;
+    git_checkout_options_init(&checkout, GIT_CHECKOUT_OPTIONS_VERSION);
+    checkout.checkout_strategy = GIT_CHECKOUT_FORCE;
+
+    if (git_checkout_head(repo.get(), &checkout) != 0)
+        return fail("failed to check out the worktree");
+
+    return {};
+}
+
+
+void
+cloning::mf_on_done()
+{
+    m_progress.release();
+
+    if (m_pending_error.has_value())
+        m_signal_on_error.emit(m_pending_error.value());
+    else
+        m_signal_on_completed.emit(m_dst);
+}
+
+
+auto
+cloning::transfer_progress_callback(const git_indexer_progress *stats, void *payload) -> int
+{
+    auto *self = static_cast<cloning *>(payload);
+
+    auto received = stats->total_objects == 0
+                      ? 1.0
+                      : double(stats->received_objects) / double(stats->total_objects);
+
+    self->m_progress.store(received);
+    return self->m_stop_source.stop_requested() ? -1 : 0;
+}
+
+
+auto
+aurgh::git::last_error() noexcept -> std::string_view
+{ return get_libgit2_error(); }
+
+
+auto
+aurgh::git::init() noexcept -> result<void>
+{
+    static library lib;
+
+    if (lib.status < 0)
+        return error { "failed to initialize libgit2: {}", get_libgit2_error() }.unexpected();
+    return {};
+}
+
+
+auto
+aurgh::git::repository_name(std::string_view url) noexcept -> result<std::string>
+try
+{
+    std::string_view trimmed = url;
+    while (!trimmed.empty() and trimmed.back() == '/') trimmed.remove_suffix(1);
+
+    std::size_t pos = trimmed.find_last_of("/:");
+    std::string name { pos == std::string_view::npos ? trimmed : trimmed.substr(pos + 1) };
+
+    if (name.ends_with(".git")) name.resize(name.size() - 4);
+
+    /* the name becomes a directory under the clone directory, which is cleared for it */
+    if (name.empty() or name == "." or name == ".." or name.contains('/'))
+        return error { R"("{}" does not name a repository that can be cloned)", url }
+            .unexpected();
+
+    return name;
+}
+catch (const std::exception &e)
+{
+    return error { R"(failed to name the clone of "{}": {})", url, e.what() }.unexpected();
+}
+
+
+auto
+aurgh::git::clone(std::string_view     url,
+                  std::filesystem::path base,
+                  executor             &exec,
+                  executor::priority    prio,
+                  layout                mode) noexcept -> result<std::shared_ptr<cloning>>
+try
+{
+    auto task = std::make_shared<cloning>(url, std::move(base), mode);
+
+    /* the job keeps the clone alive until it has run, a dropped one reports the cancel */
+    exec.submit([task] { task->mf_run(); }, prio,
+                [task]
+                {
+                    task->cancel();
+                    task->mf_run();
+                });
+    return task;
+}
+catch (const std::exception &e)
+{
+    return error { R"(failed to clone remote repository "{}" to "{}": {})", url, base.c_str(),
+                   e.what() }
+        .unexpected();
+}
+catch (error &e)
+{
+    return e.unexpected();
+}
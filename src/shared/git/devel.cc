@@ -0,0 +1,203 @@
+#include <fstream>
+
+#include <git2.h>
+
+#include "git.hh"
+#include "git/devel.hh"
+#include "git/remote.hh"
+#include "srcinfo.hh"
+
+using aurgh::git::devel_cache;
+using aurgh::git::vcs_source;
+
+namespace
+{
+    struct devel_state
+    {
+        bool                              outdated = false;
+        aurgh::git::devel_cache::map_type heads;
+    };
+
+
+    [[nodiscard]]
+    auto
+    check(const std::filesystem::path &clone, const devel_cache::map_type &seen)
+        -> aurgh::result<devel_state>
+    {
+        using namespace aurgh;
+
+        auto info = srcinfo::parse(clone / ".SRCINFO");
+        if (!info) return info.error().unexpected();
+
+        devel_state state;
+
+        srcinfo::reader lines = info->entries();
+        for (srcinfo::entry line; lines.next(line);)
+        {
+            if (line.key != "source" and !line.key.starts_with("source_")) continue;
+
+            std::optional<vcs_source> source;
+
+            if (auto res = vcs_source::parse(line.value); res.has_value())
+                source = std::move(res.value());
+            else
+                return res.error().unexpected();
+
+            if (!source.has_value()) continue;
+
+            std::string key = source->key(clone.filename().string());
+            if (state.heads.contains(key)) continue;
+
+            auto head = git::remote_head(source->url, source->ref);
+            if (!head) return head.error().unexpected();
+
+            std::string commit { git_oid_tostr_s(&head.value()) };
+
+            if (auto it = seen.find(key); it != seen.end() and it->second != commit)
+                state.outdated = true;
+            state.heads.emplace(std::move(key), std::move(commit));
+        }
+
+        return state;
+    }
+}
+
+
+auto
+vcs_source::parse(std::string_view source) -> result<std::optional<vcs_source>>
+{
+    using namespace std::string_view_literals;
+
+    if (std::size_t pos = source.find("::"); pos != std::string_view::npos)
+        source.remove_prefix(pos + 2);
+
+    std::size_t scheme = source.find("://");
+    std::size_t plus   = source.find('+');
+
+    if (scheme == std::string_view::npos) return std::nullopt; /* a local file */
+
+    if (plus != std::string_view::npos and plus < scheme)
+    {
+        std::string_view vcs = source.substr(0, plus);
+        if (vcs != "git")
+            return error { "{} sources cannot be checked: \"{}\"", vcs, source }.unexpected();
+        source.remove_prefix(plus + 1);
+    }
+    else if (!source.starts_with("git://"))
+        return std::nullopt;
+
+    std::string_view fragment;
+    if (std::size_t hash = source.find('#'); hash != std::string_view::npos)
+    {
+        fragment = source.substr(hash + 1);
+        source   = source.substr(0, hash);
+    }
+
+    if (source.ends_with("?signed")) source.remove_suffix("?signed"sv.size());
+    if (fragment.ends_with("?signed")) fragment.remove_suffix("?signed"sv.size());
+
+    vcs_source out { .url = std::string { source }, .ref = "HEAD" };
+
+    if (fragment.starts_with("branch="))
+        out.ref = std::format("refs/heads/{}", fragment.substr("branch="sv.size()));
+    else if (fragment.starts_with("tag="))
+        out.ref = std::format("refs/tags/{}", fragment.substr("tag="sv.size()));
+    else if (fragment.starts_with("commit="))
+        return std::nullopt; /* pinned, can never move */
+
+    return out;
+}
+
+
+auto
+devel_cache::load(std::filesystem::path path) noexcept -> result<devel_cache>
+try
+{
+    devel_cache cache;
+    cache.m_path = std::move(path);
+
+    std::ifstream stream { cache.m_path };
+    if (!stream.is_open()) return cache; /* nothing seen yet */
+
+    for (std::string key, commit; stream >> key >> commit;)
+        cache.m_commits.insert_or_assign(std::move(key), std::move(commit));
+
+    if (!stream.eof())
+        return error { "failed to read devel cache \"{}\"", cache.m_path.c_str() }.unexpected();
+    return cache;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to load devel cache \"{}\": {}", path.c_str(), e.what() }.unexpected();
+}
+
+
+auto
+devel_cache::save() const noexcept -> result<void>
+try
+{
+    std::filesystem::path tmp = m_path;
+    tmp += ".tmp";
+
+    {
+        std::ofstream stream { tmp, std::ios::trunc };
+        for (const auto &[key, commit] : m_commits) stream << key << ' ' << commit << '\n';
+
+        if (!stream.flush())
+            return error { "failed to write devel cache \"{}\"", tmp.c_str() }.unexpected();
+    }
+
+    std::filesystem::rename(tmp, m_path);
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to save devel cache \"{}\": {}", m_path.c_str(), e.what() }
+        .unexpected();
+}
+
+
+auto
+aurgh::git::find_devel_updates(std::vector<std::filesystem::path> clones,
+                               devel_cache::map_type              seen,
+                               executor                          &exec,
+                               std::size_t                         concurrency)
+    -> std::shared_ptr<request<devel_report>>
+{
+    struct batch
+    {
+        std::vector<std::filesystem::path> clones;
+        devel_cache::map_type              seen;
+        std::mutex                         mutex;
+        devel_report                       report;
+    };
+
+    auto req   = request<devel_report>::create();
+    auto state = std::make_shared<batch>();
+
+    state->clones = std::move(clones);
+    state->seen   = std::move(seen);
+
+    parallel_for(
+        exec, state->clones.size(), concurrency,
+        [state, req](std::size_t i)
+        {
+            if (req->cancelled()) return false;
+
+            const auto &clone = state->clones[i];
+            auto        res   = check(clone, state->seen);
+
+            std::lock_guard lock { state->mutex };
+            if (!res)
+                state->report.failed.emplace_back(clone, std::move(res.error()));
+            else if (!res->heads.empty())
+            {
+                if (res->outdated) state->report.outdated.emplace_back(clone);
+                state->report.heads.emplace(clone, std::move(res->heads));
+            }
+            return true;
+        },
+        [state, req] { req->complete(std::move(state->report)); });
+
+    return req;
+}
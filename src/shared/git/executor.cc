@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <optional>
+
+#include "git.hh"
+#include "git/executor.hh"
+
+using aurgh::git::executor;
+
+
+auto
+executor::create(std::size_t concurrency) noexcept -> result<std::shared_ptr<executor>>
+try
+{
+    if (auto res = git::init(); !res) return res.error().unexpected();
+    return std::shared_ptr<executor> { new executor { std::max<std::size_t>(concurrency, 1) } };
+}
+catch (const std::exception &e)
+{
+    return error { "failed to create the clone executor: {}", e.what() }.unexpected();
+}
+
+
+executor::executor(std::size_t concurrency)
+{
+    m_workers.reserve(concurrency);
+    for (std::size_t i = 0; i < concurrency; i++) m_workers.emplace_back(&executor::mf_run, this);
+}
+
+
+executor::~executor()
+{
+    std::vector<entry> dropped;
+
+    {
+        std::lock_guard lock { m_mutex };
+        m_stopping = true;
+        dropped    = std::exchange(m_queue, {});
+    }
+
+    m_cv.notify_all();
+
+    /* their owners would otherwise wait for a completion that never comes */
+    for (auto &e : dropped)
+        if (e.on_drop != nullptr) e.on_drop();
+
+    for (auto &worker : m_workers)
+        if (worker.joinable()) worker.join();
+}
+
+
+void
+executor::submit(job fn, priority prio, job on_drop)
+{
+    {
+        std::lock_guard lock { m_mutex };
+
+        m_queue.emplace_back(prio, m_sequence++, std::move(fn), std::move(on_drop));
+        std::ranges::push_heap(m_queue, &executor::before);
+    }
+
+    m_cv.notify_one();
+}
+
+
+auto
+executor::concurrency() const noexcept -> std::size_t
+{ return m_workers.size(); }
+
+
+void
+executor::mf_run()
+{
+    AURGH_TRACE_THREAD("git");
+
+    while (true)
+    {
+        std::optional<entry> next;
+
+        {
+            std::unique_lock lock { m_mutex };
+
+            m_cv.wait(lock, [this] { return m_stopping or !m_queue.empty(); });
+
+            if (m_stopping) break; /* pending jobs are dropped by the destructor */
+
+            std::ranges::pop_heap(m_queue, &executor::before);
+            next.emplace(std::move(m_queue.back()));
+            m_queue.pop_back();
+        }
+
+        AURGH_TRACE_ID_SCOPE(next->trace_id);
+        AURGH_TRACE_SPAN("git", "executor::job");
+        next->fn();
+    }
+}
+
+
+auto
+executor::before(const entry &lhs, const entry &rhs) noexcept -> bool
+{
+    /* std heaps keep the *largest* element on top */
+    if (lhs.prio != rhs.prio) return lhs.prio < rhs.prio;
+    return lhs.sequence > rhs.sequence;
+}
@@ -0,0 +1,183 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+
+#include <git2.h>
+
+#include "git.hh"
+#include "git/peek.hh"
+#include "utils.hh"
+
+namespace
+{
+    using repository_destructor = aurgh::util::destructor<git_repository, git_repository_free>;
+    using remote_destructor     = aurgh::util::destructor<git_remote, git_remote_free>;
+    using commit_destructor     = aurgh::util::destructor<git_commit, git_commit_free>;
+    using tree_destructor       = aurgh::util::destructor<git_tree, git_tree_free>;
+    using entry_destructor      = aurgh::util::destructor<git_tree_entry, git_tree_entry_free>;
+    using blob_destructor       = aurgh::util::destructor<git_blob, git_blob_free>;
+
+
+    /* a throwaway directory on tmpfs, removed with everything in it */
+    struct scratch_dir
+    {
+        std::filesystem::path path;
+
+        scratch_dir() = default;
+        scratch_dir(const scratch_dir &)                     = delete;
+        auto operator=(const scratch_dir &) -> scratch_dir & = delete;
+
+        ~scratch_dir()
+        {
+            std::error_code ec;
+            if (!path.empty()) std::filesystem::remove_all(path, ec);
+        }
+    };
+
+
+    [[nodiscard]]
+    auto
+    make_scratch_dir(scratch_dir &dir) -> aurgh::result<void>
+    {
+        const char *runtime = std::getenv("XDG_RUNTIME_DIR");
+
+        std::string tmpl = (std::filesystem::path { runtime != nullptr ? runtime : "/dev/shm" }
+                            / "aurgh-peek-XXXXXX")
+                               .string();
+
+        if (mkdtemp(tmpl.data()) == nullptr)
+            return aurgh::error { "failed to create a scratch directory: {}", std::strerror(errno) }
+                .unexpected();
+
+        dir.path = std::move(tmpl);
+        return {};
+    }
+
+
+    [[nodiscard]]
+    auto
+    read_blob(git_repository *repo, git_tree *tree, const char *path) -> aurgh::result<std::string>
+    {
+        std::unique_ptr<git_tree_entry, entry_destructor> entry;
+        std::unique_ptr<git_blob, blob_destructor>        blob;
+
+        if (git_tree_entry *ptr = nullptr; git_tree_entry_bypath(&ptr, tree, path) == 0)
+            entry.reset(ptr);
+        else
+            return aurgh::error { "\"{}\" is missing from HEAD", path }.unexpected();
+
+        if (git_blob *ptr = nullptr;
+            git_blob_lookup(&ptr, repo, git_tree_entry_id(entry.get())) == 0)
+            blob.reset(ptr);
+        else
+            return aurgh::error { "failed to read \"{}\": {}", path, aurgh::git::last_error() }
+                .unexpected();
+
+        return std::string { static_cast<const char *>(git_blob_rawcontent(blob.get())),
+                             static_cast<std::size_t>(git_blob_rawsize(blob.get())) };
+    }
+}
+
+
+auto
+aurgh::git::fetch_head_files(std::string_view url) noexcept -> result<head_files>
+try
+{
+    std::string remote_url { url };
+
+    auto fail = [&remote_url](std::string_view what)
+    {
+        return error { R"(failed to peek at "{}": {}: {})", remote_url, what, last_error() }
+            .unexpected();
+    };
+
+    /* libgit2 can only index a received pack through an on-disk pack backend,
+       so the objects go to a bare repository on tmpfs rather than a mempack */
+    scratch_dir dir;
+    if (auto res = make_scratch_dir(dir); !res) return res.error().unexpected();
+
+    std::unique_ptr<git_repository, repository_destructor> repo;
+    std::unique_ptr<git_remote, remote_destructor>         remote;
+
+    if (git_repository *ptr = nullptr; git_repository_init(&ptr, dir.path.c_str(), 1) == 0)
+        repo.reset(ptr);
+    else
+        return fail("failed to create the scratch repository");
+
+    if (git_remote *ptr = nullptr;
+        git_remote_create_anonymous(&ptr, repo.get(), remote_url.c_str()) == 0)
+        remote.reset(ptr);
+    else
+        return fail("failed to create remote");
+
+    if (git_remote_connect(remote.get(), GIT_DIRECTION_FETCH, nullptr, nullptr, nullptr) != 0)
+        return fail("failed to connect");
+
+    const git_remote_head **heads = nullptr;
+    std::size_t             count = 0;
+
+    if (git_remote_ls(&heads, &count, remote.get()) != 0) return fail("failed to list refs");
+
+    head_files files {};
+    bool       has_head = false;
+
+    for (const git_remote_head *head : std::span { heads, count })
+        if (std::string_view { head->name } == "HEAD")
+        {
+            git_oid_cpy(&files.commit, &head->oid);
+            has_head = true;
+        }
+
+    if (!has_head)
+        return error { R"(failed to peek at "{}": remote has no HEAD)", remote_url }.unexpected();
+
+    std::string  refspec { "+HEAD:refs/peek/HEAD" };
+    char        *refspec_ptr = refspec.data();
+    git_strarray refspecs { .strings = &refspec_ptr, .count = 1 };
+
+    git_fetch_options opts;
+    git_fetch_options_init(&opts, GIT_FETCH_OPTIONS_VERSION);
+    opts.depth = 1;
+
+    if (git_remote_download(remote.get(), &refspecs, &opts) != 0) return fail("failed to fetch");
+    git_remote_disconnect(remote.get());
+
+    std::unique_ptr<git_commit, commit_destructor> commit;
+    std::unique_ptr<git_tree, tree_destructor>     tree;
+
+    if (git_commit *ptr = nullptr; git_commit_lookup(&ptr, repo.get(), &files.commit) == 0)
+        commit.reset(ptr);
+    else
+        return fail("failed to lookup HEAD");
+
+    if (git_tree *ptr = nullptr; git_commit_tree(&ptr, commit.get()) == 0)
+        tree.reset(ptr);
+    else
+        return fail("failed to lookup the tree of HEAD");
+
+    if (auto res = read_blob(repo.get(), tree.get(), "PKGBUILD"); res.has_value())
+        files.pkgbuild = std::move(res.value());
+    else
+        return res.error().unexpected();
+
+    if (auto res = read_blob(repo.get(), tree.get(), ".SRCINFO"); res.has_value())
+        files.srcinfo = std::move(res.value());
+    else
+        return res.error().unexpected();
+
+    return files;
+}
+catch (const std::exception &e)
+{
+    return error { R"(failed to peek at "{}": {})", url, e.what() }.unexpected();
+}
+
+
+auto
+aurgh::git::peek(std::string_view url, executor &exec, executor::priority prio)
+    -> std::shared_ptr<request<head_files>>
+{
+    return request<head_files>::submit(exec, [url = std::string { url }]
+                                       { return fetch_head_files(url); }, prio);
+}
@@ -0,0 +1,166 @@
+#include <mutex>
+#include <optional>
+#include <span>
+
+#include <git2.h>
+
+#include "git.hh"
+#include "git/remote.hh"
+#include "utils.hh"
+
+namespace
+{
+    using repository_destructor = aurgh::util::destructor<git_repository, git_repository_free>;
+    using remote_destructor     = aurgh::util::destructor<git_remote, git_remote_free>;
+
+
+    /* standalone clones track "origin", worktrees of the shared store a remote named after them */
+    [[nodiscard]]
+    auto
+    remote_url(git_repository *repo, const std::filesystem::path &path) -> aurgh::result<std::string>
+    {
+        for (const std::string &name : { std::string { "origin" }, path.filename().string() })
+        {
+            git_remote *remote = nullptr;
+            if (git_remote_lookup(&remote, repo, name.c_str()) != 0) continue;
+
+            std::string url { git_remote_url(remote) };
+            git_remote_free(remote);
+            return url;
+        }
+
+        return aurgh::error { "\"{}\" has no remote to compare against", path.c_str() }
+            .unexpected();
+    }
+
+
+    [[nodiscard]]
+    auto
+    check(const std::filesystem::path &path) -> aurgh::result<std::optional<aurgh::git::moved_repo>>
+    {
+        std::unique_ptr<git_repository, repository_destructor> repo;
+
+        if (git_repository *ptr = nullptr;
+            git_repository_open_ext(&ptr, path.c_str(), GIT_REPOSITORY_OPEN_NO_SEARCH, nullptr)
+            == 0)
+            repo.reset(ptr);
+        else
+            return aurgh::error { "failed to open \"{}\": {}", path.c_str(),
+                                  aurgh::git::last_error() }
+                .unexpected();
+
+        aurgh::git::moved_repo moved { .path = path };
+
+        if (git_reference_name_to_id(&moved.local, repo.get(), "HEAD") != 0)
+            return aurgh::error { "failed to resolve HEAD of \"{}\": {}", path.c_str(),
+                                  aurgh::git::last_error() }
+                .unexpected();
+
+        if (auto res = remote_url(repo.get(), path); res.has_value())
+            moved.url = std::move(res.value());
+        else
+            return res.error().unexpected();
+
+        if (auto res = aurgh::git::remote_head(moved.url); res.has_value())
+            moved.remote = res.value();
+        else
+            return res.error().unexpected();
+
+        if (git_oid_cmp(&moved.local, &moved.remote) == 0) return std::nullopt;
+        return moved;
+    }
+}
+
+
+auto
+aurgh::git::remote_head(std::string_view url, std::string_view ref) noexcept -> result<git_oid>
+try
+{
+    std::string remote_url { url };
+
+    std::unique_ptr<git_remote, remote_destructor> remote;
+
+    if (git_remote *ptr = nullptr; git_remote_create_detached(&ptr, remote_url.c_str()) == 0)
+        remote.reset(ptr);
+    else
+        return error { R"(failed to create remote "{}": {})", remote_url, last_error() }
+            .unexpected();
+
+    if (git_remote_connect(remote.get(), GIT_DIRECTION_FETCH, nullptr, nullptr, nullptr) != 0)
+        return error { R"(failed to connect to "{}": {})", remote_url, last_error() }.unexpected();
+
+    const git_remote_head **heads = nullptr;
+    std::size_t             count = 0;
+
+    if (git_remote_ls(&heads, &count, remote.get()) != 0)
+        return error { R"(failed to list refs of "{}": {})", remote_url, last_error() }
+            .unexpected();
+
+    for (const git_remote_head *head : std::span { heads, count })
+        if (std::string_view { head->name } == ref) return head->oid;
+
+    return error { R"("{}" does not advertise "{}")", remote_url, ref }.unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { R"(failed to list refs of "{}": {})", url, e.what() }.unexpected();
+}
+
+
+auto
+aurgh::git::list_clones(const std::filesystem::path &clone_dir) noexcept
+    -> result<std::vector<std::filesystem::path>>
+try
+{
+    std::vector<std::filesystem::path> clones;
+
+    for (const auto &entry : std::filesystem::directory_iterator { clone_dir })
+        if (entry.is_directory() and !entry.path().filename().string().starts_with('.'))
+            clones.emplace_back(entry.path());
+
+    return clones;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to list clones in \"{}\": {}", clone_dir.c_str(), e.what() }
+        .unexpected();
+}
+
+
+auto
+aurgh::git::find_updates(std::vector<std::filesystem::path> clones,
+                         executor                          &exec,
+                         std::size_t                         concurrency)
+    -> std::shared_ptr<request<update_report>>
+{
+    struct batch
+    {
+        std::vector<std::filesystem::path> clones;
+        std::mutex                         mutex;
+        update_report                      report;
+    };
+
+    auto req   = request<update_report>::create();
+    auto state = std::make_shared<batch>();
+
+    state->clones = std::move(clones);
+
+    parallel_for(
+        exec, state->clones.size(), concurrency,
+        [state, req](std::size_t i)
+        {
+            if (req->cancelled()) return false;
+
+            auto res = check(state->clones[i]);
+
+            std::lock_guard lock { state->mutex };
+            if (!res)
+                state->report.failed.emplace_back(state->clones[i], std::move(res.error()));
+            else if (res->has_value())
+                state->report.moved.emplace_back(std::move(res->value()));
+            return true;
+        },
+        [state, req] { req->complete(std::move(state->report)); });
+
+    return req;
+}
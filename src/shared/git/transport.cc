@@ -0,0 +1,255 @@
+#include <glibmm/main.h>
+#include <git2.h>
+#include <git2/sys/transport.h>
+
+#include "git.hh"
+#include "git/transport.hh"
+#include "http/pipe.hh"
+
+namespace
+{
+    std::shared_ptr<aurgh::http::client> http_client;
+
+
+    struct subtransport
+    {
+        git_smart_subtransport parent; /* must stay first, libgit2 hands us pointers to it */
+        git_transport         *owner;
+    };
+
+
+    /* everything the main loop touches, it may outlive the stream */
+    struct exchange
+    {
+        aurgh::http::pipe                      body;
+        std::shared_ptr<aurgh::http::transfer> transfer;
+        bool                                   refused = false; /* not a 200, being cancelled */
+    };
+
+
+    struct stream
+    {
+        git_smart_subtransport_stream parent; /* must stay first */
+
+        std::string              url;
+        std::string              method;
+        std::vector<std::string> headers;
+        std::string              request_body;
+
+        std::shared_ptr<exchange> shared = std::make_shared<exchange>();
+        bool                      sent   = false;
+    };
+
+
+    auto
+    fail(std::string_view message) -> int
+    {
+        git_error_set_str(GIT_ERROR_NET, std::string { message }.c_str());
+        return -1;
+    }
+
+
+    void
+    start(stream *s)
+    {
+        Glib::MainContext::get_default()->invoke(
+            [shared = s->shared, method = s->method, url = s->url, headers = s->headers,
+             body = std::move(s->request_body)] mutable
+            {
+                auto trans = method == "POST" ? http_client->post(url, std::move(body), headers)
+                                              : http_client->get(url, headers);
+                if (!trans)
+                {
+                    shared->body.fail(std::string { trans.error().message() });
+                    return false;
+                }
+
+                shared->transfer = std::move(trans.value());
+                shared->transfer
+                    ->on_data(
+                        [exchange = shared.get()](std::string_view data)
+                        {
+                            if (exchange->refused) return;
+
+                            if (int code = exchange->transfer->response_code(); code != 200)
+                            {
+                                exchange->body.fail(std::format("server returned code {}", code));
+                                exchange->refused = true;
+
+                                /* libcurl refuses to remove handles from inside its own
+                                   callbacks */
+                                Glib::signal_idle().connect_once(
+                                    [t = exchange->transfer] { std::ignore = t->cancel(); });
+                                return;
+                            }
+
+                            exchange->body.push(data);
+                        })
+                    .on_complete(
+                        [exchange = shared.get()](aurgh::http::completion complete)
+                        {
+                            if (exchange->refused) return;
+
+                            /* a refusal without a body never reached on_data */
+                            if (complete.curl_result != CURLE_OK)
+                                exchange->body.fail(curl_easy_strerror(complete.curl_result));
+                            else if (complete.return_code != 200)
+                                exchange->body.fail(
+                                    std::format("server returned code {}", complete.return_code));
+                            else
+                                exchange->body.close();
+                        })
+                    .on_error([exchange = shared.get()](std::string_view e)
+                              { exchange->body.fail(std::string { e }); });
+                return false;
+            });
+    }
+
+
+    auto
+    stream_read(git_smart_subtransport_stream *parent,
+                char                          *buffer,
+                std::size_t                    size,
+                std::size_t                   *bytes_read) -> int
+    {
+        auto *s = reinterpret_cast<stream *>(parent);
+
+        if (!s->sent)
+        {
+            start(s);
+            s->sent = true;
+        }
+
+        auto res = s->shared->body.read(buffer, size);
+        if (!res) return fail(res.error().message());
+
+        *bytes_read = res.value();
+        return 0;
+    }
+
+
+    auto
+    stream_write(git_smart_subtransport_stream *parent, const char *buffer, std::size_t len)
+        -> int
+    {
+        auto *s = reinterpret_cast<stream *>(parent);
+
+        if (s->sent) return fail("cannot write to a request that has already been sent");
+
+        s->request_body.append(buffer, len);
+        return 0;
+    }
+
+
+    void
+    stream_free(git_smart_subtransport_stream *parent)
+    {
+        auto *s = reinterpret_cast<stream *>(parent);
+
+        if (s->sent)
+            Glib::MainContext::get_default()->invoke(
+                [shared = s->shared]
+                {
+                    if (shared->transfer != nullptr) std::ignore = shared->transfer->cancel();
+                    return false;
+                });
+
+        delete s;
+    }
+
+
+    auto
+    subtransport_action(git_smart_subtransport_stream **out,
+                        git_smart_subtransport         *parent,
+                        const char                     *url,
+                        git_smart_service_t             action) -> int
+    {
+        if (Glib::MainContext::get_default()->is_owner())
+            return fail("git transfers over the shared http client cannot run on the main loop");
+
+        auto s = std::make_unique<stream>();
+
+        s->parent.subtransport = parent;
+        s->parent.read         = stream_read;
+        s->parent.write        = stream_write;
+        s->parent.free         = stream_free;
+
+        switch (action)
+        {
+        case GIT_SERVICE_UPLOADPACK_LS:
+            s->method = "GET";
+            s->url    = std::format("{}/info/refs?service=git-upload-pack", url);
+            break;
+
+        case GIT_SERVICE_UPLOADPACK:
+            s->method  = "POST";
+            s->url     = std::format("{}/git-upload-pack", url);
+            s->headers = { "Content-Type: application/x-git-upload-pack-request",
+                           "Accept: application/x-git-upload-pack-result" };
+            break;
+
+        default: return fail("pushing is not supported by the aurgh http transport");
+        }
+
+        *out = &s.release()->parent;
+        return 0;
+    }
+
+
+    auto
+    subtransport_close(git_smart_subtransport * /* parent */) -> int
+    { return 0; }
+
+
+    void
+    subtransport_free(git_smart_subtransport *parent)
+    { delete reinterpret_cast<subtransport *>(parent); }
+
+
+    auto
+    create_subtransport(git_smart_subtransport **out, git_transport *owner, void * /* param */)
+        -> int
+    {
+        auto *sub = new subtransport {};
+
+        sub->parent.action = subtransport_action;
+        sub->parent.close  = subtransport_close;
+        sub->parent.free   = subtransport_free;
+        sub->owner         = owner;
+
+        *out = &sub->parent;
+        return 0;
+    }
+
+
+    git_smart_subtransport_definition definition { .callback = create_subtransport,
+                                                   .rpc      = 1,
+                                                   .param    = nullptr };
+
+
+    auto
+    create_transport(git_transport **out, git_remote *owner, void * /* param */) -> int
+    { return git_transport_smart(out, owner, &definition); }
+}
+
+
+auto
+aurgh::git::register_http_transport(const std::shared_ptr<http::client> &client) noexcept
+    -> result<void>
+{
+    if (auto res = init(); !res) return res.error().unexpected();
+
+    if (http_client != nullptr)
+    {
+        http_client = client;
+        return {};
+    }
+
+    http_client = client;
+
+    for (const char *scheme : { "https", "http" })
+        if (git_transport_register(scheme, create_transport, nullptr) != 0)
+            return error { "failed to register the {} transport: {}", scheme, last_error() }
+                .unexpected();
+    return {};
+}
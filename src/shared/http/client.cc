@@ -56,6 +56,12 @@ client::client() : m_multi { curl_multi_init() }
         throw error { "failed to setopt for curl-multi: {}", curl_multi_strerror(res) };
     if (res = curl_multi_setopt(m_multi, CURLMOPT_TIMERDATA, this); res != CURLM_OK)
         throw error { "failed to setopt for curl-multi: {}", curl_multi_strerror(res) };
+    if (res = curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        res != CURLM_OK)
+        throw error { "failed to setopt for curl-multi: {}", curl_multi_strerror(res) };
+    if (res = curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_host_connections);
+        res != CURLM_OK)
+        throw error { "failed to setopt for curl-multi: {}", curl_multi_strerror(res) };
 }
 
 
@@ -207,8 +213,8 @@ client::cancel(transfer &t) noexcept -> result<void>
 {
     if (t.m_client == nullptr) return {};
 
-    curl_multi_remove_handle(m_multi, t.m_client);
-    m_transfers.erase(t.m_client);
+    curl_multi_remove_handle(m_multi, t.m_easy.get());
+    m_transfers.erase(t.m_easy.get());
     t.m_easy.reset();
     t.m_client = nullptr;
 
@@ -217,22 +223,28 @@ client::cancel(transfer &t) noexcept -> result<void>
 
 
 auto
-client::get(const std::string &url) noexcept -> result<std::shared_ptr<transfer>>
-{ return mf_add_transfer(url, "GET"); }
+client::get(const std::string &url, const std::vector<std::string> &headers) noexcept
+    -> result<std::shared_ptr<transfer>>
+{ return mf_add_transfer(url, "GET", {}, headers); }
 
 
 auto
-client::post(const std::string &url, std::string body) noexcept -> result<std::shared_ptr<transfer>>
-{ return mf_add_transfer(url, "POST", std::move(body)); }
+client::post(const std::string              &url,
+             std::string                     body,
+             const std::vector<std::string> &headers) noexcept -> result<std::shared_ptr<transfer>>
+{ return mf_add_transfer(url, "POST", std::move(body), headers); }
 
 
 auto
-client::mf_add_transfer(const std::string &url, std::string_view method, std::string body) noexcept
+client::mf_add_transfer(const std::string              &url,
+                        std::string_view                method,
+                        std::string                     body,
+                        const std::vector<std::string> &headers) noexcept
     -> result<std::shared_ptr<transfer>>
 try
 {
     std::shared_ptr<transfer> trans {
-        new transfer { this, method, url, std::move(body) }
+        new transfer { this, method, url, std::move(body), headers }
     };
 
     if (CURLMcode res = curl_multi_add_handle(m_multi, trans->m_easy.get()); res != CURLM_OK)
@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cstring>
+
+#include "http/pipe.hh"
+
+using aurgh::http::pipe;
+
+
+void
+pipe::push(std::string_view data)
+{
+    if (data.empty()) return;
+
+    {
+        std::lock_guard lock { m_mutex };
+        m_chunks.emplace_back(data);
+    }
+
+    m_cv.notify_one();
+}
+
+
+void
+pipe::close()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_closed = true;
+    }
+
+    m_cv.notify_all();
+}
+
+
+void
+pipe::fail(std::string message)
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_error  = std::move(message);
+        m_closed = true;
+    }
+
+    m_cv.notify_all();
+}
+
+
+auto
+pipe::read(char *buffer, std::size_t size) -> result<std::size_t>
+{
+    std::unique_lock lock { m_mutex };
+
+    m_cv.wait(lock, [this] { return m_closed or !m_chunks.empty(); });
+
+    if (m_error.has_value()) return error { "{}", *m_error }.unexpected();
+    if (m_chunks.empty()) return 0;
+
+    const std::string &chunk = m_chunks.front();
+    std::size_t        count = std::min(size, chunk.size() - m_offset);
+
+    std::memcpy(buffer, chunk.data() + m_offset, count);
+
+    if ((m_offset += count) == chunk.size())
+    {
+        m_chunks.pop_front();
+        m_offset = 0;
+    }
+
+    return count;
+}
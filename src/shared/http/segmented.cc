@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <ranges>
+
+#include <fcntl.h>
+#include <glibmm/main.h>
+#include <unistd.h>
+
+#include "http/segmented.hh"
+
+using aurgh::http::segmented;
+
+namespace
+{
+    [[nodiscard]]
+    auto
+    write_at(int fd, std::string_view data, curl_off_t offset) -> bool
+    {
+        while (!data.empty())
+        {
+            ssize_t n = ::pwrite(fd, data.data(), data.size(), offset);
+            if (n == -1 and errno == EINTR) continue;
+            if (n <= 0) return false;
+
+            data.remove_prefix(std::size_t(n));
+            offset += n;
+        }
+
+        return true;
+    }
+
+
+    [[nodiscard]]
+    auto
+    seconds_since(std::chrono::steady_clock::time_point then) -> double
+    { return std::chrono::duration<double>(std::chrono::steady_clock::now() - then).count(); }
+}
+
+
+segmented::segmented(std::shared_ptr<client> http,
+                     std::vector<std::string> urls,
+                     int                      fd,
+                     curl_off_t               size)
+    : m_http { std::move(http) }, m_fd { fd }, m_size { size }
+{
+    m_mirrors.reserve(urls.size());
+    for (auto &url : urls) m_mirrors.emplace_back(mirror { .url = std::move(url) });
+
+    for (curl_off_t begin = 0; begin < size; begin += chunk_size)
+        m_chunks.emplace_back(chunk { .begin = begin, .end = std::min(begin + chunk_size, size) });
+}
+
+
+auto
+segmented::start(const std::shared_ptr<client> &http,
+                 std::vector<std::string>       urls,
+                 int                            fd,
+                 curl_off_t                     size) noexcept -> result<std::shared_ptr<segmented>>
+try
+{
+    if (urls.empty()) return error { "no mirror to download from" }.unexpected();
+    if (size <= 0) return error { "cannot split a download of unknown size" }.unexpected();
+
+    /* every chunk lands inside the file, and a full disk shows up now instead of halfway */
+    if (int err = posix_fallocate(fd, 0, size); err != 0)
+    {
+        if (err != EOPNOTSUPP and err != EINVAL)
+            return error { "failed to allocate {} bytes: {}", size, std::strerror(err) }
+                .unexpected();
+
+        if (ftruncate(fd, size) == -1)
+            return error { "failed to resize to {} bytes: {}", size, std::strerror(errno) }
+                .unexpected();
+    }
+
+    std::shared_ptr<segmented> self { new segmented { http, std::move(urls), fd, size } };
+    std::weak_ptr<segmented>   weak = self;
+
+    /* the caller connects its signals before anything can fire */
+    Glib::signal_idle().connect_once(
+        [weak]
+        {
+            if (auto s = weak.lock(); s != nullptr) s->mf_dispatch();
+        });
+
+    self->m_check = Glib::signal_timeout().connect(
+        [weak]
+        {
+            auto s = weak.lock();
+            if (s == nullptr) return false;
+
+            s->mf_check();
+            return true;
+        },
+        check_interval.count());
+
+    return self;
+}
+catch (const std::exception &e)
+{
+    return error { "failed to start a segmented download: {}", e.what() }.unexpected();
+}
+
+
+auto
+segmented::on_progress(const progress_signal::slot_type &slot) -> segmented &
+{
+    m_signal_on_progress.connect(slot);
+    return *this;
+}
+
+
+auto
+segmented::on_complete(const complete_signal::slot_type &slot) -> segmented &
+{
+    m_signal_on_complete.connect(slot);
+    return *this;
+}
+
+
+auto
+segmented::on_error(const error_signal::slot_type &slot) -> segmented &
+{
+    m_signal_on_error.connect(slot);
+    return *this;
+}
+
+
+void
+segmented::cancel()
+{
+    if (m_settled) return;
+    m_settled = true;
+
+    m_check.disconnect();
+    for (auto &c : m_chunks) mf_retire(c);
+}
+
+
+auto
+segmented::contiguous() const noexcept -> curl_off_t
+{
+    curl_off_t done = 0;
+
+    for (const auto &c : m_chunks)
+    {
+        done = c.begin + c.written;
+        if (done != c.end) break;
+    }
+
+    return done;
+}
+
+
+void
+segmented::mf_dispatch()
+{
+    for (std::size_t i = 0; i < m_chunks.size() and m_running < connections and !m_settled; i++)
+    {
+        const auto &c = m_chunks[i];
+        if (c.active == nullptr and c.begin + c.written < c.end) mf_start_chunk(i, none);
+    }
+}
+
+
+void
+segmented::mf_start_chunk(std::size_t index, std::size_t avoid)
+{
+    auto &c = m_chunks[index];
+
+    for (;;)
+    {
+        std::size_t m = mf_pick_mirror(avoid);
+        if (m == none) return mf_fail("every mirror failed");
+
+        auto res = m_http->get(
+            m_mirrors[m].url,
+            { std::format("Range: bytes={}-{}", c.begin + c.written, c.end - 1) });
+
+        if (!res)
+        {
+            m_mirrors[m].failures++;
+            continue;
+        }
+
+        c.active    = std::move(res.value());
+        c.mirror    = m;
+        c.started   = clock::now();
+        c.last_data = c.started;
+        c.received  = 0;
+        m_running++;
+
+        /* the transfer owns these slots, so it is only named, never held, from them */
+        std::weak_ptr<segmented> weak = weak_from_this();
+        transfer                *t    = c.active.get();
+
+        c.active
+            ->on_data(
+                [weak, index, t](std::string_view data)
+                {
+                    if (auto s = weak.lock(); s != nullptr) s->mf_chunk_data(index, t, data);
+                })
+            .on_complete(
+                [weak, index, t](completion done)
+                {
+                    if (auto s = weak.lock(); s != nullptr)
+                        s->mf_chunk_done(index, t, done.return_code == 206);
+                })
+            .on_error(
+                [weak, index, t](std::string_view)
+                {
+                    if (auto s = weak.lock(); s != nullptr) s->mf_chunk_done(index, t, false);
+                });
+        return;
+    }
+}
+
+
+void
+segmented::mf_chunk_data(std::size_t index, const transfer *t, std::string_view data)
+{
+    auto &c = m_chunks[index];
+    if (m_settled or c.active.get() != t) return;
+
+    /* a server ignoring the Range header would write the start of the file over the chunk */
+    if (t->response_code() != 206)
+    {
+        m_mirrors[c.mirror].failures = max_mirror_failures;
+        mf_retire(c);
+
+        /* libcurl refuses new handles from inside its own callbacks */
+        Glib::signal_idle().connect_once(
+            [weak = weak_from_this()]
+            {
+                if (auto s = weak.lock(); s != nullptr) s->mf_dispatch();
+            });
+        return;
+    }
+
+    data = data.substr(0, std::size_t(c.end - c.begin - c.written));
+
+    if (!write_at(m_fd, data, c.begin + c.written))
+        return mf_fail(std::format("failed to write a chunk: {}", std::strerror(errno)));
+
+    auto n = curl_off_t(data.size());
+    c.written += n;
+    c.received += n;
+    c.last_data = clock::now();
+    m_written += n;
+
+    m_signal_on_progress.emit(double(m_written) / double(m_size));
+}
+
+
+void
+segmented::mf_chunk_done(std::size_t index, const transfer *t, bool ok)
+{
+    auto &c = m_chunks[index];
+    if (m_settled or c.active.get() != t) return;
+
+    /* what did arrive is kept, the rest goes back to the queue */
+    if (!ok or c.begin + c.written != c.end) m_mirrors[c.mirror].failures++;
+    mf_retire(c);
+
+    auto whole = [](const chunk &ch) { return ch.begin + ch.written == ch.end; };
+
+    if (std::ranges::all_of(m_chunks, whole))
+    {
+        m_settled = true;
+        m_check.disconnect();
+        m_signal_on_complete.emit();
+        return;
+    }
+
+    mf_dispatch();
+}
+
+
+void
+segmented::mf_check()
+{
+    if (m_settled) return;
+
+    /* a fresh connection has not had the time to show its speed yet */
+    double settle = 2 * std::chrono::duration<double>(check_interval).count();
+
+    auto started_long_ago = [settle](const chunk &c)
+    { return c.active != nullptr and seconds_since(c.started) >= settle; };
+
+    auto rate_of = [](const chunk &c) { return double(c.received) / seconds_since(c.started); };
+
+    std::vector<double> rates;
+    for (const auto &c : m_chunks | std::views::filter(started_long_ago))
+        rates.emplace_back(rate_of(c));
+
+    /* a single chunk has nothing to be compared with */
+    double median = 0;
+    if (rates.size() >= 2)
+    {
+        auto mid = rates.begin() + std::ptrdiff_t(rates.size() / 2);
+        std::ranges::nth_element(rates, mid);
+        median = *mid;
+    }
+
+    for (std::size_t i = 0; i < m_chunks.size() and !m_settled; i++)
+    {
+        auto &c = m_chunks[i];
+        if (!started_long_ago(c)) continue;
+
+        bool stalled = seconds_since(c.last_data) >= double(stall_timeout.count());
+        bool slow    = rate_of(c) < median * slow_ratio;
+        if (!stalled and !slow) continue;
+
+        std::size_t from = c.mirror;
+
+        /* a slow mirror is still better than none, a stalled connection is not */
+        bool elsewhere = std::ranges::any_of(
+            std::views::iota(std::size_t { 0 }, m_mirrors.size()),
+            [&](std::size_t m)
+            { return m != from and m_mirrors[m].failures < max_mirror_failures; });
+
+        if (!stalled and !elsewhere) continue;
+        if (stalled) m_mirrors[from].failures++;
+
+        mf_retire(c);
+        mf_start_chunk(i, from);
+    }
+}
+
+
+void
+segmented::mf_retire(chunk &c)
+{
+    if (c.active == nullptr) return;
+
+    auto t = std::exchange(c.active, nullptr);
+    m_running--;
+
+    /* libcurl refuses to remove handles from inside its own callbacks */
+    Glib::signal_idle().connect_once([t] { std::ignore = t->cancel(); });
+}
+
+
+void
+segmented::mf_fail(std::string_view message)
+{
+    if (m_settled) return;
+
+    cancel();
+    m_signal_on_error.emit(message);
+}
+
+
+auto
+segmented::mf_pick_mirror(std::size_t avoid) -> std::size_t
+{
+    std::size_t fallback = none;
+
+    for (std::size_t n = 0; n < m_mirrors.size(); n++)
+    {
+        std::size_t m = (m_next_mirror + n) % m_mirrors.size();
+        if (m_mirrors[m].failures >= max_mirror_failures) continue;
+
+        if (m == avoid)
+        {
+            fallback = m;
+            continue;
+        }
+
+        m_next_mirror = m + 1;
+        return m;
+    }
+
+    return fallback;
+}
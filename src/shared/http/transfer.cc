@@ -0,0 +1,156 @@
+#include "http/client.hh"
+#include "http/transfer.hh"
+
+using aurgh::http::transfer;
+
+
+transfer::transfer(class client                   *client,
+                   std::string_view                method,
+                   const std::string              &url,
+                   std::string                     body,
+                   const std::vector<std::string> &headers)
+    : m_client { client }, m_easy { curl_easy_init() }, m_request_body { std::move(body) },
+      m_span { "http", "transfer", url }
+{
+    if (m_easy == nullptr) throw error { "failed to create a curl-easy handle" };
+
+    auto set = [&](CURLoption opt, auto &&param)
+    {
+        if (auto res = curl_easy_setopt(m_easy.get(), opt, param); res != CURLE_OK)
+            throw error { "failed to setopt for curl-easy {}", curl_easy_strerror(res) };
+    };
+
+    set(CURLOPT_URL, url.c_str());
+    set(CURLOPT_WRITEFUNCTION, &write_callback);
+    set(CURLOPT_WRITEDATA, this);
+    set(CURLOPT_PRIVATE, this);
+
+    if (method == "POST")
+    {
+        set(CURLOPT_POSTFIELDS, m_request_body.c_str());
+        set(CURLOPT_POSTFIELDSIZE, m_request_body.size());
+    }
+
+    for (const auto &header : headers)
+    {
+        curl_slist *list = curl_slist_append(m_headers.get(), header.c_str());
+        if (list == nullptr) throw error { "failed to append header \"{}\"", header };
+
+        std::ignore = m_headers.release();
+        m_headers.reset(list);
+    }
+
+    if (m_headers != nullptr) set(CURLOPT_HTTPHEADER, m_headers.get());
+}
+
+
+auto
+transfer::write_callback(char *ptr, std::size_t size, std::size_t nmemb, void *data) -> std::size_t
+{
+    static_cast<transfer *>(data)->m_signal_on_data({ ptr, size * nmemb });
+    return size * nmemb;
+}
+
+
+auto
+transfer::on_data(const data_signal::slot_type &slot) -> transfer &
+{
+    m_signal_on_data.connect(slot);
+    return *this;
+}
+
+
+auto
+transfer::on_complete(const complete_signal::slot_type &slot) -> transfer &
+{
+    m_signal_on_complete.connect(slot);
+    return *this;
+}
+
+
+auto
+transfer::on_error(const error_signal::slot_type &slot) -> transfer &
+{
+    m_signal_on_error.connect(slot);
+    return *this;
+}
+
+
+auto
+transfer::response_code() const noexcept -> int
+{
+    long status = 0;
+    if (m_easy != nullptr) curl_easy_getinfo(m_easy.get(), CURLINFO_RESPONSE_CODE, &status);
+    return int(status);
+}
+
+
+auto
+transfer::content_length() const noexcept -> curl_off_t
+{
+    curl_off_t length = -1;
+    if (m_easy != nullptr)
+        curl_easy_getinfo(m_easy.get(), CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+    return length;
+}
+
+
+auto
+transfer::measured() const noexcept -> timings
+{
+    curl_off_t connect = 0, first_byte = 0, total = 0, bytes = 0;
+
+    if (m_easy != nullptr)
+    {
+        curl_easy_getinfo(m_easy.get(), CURLINFO_CONNECT_TIME_T, &connect);
+        curl_easy_getinfo(m_easy.get(), CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+        curl_easy_getinfo(m_easy.get(), CURLINFO_TOTAL_TIME_T, &total);
+        curl_easy_getinfo(m_easy.get(), CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+    }
+
+    return timings { .connect    = std::chrono::microseconds { connect },
+                     .first_byte = std::chrono::microseconds { first_byte },
+                     .total      = std::chrono::microseconds { total },
+                     .bytes      = bytes };
+}
+
+
+auto
+transfer::header(const std::string &name) const noexcept -> std::optional<std::string>
+{
+    curl_header *h = nullptr;
+
+    if (m_easy == nullptr
+        or curl_easy_header(m_easy.get(), name.c_str(), 0, CURLH_HEADER, -1, &h) != CURLHE_OK)
+        return std::nullopt;
+
+    return std::string { h->value };
+}
+
+
+auto
+transfer::cancel() noexcept -> result<void>
+{
+    if (m_client != nullptr and m_easy != nullptr) return m_client->cancel(*this);
+    return {};
+}
+
+void
+transfer::complete(CURLcode code)
+{
+    m_span.end();
+
+    if (code != CURLE_OK)
+    {
+        m_signal_on_error.emit(curl_easy_strerror(code));
+        return;
+    }
+
+    long status = 0;
+    curl_easy_getinfo(m_easy.get(), CURLINFO_RESPONSE_CODE, &status);
+
+    m_signal_on_complete.emit(completion {
+        .curl_result = code,
+        .return_code = int(status),
+    });
+}
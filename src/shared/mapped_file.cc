@@ -0,0 +1,80 @@
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.hh"
+
+using aurgh::mapped_file;
+
+
+auto
+mapped_file::open(const std::filesystem::path &path) noexcept -> result<mapped_file>
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return error { "failed to open \"{}\": {}", path.c_str(), std::strerror(errno) }
+            .unexpected();
+
+    auto res = map(fd);
+    close(fd);
+
+    if (!res)
+        return error { "failed to map \"{}\": {}", path.c_str(), res.error().message() }
+            .unexpected();
+
+    if (res->m_data != nullptr) madvise(res->m_data, res->m_size, MADV_SEQUENTIAL);
+    return res;
+}
+
+
+auto
+mapped_file::map(int fd) noexcept -> result<mapped_file>
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1) return error { "fstat: {}", std::strerror(errno) }.unexpected();
+
+    /* mmap refuses empty mappings, an empty view is what the caller wants anyway */
+    if (st.st_size == 0) return mapped_file { nullptr, 0 };
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) return error { "mmap: {}", std::strerror(errno) }.unexpected();
+
+    return mapped_file { data, static_cast<std::size_t>(st.st_size) };
+}
+
+
+mapped_file::mapped_file(void *data, std::size_t size) noexcept : m_data { data }, m_size { size }
+{
+}
+
+
+mapped_file::~mapped_file()
+{
+    if (m_data != nullptr) munmap(m_data, m_size);
+}
+
+
+mapped_file::mapped_file(mapped_file &&other) noexcept
+    : m_data { std::exchange(other.m_data, nullptr) }, m_size { std::exchange(other.m_size, 0) }
+{
+}
+
+
+auto
+mapped_file::operator=(mapped_file &&other) noexcept -> mapped_file &
+{
+    if (this != &other)
+    {
+        if (m_data != nullptr) munmap(m_data, m_size);
+
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+
+    return *this;
+}
@@ -0,0 +1,166 @@
+#include <array>
+#include <atomic>
+#include <utility>
+
+#include <glibmm/main.h>
+
+#include "progress.hh"
+
+namespace progress = aurgh::progress;
+using progress::slot;
+
+
+namespace
+{
+    enum class state : std::uint8_t
+    {
+        free,
+        claimed, /* being set up by acquire() */
+        active,
+        closing, /* released off the main loop, freed on the next frame */
+    };
+
+
+    struct cell
+    {
+        std::atomic<state>  status { state::free };
+        std::atomic<double> value { 0.0 };
+        std::atomic<bool>   dirty { false };
+
+        /* written before status becomes active, only read on the main loop */
+        progress::listener fn;
+    };
+
+
+    std::array<cell, progress::max_slots> cells;
+    std::atomic<bool>                     ticking { false };
+
+
+    auto
+    any_held() noexcept -> bool
+    {
+        for (const auto &c : cells)
+            if (c.status.load(std::memory_order_acquire) != state::free) return true;
+        return false;
+    }
+
+
+    void
+    deliver(cell &c)
+    {
+        if (c.dirty.exchange(false, std::memory_order_acquire))
+            c.fn(c.value.load(std::memory_order_relaxed));
+    }
+
+
+    void
+    free_cell(cell &c)
+    {
+        deliver(c);
+        c.fn = nullptr;
+        c.status.store(state::free, std::memory_order_release);
+    }
+
+
+    auto
+    tick() -> bool
+    {
+        for (auto &c : cells)
+            switch (c.status.load(std::memory_order_acquire))
+            {
+            case state::active:  deliver(c); break;
+            case state::closing: free_cell(c); break;
+            default:             break;
+            }
+
+        if (any_held()) return true;
+
+        /* a slot acquired between the scan and here saw the timer still running */
+        ticking.store(false, std::memory_order_release);
+        return any_held() && !ticking.exchange(true, std::memory_order_acq_rel);
+    }
+
+
+    void
+    start_ticking()
+    {
+        if (ticking.exchange(true, std::memory_order_acq_rel)) return;
+
+        Glib::MainContext::get_default()->signal_timeout().connect(
+            &tick, progress::frame_interval.count());
+    }
+}
+
+
+slot::slot(std::size_t index) noexcept : m_index { index } {}
+
+
+slot::~slot()
+{ release(); }
+
+
+slot::slot(slot &&other) noexcept : m_index { std::exchange(other.m_index, npos) } {}
+
+
+auto
+slot::operator=(slot &&other) noexcept -> slot &
+{
+    if (this != &other)
+    {
+        release();
+        m_index = std::exchange(other.m_index, npos);
+    }
+    return *this;
+}
+
+
+void
+slot::store(double value) noexcept
+{
+    if (m_index == npos) return;
+
+    cells[m_index].value.store(value, std::memory_order_relaxed);
+    cells[m_index].dirty.store(true, std::memory_order_release);
+}
+
+
+void
+slot::release() noexcept
+{
+    if (m_index == npos) return;
+
+    auto &c = cells[std::exchange(m_index, npos)];
+
+    if (Glib::MainContext::get_default()->is_owner())
+        free_cell(c);
+    else
+        c.status.store(state::closing, std::memory_order_release);
+}
+
+
+auto
+progress::acquire(listener fn) noexcept -> result<slot>
+try
+{
+    for (std::size_t i = 0; i < cells.size(); i++)
+    {
+        auto expected = state::free;
+        if (!cells[i].status.compare_exchange_strong(expected, state::claimed,
+                                                     std::memory_order_acquire))
+            continue;
+
+        cells[i].fn = std::move(fn);
+        cells[i].value.store(0.0, std::memory_order_relaxed);
+        cells[i].dirty.store(false, std::memory_order_relaxed);
+        cells[i].status.store(state::active, std::memory_order_release);
+
+        start_ticking();
+        return slot { i };
+    }
+
+    return error { "all {} progress slots are in use", max_slots }.unexpected();
+}
+catch (const std::exception &e)
+{
+    return error { "failed to acquire a progress slot: {}", e.what() }.unexpected();
+}
@@ -0,0 +1,297 @@
+#include <array>
+#include <ranges>
+
+#include <sys/utsname.h>
+
+#include "srcinfo.hh"
+#include "utils.hh"
+
+using aurgh::srcinfo;
+
+namespace
+{
+    [[nodiscard]]
+    auto
+    host_arch() -> std::string_view
+    {
+        static const std::string arch = []
+        {
+            struct utsname un;
+            return uname(&un) == 0 ? std::string { un.machine } : std::string {};
+        }();
+
+        return arch;
+    }
+
+
+    /* "depends_x86_64" is "depends" for x86_64 only, keys themselves never contain '_' */
+    [[nodiscard]]
+    auto
+    resolve_key(std::string_view key, std::string_view arch) noexcept -> std::string_view
+    {
+        std::size_t pos = key.find('_');
+        if (pos == std::string_view::npos) return key;
+        return key.substr(pos + 1) == arch ? key.substr(0, pos) : std::string_view {};
+    }
+
+
+    /* keys that may appear more than once, a package section replaces them as a whole */
+    constexpr std::array<std::string_view, 5> array_keys { "license", "depends", "makedepends",
+                                                           "checkdepends", "optdepends" };
+}
+
+
+auto
+srcinfo::reader::next(entry &out) noexcept -> bool
+{
+    while (!m_rest.empty())
+    {
+        std::size_t      end = m_rest.find('\n');
+        std::string_view line { m_rest.substr(0, end) };
+
+        m_rest.remove_prefix(end == std::string_view::npos ? m_rest.size() : end + 1);
+        m_line_num++;
+
+        std::string_view trimmed { line | views::trim };
+        if (trimmed.empty() or trimmed.starts_with('#')) continue;
+
+        out.line_num = m_line_num;
+
+        if (std::size_t eq = trimmed.find('='); eq == std::string_view::npos)
+        {
+            out.key   = trimmed;
+            out.value = {};
+        }
+        else
+        {
+            out.key   = std::string_view { trimmed.substr(0, eq) | views::trim };
+            out.value = std::string_view { trimmed.substr(eq + 1) | views::trim };
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+
+auto
+srcinfo::parse(const std::filesystem::path &path) noexcept -> result<srcinfo>
+try
+{
+    auto file = mapped_file::open(path);
+    if (!file) return file.error().unexpected();
+
+    reader           lines { file->view() };
+    entry            line;
+    std::string_view pkgbase;
+
+    while (lines.next(line))
+    {
+        if (line.value.data() == nullptr) /* no '=' at all */
+            return error { "parsing error at {}:{}: expected `key = value`", path.c_str(),
+                           line.line_num }
+                .unexpected();
+
+        if (pkgbase.empty())
+        {
+            if (line.key != "pkgbase")
+                return error { "parsing error at {}:{}: the first entry must be pkgbase",
+                               path.c_str(), line.line_num }
+                    .unexpected();
+            pkgbase = line.value;
+        }
+    }
+
+    if (pkgbase.empty())
+        return error { "\"{}\" does not describe any package", path.c_str() }.unexpected();
+
+    auto modified = std::chrono::clock_cast<std::chrono::system_clock>(
+        std::filesystem::last_write_time(path));
+
+    return srcinfo { std::move(file.value()), pkgbase,
+                     std::chrono::duration_cast<std::chrono::seconds>(
+                         modified.time_since_epoch()) };
+}
+catch (const std::exception &e)
+{
+    return error { "failed to parse \"{}\": {}", path.c_str(), e.what() }.unexpected();
+}
+
+
+srcinfo::srcinfo(mapped_file &&file, std::string_view pkgbase, std::chrono::seconds last_updated)
+    : m_file { std::move(file) }, m_pkgbase { pkgbase }, m_last_updated { last_updated }
+{
+}
+
+
+auto
+srcinfo::pkgnames() const -> std::vector<std::string_view>
+{
+    std::vector<std::string_view> names;
+
+    reader lines = entries();
+    for (entry line; lines.next(line);)
+        if (line.key == "pkgname") names.emplace_back(line.value);
+
+    return names;
+}
+
+
+template <typename F>
+auto
+srcinfo::mf_walk(std::string_view name, std::string_view arch, F &&apply) const -> bool
+{
+    enum class section : std::uint8_t
+    {
+        base,
+        target,
+        other,
+    };
+
+    if (arch.empty()) arch = host_arch();
+
+    /* the package section replaces the base's plain key and its _<arch> variant apart, so
+       each array key has two flags: [2 * index] plain, [2 * index + 1] arch specific */
+    std::array<bool, 2 * array_keys.size()> replaced {};
+
+    auto flag = [&replaced](const entry &line, std::string_view key) -> bool *
+    {
+        const auto *it = std::ranges::find(array_keys, key);
+        if (it == array_keys.end()) return nullptr;
+
+        auto index = 2 * std::size_t(std::distance(array_keys.begin(), it));
+        return &replaced[index + (line.key != key ? 1 : 0)];
+    };
+
+    section current = section::base;
+    bool    found   = false;
+
+    reader scan = entries();
+    for (entry line; scan.next(line);)
+    {
+        if (line.key == "pkgname")
+        {
+            current = line.value == name ? section::target : section::other;
+            found |= current == section::target;
+            continue;
+        }
+
+        if (current != section::target) continue;
+
+        std::string_view key = resolve_key(line.key, arch);
+        if (key.empty()) continue;
+
+        if (bool *f = flag(line, key); f != nullptr) *f = true;
+    }
+
+    if (!found) return false;
+    current = section::base;
+
+    reader lines = entries();
+    for (entry line; lines.next(line);)
+    {
+        if (line.key == "pkgname")
+        {
+            current = line.value == name ? section::target : section::other;
+            continue;
+        }
+
+        if (current == section::other) continue;
+
+        std::string_view key = resolve_key(line.key, arch);
+        if (key.empty()) continue;
+
+        if (bool *f = flag(line, key); current == section::base and f != nullptr and *f)
+            continue;
+
+        apply(key, line.value);
+    }
+
+    return found;
+}
+
+
+auto
+srcinfo::get_package(std::string_view name, std::string_view arch) const -> result<package>
+{
+    package          pkg { .name = std::string { name },
+                           .repo = "aur",
+                           .base = std::string { m_pkgbase } };
+    std::string_view epoch;
+    std::string_view pkgver;
+    std::string_view pkgrel;
+
+    bool found = mf_walk(name, arch,
+                         [&](std::string_view key, std::string_view value)
+                         {
+                             if (key == "pkgdesc") pkg.description = std::string { value };
+                             if (key == "epoch") epoch = value;
+                             if (key == "pkgver") pkgver = value;
+                             if (key == "pkgrel") pkgrel = value;
+                         });
+
+    if (!found)
+        return error { "package \"{}\" is not part of \"{}\"", name, m_pkgbase }.unexpected();
+
+    pkg.version = epoch.empty() ? std::format("{}-{}", pkgver, pkgrel)
+                                : std::format("{}:{}-{}", epoch, pkgver, pkgrel);
+    return pkg;
+}
+
+
+auto
+srcinfo::get_details(std::string_view name, std::string_view arch) const
+    -> result<package_details>
+{
+    package_details details { .last_updated = m_last_updated, .base = std::string { m_pkgbase } };
+
+    auto push = [](std::vector<std::string> &list, std::string_view value)
+    {
+        if (!value.empty()) list.emplace_back(value);
+    };
+
+    bool found = mf_walk(name, arch,
+                         [&](std::string_view key, std::string_view value)
+                         {
+                             if (key == "url") details.url = value;
+                             if (key == "license") push(details.licenses, value);
+                             if (key == "depends") push(details.depends, value);
+                             if (key == "makedepends") push(details.make_depends, value);
+                             if (key == "optdepends") push(details.opt_depends, value);
+                         });
+
+    if (!found)
+        return error { "package \"{}\" is not part of \"{}\"", name, m_pkgbase }.unexpected();
+    return details;
+}
+
+
+auto
+srcinfo::packages(std::string_view arch) const -> result<std::vector<package>>
+{
+    std::vector<package> out;
+
+    for (std::string_view name : pkgnames())
+        if (auto res = get_package(name, arch); res.has_value())
+            out.emplace_back(std::move(res.value()));
+        else
+            return res.error().unexpected();
+
+    return out;
+}
+
+
+auto
+srcinfo::details(std::string_view arch) const -> result<std::vector<package_details>>
+{
+    std::vector<package_details> out;
+
+    for (std::string_view name : pkgnames())
+        if (auto res = get_details(name, arch); res.has_value())
+            out.emplace_back(std::move(res.value()));
+        else
+            return res.error().unexpected();
+
+    return out;
+}
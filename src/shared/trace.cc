@@ -0,0 +1,376 @@
+#ifdef AURGH_TRACING
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <unistd.h>
+
+#include "trace.hh"
+
+namespace trace = aurgh::trace;
+
+namespace
+{
+    struct event
+    {
+        const char   *category;
+        const char   *name;
+        std::uint64_t id;
+        std::int64_t  begin;    /* nanoseconds on the steady clock */
+        std::int64_t  duration; /* -1 for an instant */
+        std::uint32_t tid;
+
+        std::uint8_t detail_size;
+        char         detail[trace::detail_capacity];
+    };
+
+
+    /* a seqlock: odd while the event is being written, so that a reader can tell a torn one */
+    struct slot
+    {
+        std::atomic<std::uint64_t> sequence = 0;
+        event                      e;
+    };
+
+
+    /* written only by its own thread; write may read it while the thread still records,
+       at exit too, and skips the slots that change under it */
+    struct ring
+    {
+        std::uint32_t            tid;
+        std::string              name;
+        std::atomic<std::size_t> head = 0;
+        std::vector<slot>        slots;
+
+
+        explicit ring(std::uint32_t tid) : tid { tid }, slots(trace::ring_capacity) {}
+    };
+
+
+    std::atomic<bool>          enabled_flag = false;
+    std::atomic<std::uint64_t> last_id      = 0;
+    std::atomic<std::uint32_t> last_tid     = 0;
+    std::filesystem::path      output;
+
+    /* rings outlive their threads, so that a worker that is gone still shows up */
+    std::mutex                         rings_mutex;
+    std::vector<std::shared_ptr<ring>> rings;
+
+    thread_local std::shared_ptr<ring> local;
+    thread_local std::uint64_t         local_id = 0;
+
+
+    [[nodiscard]]
+    auto
+    now() -> std::int64_t
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+
+    /* the only lock after init, taken once per thread */
+    [[nodiscard]]
+    auto
+    local_ring() -> ring &
+    {
+        if (local == nullptr)
+        {
+            local = std::make_shared<ring>(++last_tid);
+
+            std::lock_guard lock { rings_mutex };
+            rings.emplace_back(local);
+        }
+
+        return *local;
+    }
+
+
+    void
+    record(const event &e)
+    {
+        ring       &r    = local_ring();
+        std::size_t head = r.head.load(std::memory_order_relaxed);
+        slot       &s    = r.slots[head % trace::ring_capacity];
+
+        std::uint64_t sequence = s.sequence.load(std::memory_order_relaxed);
+        s.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        s.e = e;
+
+        s.sequence.store(sequence + 2, std::memory_order_release);
+        r.head.store(head + 1, std::memory_order_release);
+    }
+
+
+    /* false when the slot was being written or got overwritten while it was copied */
+    [[nodiscard]]
+    auto
+    read(const slot &s, event &out) -> bool
+    {
+        std::uint64_t before = s.sequence.load(std::memory_order_acquire);
+        if (before % 2 != 0) return false;
+
+        out = s.e;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return s.sequence.load(std::memory_order_relaxed) == before;
+    }
+
+
+    [[nodiscard]]
+    auto
+    copy_detail(std::string_view detail, char (&to)[trace::detail_capacity]) -> std::uint8_t
+    {
+        std::size_t n = std::min(detail.size(), trace::detail_capacity);
+        std::memcpy(to, detail.data(), n);
+        return std::uint8_t(n);
+    }
+
+
+    void
+    write_at_exit()
+    {
+        /* workers that are still running stop recording, what they are writing is skipped */
+        enabled_flag.store(false, std::memory_order_relaxed);
+
+        if (auto res = trace::write(output); !res) std::println(stderr, "warning: {}", res.error());
+    }
+}
+
+
+void
+trace::init() noexcept
+try
+{
+    const char *path = std::getenv("AURGH_TRACE");
+    if (path == nullptr or *path == '\0') return;
+
+    std::string name = path;
+    if (auto at = name.find("%p"); at != std::string::npos)
+        name.replace(at, 2, std::to_string(getpid()));
+
+    output = std::move(name);
+    enabled_flag.store(true, std::memory_order_relaxed);
+
+    name_thread("main");
+    std::atexit(write_at_exit);
+}
+catch (const std::exception &e)
+{
+    std::println(stderr, "warning: tracing stays off: {}", e.what());
+}
+
+
+auto
+trace::enabled() noexcept -> bool
+{ return enabled_flag.load(std::memory_order_relaxed); }
+
+
+auto
+trace::next_id() noexcept -> std::uint64_t
+{ return ++last_id; }
+
+
+auto
+trace::current_id() noexcept -> std::uint64_t
+{ return local_id; }
+
+
+void
+trace::name_thread(const char *name) noexcept
+try
+{
+    if (enabled()) local_ring().name = name;
+}
+catch (const std::exception &)
+{
+}
+
+
+void
+trace::instant(const char *category, const char *name, std::string_view detail) noexcept
+try
+{
+    if (!enabled()) return;
+
+    event e { .category = category,
+              .name     = name,
+              .id       = local_id,
+              .begin    = now(),
+              .duration = -1,
+              .tid      = local_ring().tid };
+
+    e.detail_size = copy_detail(detail, e.detail);
+    record(e);
+}
+catch (const std::exception &)
+{
+}
+
+
+auto
+trace::write(const std::filesystem::path &path) noexcept -> result<void>
+try
+{
+    using nlohmann::json;
+
+    std::vector<std::shared_ptr<ring>> all;
+    {
+        std::lock_guard lock { rings_mutex };
+        all = rings;
+    }
+
+    json events = json::array();
+    int  pid    = getpid();
+
+    for (const auto &r : all)
+    {
+        if (!r->name.empty())
+            events.push_back({ { "name", "thread_name" },
+                               { "ph", "M" },
+                               { "pid", pid },
+                               { "tid", r->tid },
+                               { "args", { { "name", r->name } } } });
+
+        std::size_t head  = r->head.load(std::memory_order_acquire);
+        std::size_t count = std::min(head, ring_capacity);
+
+        for (std::size_t i = head - count; i < head; i++)
+        {
+            event e;
+            if (!read(r->slots[i % ring_capacity], e)) continue;
+
+            json out = { { "name", e.name },
+                         { "cat", e.category },
+                         { "ts", double(e.begin) / 1000 },
+                         { "pid", pid },
+                         { "tid", e.tid },
+                         { "args", json::object() } };
+
+            if (e.duration < 0)
+            {
+                out["ph"] = "i";
+                out["s"]  = "t";
+            }
+            else
+            {
+                out["ph"]  = "X";
+                out["dur"] = double(e.duration) / 1000;
+            }
+
+            if (e.id != 0) out["args"]["id"] = e.id;
+            if (e.detail_size != 0) out["args"]["detail"] = std::string { e.detail, e.detail_size };
+
+            events.push_back(std::move(out));
+        }
+    }
+
+    std::ofstream stream { path, std::ios::trunc };
+
+    /* a detail cut in the middle of a UTF-8 sequence is not worth losing the trace over */
+    stream << json { { "traceEvents", std::move(events) }, { "displayTimeUnit", "ms" } }.dump(
+        -1, ' ', false, json::error_handler_t::replace);
+
+    if (!stream.flush()) return error { "failed to write trace \"{}\"", path.c_str() }.unexpected();
+    return {};
+}
+catch (const std::exception &e)
+{
+    return error { "failed to save trace \"{}\": {}", path.c_str(), e.what() }.unexpected();
+}
+
+
+trace::id_scope::id_scope(std::uint64_t id) noexcept : m_previous { std::exchange(local_id, id) }
+{
+}
+
+
+trace::id_scope::~id_scope()
+{ local_id = m_previous; }
+
+
+trace::span::span(const char      *category,
+                  const char      *name,
+                  std::string_view detail,
+                  std::uint64_t    id) noexcept
+{
+    if (!enabled()) return;
+
+    /* a constructor's function-try-block would rethrow */
+    try
+    {
+        m_tid = local_ring().tid;
+    }
+    catch (const std::exception &)
+    {
+        return;
+    }
+
+    m_category    = category;
+    m_id          = id;
+    m_detail_size = copy_detail(detail, m_detail);
+    m_begin       = now();
+    m_name        = name;
+}
+
+
+trace::span::span(span &&other) noexcept
+    : m_category { other.m_category }, m_name { std::exchange(other.m_name, nullptr) },
+      m_id { other.m_id }, m_begin { other.m_begin }, m_tid { other.m_tid },
+      m_detail_size { other.m_detail_size }
+{ std::memcpy(m_detail, other.m_detail, m_detail_size); }
+
+
+auto
+trace::span::operator=(span &&other) noexcept -> span &
+{
+    if (this == &other) return *this;
+    end();
+
+    m_category    = other.m_category;
+    m_name        = std::exchange(other.m_name, nullptr);
+    m_id          = other.m_id;
+    m_begin       = other.m_begin;
+    m_tid         = other.m_tid;
+    m_detail_size = other.m_detail_size;
+    std::memcpy(m_detail, other.m_detail, m_detail_size);
+    return *this;
+}
+
+
+trace::span::~span()
+{ end(); }
+
+
+void
+trace::span::end() noexcept
+try
+{
+    if (m_name == nullptr) return;
+
+    event e { .category = m_category,
+              .name     = std::exchange(m_name, nullptr),
+              .id       = m_id,
+              .begin    = m_begin,
+              .duration = now() - m_begin,
+              .tid      = m_tid };
+
+    e.detail_size = m_detail_size;
+    std::memcpy(e.detail, m_detail, m_detail_size);
+    record(e);
+}
+catch (const std::exception &)
+{
+}
+#endif
@@ -0,0 +1,281 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <print>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <glibmm/main.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+/* what the tests share: a check that keeps going, a plain HTTP/1.1 server on the loopback
+   interface and a way to spin the main loop until something happened */
+namespace aurgh::test
+{
+    inline int failures = 0;
+
+
+#define AURGH_CHECK(expr)                                                                    \
+    do {                                                                                     \
+        if (!(expr))                                                                         \
+        {                                                                                    \
+            std::println(stderr, "{}:{}: check failed: {}", __FILE__, __LINE__, #expr);      \
+            ::aurgh::test::failures++;                                                       \
+        }                                                                                    \
+    } while (false)
+
+
+    /* runs every test, the exit status is what meson reads */
+    [[nodiscard]]
+    inline auto
+    run(const std::vector<std::pair<const char *, std::function<void()>>> &tests) -> int
+    {
+        for (const auto &[name, fn] : tests)
+        {
+            int before = failures;
+            fn();
+            std::println("{} {}", failures == before ? "ok  " : "FAIL", name);
+        }
+
+        return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+
+    /* false when @p done did not become true before @p timeout */
+    [[nodiscard]]
+    inline auto
+    spin(const std::function<bool()> &done,
+         std::chrono::milliseconds    timeout = std::chrono::seconds { 30 }) -> bool
+    {
+        auto context  = Glib::MainContext::get_default();
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        /* keeps the blocking iteration from sleeping past the deadline */
+        auto wake = Glib::signal_timeout().connect([] { return true; }, 20);
+
+        while (!done() and std::chrono::steady_clock::now() < deadline) context->iteration(true);
+
+        wake.disconnect();
+        return done();
+    }
+
+
+    /* a directory that is gone again with the object */
+    class scratch_dir
+    {
+    public:
+        scratch_dir()
+        {
+            std::string pattern = std::filesystem::temp_directory_path() / "aurgh-test-XXXXXX";
+            if (mkdtemp(pattern.data()) == nullptr) std::abort();
+            m_path = pattern;
+        }
+
+        ~scratch_dir()
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(m_path, ec);
+        }
+
+        scratch_dir(const scratch_dir &)                     = delete;
+        auto operator=(const scratch_dir &) -> scratch_dir & = delete;
+
+
+        [[nodiscard]]
+        auto
+        path() const -> const std::filesystem::path &
+        { return m_path; }
+
+    private:
+        std::filesystem::path m_path;
+    };
+
+
+    struct resource
+    {
+        static constexpr std::size_t whole = -1;
+
+        std::string body;
+        int         status = 200;
+        bool        ranges = true;  /* false answers a Range request with the whole body */
+        std::size_t cut    = whole; /* the connection is closed after this many body bytes */
+    };
+
+
+    /* one thread per connection, every response closes its connection */
+    class local_server
+    {
+    public:
+        local_server()
+        {
+            m_listener = socket(AF_INET, SOCK_STREAM, 0);
+
+            sockaddr_in addr {};
+            addr.sin_family      = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            socklen_t size = sizeof(addr);
+            if (m_listener == -1
+                or bind(m_listener, reinterpret_cast<sockaddr *>(&addr), size) != 0
+                or listen(m_listener, 16) != 0
+                or getsockname(m_listener, reinterpret_cast<sockaddr *>(&addr), &size) != 0)
+                std::abort();
+
+            m_port   = ntohs(addr.sin_port);
+            m_thread = std::thread { [this] { mf_accept(); } };
+        }
+
+        ~local_server()
+        {
+            m_stop = true;
+            m_thread.join();
+            for (auto &t : m_connections) t.join();
+            close(m_listener);
+        }
+
+        local_server(const local_server &)                     = delete;
+        auto operator=(const local_server &) -> local_server & = delete;
+
+
+        void
+        serve(const std::string &path, resource r)
+        {
+            std::lock_guard lock { m_mutex };
+            m_resources[path] = std::move(r);
+        }
+
+
+        [[nodiscard]]
+        auto
+        url(std::string_view path = {}) const -> std::string
+        { return std::format("http://127.0.0.1:{}{}", m_port, path); }
+
+
+        /* requests made for @p path so far */
+        [[nodiscard]]
+        auto
+        hits(const std::string &path) const -> std::size_t
+        {
+            std::lock_guard lock { m_mutex };
+            auto            it = m_hits.find(path);
+            return it == m_hits.end() ? 0 : it->second;
+        }
+
+    private:
+        int               m_listener = -1;
+        int               m_port     = 0;
+        std::atomic<bool> m_stop     = false;
+        std::thread       m_thread;
+
+        std::vector<std::thread> m_connections; /* accept thread only, until the join */
+
+        mutable std::mutex                 m_mutex;
+        std::map<std::string, resource>    m_resources;
+        std::map<std::string, std::size_t> m_hits;
+
+
+        void
+        mf_accept()
+        {
+            while (!m_stop)
+            {
+                pollfd pfd { .fd = m_listener, .events = POLLIN, .revents = 0 };
+                if (poll(&pfd, 1, 50) <= 0) continue;
+
+                if (int fd = accept(m_listener, nullptr, nullptr); fd != -1)
+                    m_connections.emplace_back([this, fd] { mf_answer(fd); });
+            }
+        }
+
+
+        static auto
+        send_all(int fd, std::string_view data) -> bool
+        {
+            while (!data.empty())
+            {
+                ssize_t n = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+                if (n <= 0) return false;
+                data.remove_prefix(std::size_t(n));
+            }
+            return true;
+        }
+
+
+        void
+        mf_answer(int fd)
+        {
+            std::string request;
+            char        buffer[4096];
+
+            while (!request.contains("\r\n\r\n"))
+            {
+                ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+                if (n <= 0) return static_cast<void>(close(fd));
+                request.append(buffer, std::size_t(n));
+            }
+
+            std::size_t from = request.find(' ') + 1;
+            std::string path = request.substr(from, request.find(' ', from) - from);
+
+            resource r { .body = {}, .status = 404 };
+            {
+                std::lock_guard lock { m_mutex };
+                m_hits[path]++;
+                if (auto it = m_resources.find(path); it != m_resources.end()) r = it->second;
+            }
+
+            int         status = r.status;
+            std::string range_header;
+            std::size_t begin = 0;
+            std::size_t end   = r.body.size();
+
+            constexpr std::string_view range_prefix = "\r\nRange: bytes=";
+
+            if (auto at = request.find(range_prefix);
+                at != std::string::npos and status == 200 and r.ranges)
+            {
+                std::size_t first = at + range_prefix.size();
+                std::size_t dash  = request.find('-', first);
+                std::size_t eol   = request.find("\r\n", dash);
+
+                begin = std::stoull(request.substr(first, dash - first));
+                if (eol != dash + 1)
+                    end = std::min<std::size_t>(std::stoull(request.substr(dash + 1, eol - dash - 1)) + 1,
+                                   r.body.size());
+
+                status       = 206;
+                range_header = std::format("Content-Range: bytes {}-{}/{}\r\n", begin, end - 1,
+                                           r.body.size());
+            }
+
+            std::string_view body = std::string_view { r.body }.substr(begin, end - begin);
+
+            std::string head = std::format("HTTP/1.1 {} {}\r\n"
+                                           "Content-Length: {}\r\n"
+                                           "{}"
+                                           "Accept-Ranges: bytes\r\n"
+                                           "Connection: close\r\n\r\n",
+                                           status, status < 300 ? "OK" : "Error", body.size(),
+                                           range_header);
+
+            if (send_all(fd, head)) std::ignore = send_all(fd, body.substr(0, r.cut));
+
+            shutdown(fd, SHUT_RDWR);
+            close(fd);
+        }
+    };
+}
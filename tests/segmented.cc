@@ -0,0 +1,207 @@
+#include <optional>
+#include <random>
+#include <string>
+
+#include <fcntl.h>
+#include <glibmm/init.h>
+#include <unistd.h>
+
+#include "harness.hh"
+#include "http/segmented.hh"
+
+namespace test = aurgh::test;
+using aurgh::http::segmented;
+
+namespace
+{
+    /* three chunks, the last one short, and no two chunks alike */
+    [[nodiscard]]
+    auto
+    payload() -> const std::string &
+    {
+        static const std::string body = []
+        {
+            std::string out(std::size_t(2 * segmented::chunk_size + 1024 * 1024), '\0');
+
+            std::mt19937 gen { 42 };
+            for (auto &c : out) c = char(gen());
+            return out;
+        }();
+
+        return body;
+    }
+
+
+    /* the file download writes into, read back whole */
+    class target
+    {
+    public:
+        explicit target(const test::scratch_dir &dir)
+            : m_fd { open((dir.path() / "file").c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) }
+        {
+            if (m_fd == -1) std::abort();
+        }
+
+        ~target() { close(m_fd); }
+
+        target(const target &)                     = delete;
+        auto operator=(const target &) -> target & = delete;
+
+
+        [[nodiscard]]
+        auto
+        fd() const -> int
+        { return m_fd; }
+
+
+        [[nodiscard]]
+        auto
+        content(std::size_t size) const -> std::string
+        {
+            std::string out(size, '\0');
+            if (pread(m_fd, out.data(), size, 0) != ssize_t(size)) return {};
+            return out;
+        }
+
+    private:
+        int m_fd;
+    };
+
+
+    struct outcome
+    {
+        bool                       completed = false;
+        std::optional<std::string> error;
+        curl_off_t                 contiguous = 0;
+
+        [[nodiscard]]
+        auto
+        settled() const -> bool
+        { return completed or error.has_value(); }
+    };
+
+
+    /* downloads payload() from @p urls into @p file and waits for it to settle */
+    [[nodiscard]]
+    auto
+    download(std::vector<std::string> urls, const target &file) -> outcome
+    {
+        outcome out;
+
+        auto http = aurgh::http::client::create();
+        if (!http) std::abort();
+
+        auto task = segmented::start(http.value(), std::move(urls), file.fd(),
+                                     curl_off_t(payload().size()));
+        if (!task)
+        {
+            out.error = std::string { task.error().message() };
+            return out;
+        }
+
+        task.value()
+            ->on_complete([&out] { out.completed = true; })
+            .on_error([&out](std::string_view e) { out.error = std::string { e }; });
+
+        AURGH_CHECK(test::spin([&out] { return out.settled(); }, std::chrono::seconds { 60 }));
+
+        out.contiguous = task.value()->contiguous();
+        task.value()->cancel();
+        return out;
+    }
+
+
+    void
+    spreads_chunks_over_mirrors()
+    {
+        test::local_server server;
+        test::scratch_dir  dir;
+        target             file { dir };
+
+        server.serve("/a", { .body = payload() });
+        server.serve("/b", { .body = payload() });
+
+        auto out = download({ server.url("/a"), server.url("/b") }, file);
+
+        AURGH_CHECK(out.completed);
+        AURGH_CHECK(out.contiguous == curl_off_t(payload().size()));
+        AURGH_CHECK(file.content(payload().size()) == payload());
+        AURGH_CHECK(server.hits("/a") >= 1 and server.hits("/b") >= 1);
+    }
+
+
+    void
+    drops_mirrors_ignoring_ranges()
+    {
+        test::local_server server;
+        test::scratch_dir  dir;
+        target             file { dir };
+
+        server.serve("/whole", { .body = payload(), .ranges = false });
+        server.serve("/ranged", { .body = payload() });
+
+        auto out = download({ server.url("/whole"), server.url("/ranged") }, file);
+
+        AURGH_CHECK(out.completed);
+        AURGH_CHECK(file.content(payload().size()) == payload());
+
+        /* only the chunks handed out before its first answer went there */
+        AURGH_CHECK(server.hits("/whole") >= 1);
+        AURGH_CHECK(server.hits("/whole") <= segmented::connections);
+    }
+
+
+    void
+    reassigns_cut_chunks()
+    {
+        test::local_server server;
+        test::scratch_dir  dir;
+        target             file { dir };
+
+        /* every answer from the flaky mirror stops a megabyte in */
+        server.serve("/flaky", { .body = payload(), .cut = 1024 * 1024 });
+        server.serve("/steady", { .body = payload() });
+
+        auto out = download({ server.url("/flaky"), server.url("/steady") }, file);
+
+        AURGH_CHECK(out.completed);
+        AURGH_CHECK(file.content(payload().size()) == payload());
+        AURGH_CHECK(server.hits("/flaky") >= 1);
+        AURGH_CHECK(server.hits("/flaky") <= segmented::max_mirror_failures);
+    }
+
+
+    void
+    keeps_the_contiguous_prefix()
+    {
+        test::local_server server;
+        test::scratch_dir  dir;
+        target             file { dir };
+
+        constexpr std::size_t cut = 1024 * 1024;
+        server.serve("/flaky", { .body = payload(), .cut = cut });
+
+        auto out = download({ server.url("/flaky") }, file);
+
+        AURGH_CHECK(!out.completed);
+        AURGH_CHECK(out.error.has_value());
+
+        /* the first chunk got at least one cut answer, and never all of it */
+        AURGH_CHECK(out.contiguous >= curl_off_t(cut));
+        AURGH_CHECK(out.contiguous < segmented::chunk_size);
+        AURGH_CHECK(file.content(std::size_t(out.contiguous))
+                    == payload().substr(0, std::size_t(out.contiguous)));
+    }
+}
+
+
+auto
+main() -> int
+{
+    Glib::init();
+
+    return test::run({ { "segmented spreads chunks over mirrors", spreads_chunks_over_mirrors },
+                       { "segmented drops mirrors ignoring ranges", drops_mirrors_ignoring_ranges },
+                       { "segmented reassigns cut chunks", reassigns_cut_chunks },
+                       { "segmented keeps the contiguous prefix", keeps_the_contiguous_prefix } });
+}
@@ -0,0 +1,182 @@
+#include <fstream>
+#include <optional>
+#include <sstream>
+
+#include <archive.h>
+#include <archive_entry.h>
+#include <glibmm/init.h>
+
+#include "harness.hh"
+#include "snapshot.hh"
+
+namespace fs   = std::filesystem;
+namespace test = aurgh::test;
+
+namespace
+{
+    /* entries ending in '/' are directories */
+    [[nodiscard]]
+    auto
+    tarball(const std::vector<std::pair<std::string, std::string>> &entries) -> std::string
+    {
+        std::string out;
+
+        archive *a = archive_write_new();
+        archive_write_add_filter_gzip(a);
+        archive_write_set_format_pax_restricted(a);
+        archive_write_open(
+            a, &out, nullptr,
+            [](archive *, void *client_data, const void *buffer, std::size_t size) -> la_ssize_t
+            {
+                static_cast<std::string *>(client_data)->append(static_cast<const char *>(buffer),
+                                                                size);
+                return la_ssize_t(size);
+            },
+            nullptr);
+
+        for (const auto &[path, content] : entries)
+        {
+            archive_entry *entry = archive_entry_new();
+            archive_entry_set_pathname(entry, path.c_str());
+
+            if (path.ends_with('/'))
+            {
+                archive_entry_set_filetype(entry, AE_IFDIR);
+                archive_entry_set_perm(entry, 0755);
+            }
+            else
+            {
+                archive_entry_set_filetype(entry, AE_IFREG);
+                archive_entry_set_perm(entry, 0644);
+                archive_entry_set_size(entry, la_int64_t(content.size()));
+            }
+
+            archive_write_header(a, entry);
+            if (!content.empty()) archive_write_data(a, content.data(), content.size());
+            archive_entry_free(entry);
+        }
+
+        archive_write_close(a);
+        archive_write_free(a);
+        return out;
+    }
+
+
+    [[nodiscard]]
+    auto
+    slurp(const fs::path &path) -> std::string
+    {
+        std::ifstream      in { path };
+        std::ostringstream out;
+        out << in.rdbuf();
+        return out.str();
+    }
+
+
+    struct outcome
+    {
+        std::optional<fs::path>     dst;
+        std::optional<aurgh::error> error;
+
+        [[nodiscard]]
+        auto
+        settled() const -> bool
+        { return dst.has_value() or error.has_value(); }
+    };
+
+
+    /* fetches @p pkgbase from @p server into @p clone_dir and waits for the answer */
+    [[nodiscard]]
+    auto
+    fetch(const test::local_server &server, std::string_view pkgbase, const fs::path &clone_dir)
+        -> outcome
+    {
+        outcome out;
+
+        auto http = aurgh::http::client::create();
+        auto exec = aurgh::git::executor::create(2);
+        if (!http or !exec) std::abort();
+
+        auto task = aurgh::fetch_snapshot(http.value(), server.url(), pkgbase, clone_dir,
+                                          *exec.value());
+        if (!task)
+        {
+            out.error = task.error();
+            return out;
+        }
+
+        task.value()
+            ->on_completed([&out](fs::path dst) { out.dst = std::move(dst); })
+            .on_error([&out](aurgh::error e) { out.error = std::move(e); });
+
+        AURGH_CHECK(test::spin([&out] { return out.settled(); }));
+        return out;
+    }
+
+
+    void
+    extracts_into_clone_dir()
+    {
+        test::local_server server;
+        test::scratch_dir  dir;
+
+        server.serve("/foo.tar.gz", { .body = tarball({ { "foo/", "" },
+                                                        { "foo/PKGBUILD", "pkgname=foo\n" },
+                                                        { "foo/.SRCINFO", "pkgbase = foo\n" },
+                                                        { "foo/sub/", "" },
+                                                        { "foo/sub/patch", "diff\n" } }) });
+
+        auto out = fetch(server, "foo", dir.path() / "clone");
+
+        AURGH_CHECK(!out.error.has_value());
+        AURGH_CHECK(out.dst == dir.path() / "clone" / "foo");
+        AURGH_CHECK(slurp(dir.path() / "clone" / "foo" / "PKGBUILD") == "pkgname=foo\n");
+        AURGH_CHECK(slurp(dir.path() / "clone" / "foo" / ".SRCINFO") == "pkgbase = foo\n");
+        AURGH_CHECK(slurp(dir.path() / "clone" / "foo" / "sub" / "patch") == "diff\n");
+    }
+
+
+    void
+    reports_http_status()
+    {
+        test::local_server server;
+        test::scratch_dir  dir;
+
+        auto out = fetch(server, "missing", dir.path() / "clone");
+
+        AURGH_CHECK(out.error.has_value());
+        AURGH_CHECK(out.error.has_value() and out.error->message().contains("404"));
+        AURGH_CHECK(!fs::exists(dir.path() / "clone" / "missing"));
+    }
+
+
+    void
+    refuses_entries_leaving_the_base()
+    {
+        test::local_server server;
+        test::scratch_dir  dir;
+
+        server.serve("/evil.tar.gz", { .body = tarball({ { "evil/", "" },
+                                                         { "evil/PKGBUILD", "pkgname=evil\n" },
+                                                         { "evil/../../escaped", "gotcha\n" } }) });
+
+        auto out = fetch(server, "evil", dir.path() / "clone");
+
+        AURGH_CHECK(out.error.has_value());
+        AURGH_CHECK(!fs::exists(dir.path() / "escaped"));
+        AURGH_CHECK(!fs::exists(dir.path() / "clone" / "escaped"));
+        AURGH_CHECK(!fs::exists(dir.path() / "clone" / "evil"));
+    }
+}
+
+
+auto
+main() -> int
+{
+    Glib::init();
+
+    return test::run({ { "snapshot extracts into the clone directory", extracts_into_clone_dir },
+                       { "snapshot reports the HTTP status", reports_http_status },
+                       { "snapshot refuses entries leaving the base",
+                         refuses_entries_leaving_the_base } });
+}